@@ -0,0 +1,51 @@
+// allocdebug.hpp
+
+#ifndef allocdebug_hpp
+#define allocdebug_hpp
+
+#include <atomic>
+
+namespace allocdebug {
+
+// Heap allocation counter for finding allocator churn in frame loops.
+// Only active when built with -DAR_ALLOC_DEBUG=ON: counts operator new calls and cv::Mat buffer allocations
+// made on the calling thread, including the std::vectors and cv::Mats OpenCV functions create internally.
+// OpenCV's raw scratch buffers (cv::fastMalloc, cv::AutoBuffer) are not counted.
+// Without the option every count is -1.
+
+// route cv::Mat buffer allocations through the counter, call once at startup
+void install();
+// allocations made on the calling thread so far
+long count();
+
+// Counts the allocations of one loop iteration on the calling thread, split into the loop's own and those made
+// inside the OpenCV calls it brackets with enterLibrary() and leaveLibrary(). Once the loop is warm its own count
+// should be zero, while detectors like findChessboardCorners keep allocating internally.
+// lastFrame() and lastLibrary() may be read from another thread, e.g. a display stage.
+class FrameMeter {
+public:
+    FrameMeter() : start(0), libraryStart(0), library(0), last(-1), lastLib(-1) {}
+    void begin() {
+        start = count();
+        library = 0;
+    }
+    void enterLibrary() { libraryStart = count(); }
+    void leaveLibrary() { library += count() - libraryStart; }
+    // the loop's allocations since begin(), -1 when counting is not enabled
+    long end() {
+        long now = count();
+        last = now < 0 ? -1 : now - start - library;
+        lastLib = now < 0 ? -1 : library;
+        return last;
+    }
+    long lastFrame() const { return last; }
+    long lastLibrary() const { return lastLib; }
+
+private:
+    long start, libraryStart, library;
+    std::atomic<long> last, lastLib;
+};
+
+}  // namespace allocdebug
+
+#endif /* allocdebug_hpp */
@@ -4,6 +4,7 @@
 #define ar_hpp
 
 #include <opencv2/core/mat.hpp>
+#include <vector>
 
 const cv::Scalar R = cv::Scalar(0, 0, 255);
 const cv::Scalar G = cv::Scalar(0, 255, 0);
@@ -13,9 +14,57 @@ const cv::Scalar YELLOW = cv::Scalar(0, 255, 255);
 const cv::Scalar GRAY = cv::Scalar(200, 200, 200);
 
 namespace ar {
-void readCameraCalibrationInfo(const char *cameraCalibrationFile, cv::Mat &cameraMatrix, std::vector<double> &coeffs);
 void project3DAxes(cv::Mat &frame, cv::Mat &cameraMatrix, cv::Mat &distCoeffs, cv::Mat &rvec, cv::Mat &tvec);
 void project3DTriangular(cv::Mat &frame, float x, float y, cv::Mat &cameraMatrix, cv::Mat &distCoeffs, cv::Mat &rvec, cv::Mat &tvec);
+
+// Buffers of one chessboard stream, owned across frames so the steady-state loop does not allocate
+struct FrameContext {
+    FrameContext(cv::Size boardSize);
+
+    cv::Size boardSize;
+    std::vector<cv::Point3f> point_set;   // 3D world units, built once
+    std::vector<cv::Point2f> corner_set;  // capacity for the whole board
+    cv::Mat rvec;                         // 3x1 CV_64F, solvePnP writes in place
+    cv::Mat tvec;                         // 3x1 CV_64F
+};
+
+// A Mat of the pool that no other header references, so it can be overwritten without a reader seeing it change.
+// Results handed to another stage keep their buffer referenced until they are dropped, which is what makes this safe.
+cv::Mat &reusableBuffer(std::vector<cv::Mat> &pool);
+
+// Chessboard search limited to the region predicted from the previous frame.
+// Falls back to a full-frame search after a miss in the predicted region.
+class BoardTracker {
+public:
+    // padding is the margin added around the predicted board, as a fraction of its size
+    BoardTracker(cv::Size boardSize, float padding = 0.25f);
+
+    // find the chessboard corners in frame coordinates, returns false if the board is not found
+    bool findCorners(cv::Mat &frame, std::vector<cv::Point2f> &corner_set);
+    // feed back the pose solved from the last found corners, to extrapolate the next region
+    void updatePose(cv::Mat &rvec, cv::Mat &tvec, cv::Mat &cameraMatrix, cv::Mat &distCoeffs);
+    // forget the previous board, the next search is full-frame
+    void reset();
+
+    cv::Rect lastSearchArea() const { return searchArea; }
+    long roiSearches() const { return numRoiSearches; }
+    long fullSearches() const { return numFullSearches; }
+
+private:
+    bool predictROI(cv::Size frameSize, cv::Rect &roi);
+
+    cv::Size boardSize;
+    float padding;
+    std::vector<cv::Point2f> lastCorners;
+    std::vector<cv::Point3f> outerCorners;
+    std::vector<cv::Point2f> predicted;
+    bool hasPose, hasPrevPose;
+    cv::Mat rvecPrev, tvecPrev, rvecLast, tvecLast, rvecNext, tvecNext;
+    cv::Mat cameraMatrix, distCoeffs;
+    cv::Rect searchArea;
+    long numRoiSearches;
+    long numFullSearches;
+};
 }  // namespace ar
 
 #endif /* ar_hpp */
\ No newline at end of file
@@ -0,0 +1,35 @@
+// arucotune.hpp
+
+#ifndef arucotune_hpp
+#define arucotune_hpp
+
+#include <opencv2/aruco.hpp>
+#include <string>
+
+namespace arucotune {
+
+// The marker detector parameters that trade detection rate for time: the adaptive threshold window sweep, the
+// candidate perimeter limits, the contour approximation and the corner refinement. Everything else keeps the
+// defaults of DetectorParameters.
+struct Profile {
+    int winSizeMin, winSizeMax, winSizeStep;  // one thresholding pass per window size
+    double minPerimeterRate, maxPerimeterRate;  // candidate perimeter, relative to the larger image side
+    double polygonalApproxAccuracyRate;
+    int cornerRefinementMethod;  // cv::aruco::CORNER_REFINE_*
+
+    // the defaults of DetectorParameters
+    Profile();
+
+    cv::Ptr<cv::aruco::DetectorParameters> toParameters() const;
+    // one line of name=value pairs
+    std::string describe() const;
+};
+
+// The profile file: one "name value" pair per line, with the names of the DetectorParameters fields, and
+// comments starting with '#'. Missing names keep their default.
+bool save(const char *path, const Profile &profile, const std::string &comment = "");
+bool load(const char *path, Profile &profile);
+
+}  // namespace arucotune
+
+#endif /* arucotune_hpp */
@@ -0,0 +1,69 @@
+// calibfile.hpp
+
+#ifndef calibfile_hpp
+#define calibfile_hpp
+
+#include <stdint.h>
+
+#include <opencv2/core/mat.hpp>
+
+namespace calibfile {
+
+const char MAGIC[4] = {'C', 'A', 'L', 'B'};
+const uint32_t VERSION = 1;
+
+// OpenCV distortion models, named by their number of coefficients
+enum DistortionModel {
+    DIST_NONE = 0,
+    DIST_RADIAL_TANGENTIAL_4 = 4,  // k1 k2 p1 p2
+    DIST_RADIAL_TANGENTIAL_5 = 5,  // k1 k2 p1 p2 k3
+    DIST_RATIONAL_8 = 8,           // + k4 k5 k6
+    DIST_THIN_PRISM_12 = 12,       // + s1 s2 s3 s4
+    DIST_TILTED_14 = 14            // + tauX tauY
+};
+
+// header flags
+const uint32_t FLAG_HAS_MAPS = 1;
+
+// Fixed size header of the binary format, followed by the payload:
+// the 3x3 camera matrix and the distortion coefficients as doubles,
+// then optionally the fixed-point undistortion maps (CV_16SC2 and CV_16UC1, imageSize each).
+// All fields are in the byte order of the machine that wrote the file, little-endian on every target so far.
+// A file from a machine of the other byte order fails the version check instead of being misread.
+#pragma pack(push, 1)
+struct FileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t headerSize;
+    int32_t width;
+    int32_t height;
+    uint32_t distortionModel;
+    uint32_t flags;
+    uint32_t checksum;  // CRC-32 of the payload
+    uint64_t payloadSize;
+    uint8_t reserved[24];
+};
+#pragma pack(pop)
+
+// Camera intrinsics, with the optional undistortion maps of initUndistortRectifyMap
+struct Calibration {
+    cv::Size imageSize;
+    cv::Mat cameraMatrix;  // 3x3 CV_64F
+    cv::Mat distCoeffs;    // Nx1 CV_64F
+    cv::Mat map1;          // CV_16SC2, empty if not stored
+    cv::Mat map2;          // CV_16UC1, empty if not stored
+};
+
+uint32_t crc32(const void *data, size_t size, uint32_t crc = 0);
+
+bool writeBinary(const char *path, const Calibration &calib);
+bool readBinary(const char *path, Calibration &calib);
+// the space separated text format of calibration::writeCalibrateCameraInfo2File, which has no image size
+bool writeText(const char *path, const Calibration &calib);
+bool readText(const char *path, Calibration &calib);
+// read either format, the binary one is recognized by its magic
+bool load(const char *path, Calibration &calib);
+
+}  // namespace calibfile
+
+#endif /* calibfile_hpp */
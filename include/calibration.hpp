@@ -3,14 +3,94 @@
 #ifndef calibration_hpp
 #define calibration_hpp
 
+#include <atomic>
+#include <mutex>
 #include <opencv2/core/mat.hpp>
+#include <string>
+#include <thread>
+#include <vector>
 
 namespace calibration {
 void printOptions();
-std::vector<cv::Point2f> detectCorners(cv::Mat &src, cv::Size &boardSize);
+std::vector<cv::Point2f> detectCorners(cv::Mat &src, cv::Size &boardSize, bool draw = true);
+std::vector<cv::Point2f> detectCornersPyramid(cv::Mat &src, cv::Size &boardSize, double downscale, bool draw = true);
+std::vector<std::string> listImageFiles(const char *dirPath);
+void detectCornersInFiles(const std::vector<std::string> &files, cv::Size &boardSize, std::vector<std::vector<cv::Point2f> > &results, std::vector<cv::Size> &imageSizes, double downscale = 1.0);
+void detectCornersInFrames(std::vector<cv::Mat> &frames, cv::Size &boardSize, std::vector<std::vector<cv::Point2f> > &results, double downscale = 1.0);
 std::vector<cv::Point3f> get3DWorldUnits(cv::Size &boardSize);
 void printCalibrateCameraInfo(cv::Mat &cameraMatrix, cv::Mat &distCoeffs, double error);
-void writeCalibrateCameraInfo2File(cv::Mat &cameraMatrix, cv::Mat &distCoeffs);
+void writeCalibrateCameraInfo2File(cv::Mat &cameraMatrix, cv::Mat &distCoeffs, cv::Size imageSize = cv::Size());
+
+// Keeps a bounded set of calibration views that covers image position, tilt and scale.
+// A view is described by its board center, its apparent size and the foreshortening of its outer quad.
+// Candidates too close to an accepted view are rejected; once the budget is reached, a new view only
+// replaces the most redundant accepted one, so the solve cost stays bounded over long sessions.
+class ViewSelector {
+public:
+    ViewSelector(cv::Size imageSize, cv::Size boardSize, int budget = 30, double minNovelty = 0.08);
+
+    // distance of a view to the closest accepted one, larger is more novel
+    double novelty(const std::vector<cv::Point2f> &corner_set) const;
+    // returns the slot the view was stored in (equal to size() before the call when appended), or -1 if rejected
+    int offer(const std::vector<cv::Point2f> &corner_set);
+
+    int size() const { return (int)features.size(); }
+    int budget() const { return maxViews; }
+
+private:
+    std::vector<double> describe(const std::vector<cv::Point2f> &corner_set) const;
+    double distance(const std::vector<double> &a, const std::vector<double> &b) const;
+    int mostRedundant(double &redundancy) const;
+
+    cv::Size imageSize;
+    cv::Size boardSize;
+    int maxViews;
+    double minNovelty;
+    std::vector<std::vector<double> > features;
+};
+
+// Output of a camera calibration solve
+struct CalibrationResult {
+    cv::Mat cameraMatrix;
+    cv::Mat distCoeffs;
+    double error;
+    int numViews;
+};
+
+// Runs cv::calibrateCamera on a background thread, from a snapshot of the views taken when the solve starts.
+// The solve runs in rounds of a few Levenberg-Marquardt iterations, each one warm started from the previous,
+// so progress and the current reprojection error can be reported while it runs.
+class CalibrationWorker {
+public:
+    CalibrationWorker(int maxRounds = 6, int iterationsPerRound = 5);
+    ~CalibrationWorker();
+
+    // copy the views and start solving, returns false if a solve is already running
+    bool start(const std::vector<std::vector<cv::Point3f> > &point_list, const std::vector<std::vector<cv::Point2f> > &corner_list, cv::Size imageSize, const cv::Mat &cameraMatrix, const cv::Mat &distCoeffs);
+    bool isRunning() const { return running; }
+    // fraction of the rounds done, from 0 to 1
+    float progress() const { return progressValue; }
+    // reprojection error after the last finished round, negative before the first one
+    double currentError() const { return errorValue; }
+    // views in the snapshot of the current or last solve
+    int numViews() const { return viewCount; }
+    // hand over a finished result, true only once per solve
+    bool takeResult(CalibrationResult &result);
+
+private:
+    void solve(std::vector<std::vector<cv::Point3f> > point_list, std::vector<std::vector<cv::Point2f> > corner_list, cv::Size imageSize, cv::Mat cameraMatrix, cv::Mat distCoeffs);
+
+    int maxRounds;
+    int iterationsPerRound;
+    std::thread worker;
+    std::atomic<bool> running;
+    std::atomic<float> progressValue;
+    std::atomic<double> errorValue;
+    std::atomic<int> viewCount;
+    std::mutex resultMutex;
+    CalibrationResult result;
+    bool hasResult;
+};
 
 }  // namespace calibration
 
@@ -0,0 +1,126 @@
+// engine.hpp
+
+#ifndef engine_hpp
+#define engine_hpp
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <opencv2/core/mat.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "framesource.hpp"
+#include "pipeline.hpp"
+
+namespace engine {
+
+typedef std::function<void()> Task;
+
+// Thread pool with one task queue per worker.
+// Tasks are spread over the queues round-robin, and a worker whose queue is empty steals from the others.
+// Every queue is served oldest first, by its owner and by thieves alike: the tasks are independent frames,
+// so arrival order matters more than cache locality, and a stream that resubmits lands behind the others.
+class ThreadPool {
+public:
+    // numWorkers 0 uses every hardware thread
+    ThreadPool(int numWorkers = 0);
+    // runs the queued tasks, then joins the workers
+    ~ThreadPool();
+
+    void submit(Task task);
+    int size() const { return (int)workers.size(); }
+    long steals() const { return numSteals; }
+
+private:
+    struct Queue {
+        std::mutex m;
+        std::deque<Task> tasks;
+    };
+
+    void workerLoop(int id);
+    bool take(int id, Task &task);
+
+    std::vector<std::unique_ptr<Queue> > queues;
+    std::vector<std::thread> workers;
+    std::atomic<unsigned> nextQueue;
+    std::atomic<long> pending;
+    std::atomic<long> numSteals;
+    bool stopping;
+    std::mutex idleMutex;
+    std::condition_variable idle;
+};
+
+// Many capture sources processed on one shared ThreadPool.
+// Fairness: each stream has at most one frame in flight, so its per-stream state is never shared and
+// a slow stream can hold at most one worker. Frames a live source captures meanwhile replace the stream's pending
+// frame, while any other source waits for the pending slot, so every frame of a file is processed.
+// An optional per-stream frame rate cap skips frames before they are scheduled.
+class StreamEngine {
+public:
+    // runs on a pool worker, processes the frame of a stream in place
+    typedef std::function<void(int, pipeline::Frame &)> ProcessFn;
+
+    StreamEngine(ThreadPool &pool, ProcessFn process);
+    ~StreamEngine();
+
+    // takes ownership of the source, maxFps 0 processes every frame it can; returns the stream id
+    int addStream(framesource::FrameSource *source, double maxFps = 0);
+    int numStreams() const { return (int)streams.size(); }
+
+    void start();
+    // stops the captures and waits for the frames in flight
+    void stop();
+
+    // blocks until a stream has a new result or timeoutMs passes, returns false once every source has ended
+    bool waitForResults(int timeoutMs);
+    // the newest processed frame of a stream, if it was not taken yet
+    bool takeResult(int stream, pipeline::Frame &frame);
+
+    double streamFps(int stream) const;
+    double aggregateFps() const;
+    // one line per stream: processed fps, capture fps, frames dropped and skipped by the rate cap
+    std::string statsText(int stream) const;
+    std::string aggregateText() const;
+
+private:
+    struct Stream {
+        framesource::FrameSource *source;
+        double maxFps;
+        std::thread captureThread;
+        std::mutex m;
+        std::condition_variable pendingTaken;  // a non-live source's capture waits on it for the pending slot
+        bool inFlight;
+        bool hasPending;
+        bool ended;
+        pipeline::Frame pending;
+        bool hasResult;
+        pipeline::Frame result;
+        pipeline::StageStats captureStats;
+        pipeline::StageStats processStats;
+        long dropped;
+        long skipped;
+    };
+
+    void captureLoop(int id);
+    void schedule(int id, pipeline::Frame &frame);
+    void runFrame(int id, pipeline::Frame frame);
+
+    ThreadPool &pool;
+    ProcessFn process;
+    std::vector<std::unique_ptr<Stream> > streams;
+    std::atomic<bool> running;
+    std::atomic<int> activeTasks;  // runFrame calls submitted and not yet returned
+    pipeline::StageStats aggregateStats;
+    std::mutex resultMutex;
+    std::condition_variable resultReady;
+    bool newResults;
+};
+
+}  // namespace engine
+
+#endif /* engine_hpp */
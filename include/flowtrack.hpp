@@ -0,0 +1,67 @@
+// flowtrack.hpp
+
+#ifndef flowtrack_hpp
+#define flowtrack_hpp
+
+#include <opencv2/core/mat.hpp>
+#include <vector>
+
+namespace flowtrack {
+
+// Report of one frame
+struct TrackStats {
+    bool detected;   // the points came from a full detection, not from the flow
+    int interval;    // frames between two detections at the moment
+    float motionPx;  // median displacement of the points since the previous frame
+    int lost;        // points the flow could not follow
+
+    TrackStats() : detected(false), interval(1), motionPx(0), lost(0) {}
+};
+
+// Detect-every-N tracking of a set of image points, e.g. chessboard or marker corners.
+// Between two full detections the points are propagated with pyramidal Lucas-Kanade, checked forward and backward.
+// A detection is due every interval frames, or as soon as a point is lost. The interval grows by one after a
+// detection cycle with little motion and halves on fast motion or a lost point, between minInterval and maxInterval.
+class AdaptiveTracker {
+public:
+    // motion below lowMotionPx per frame lets the interval grow, above highMotionPx it shrinks
+    AdaptiveTracker(int minInterval = 1, int maxInterval = 8, float lowMotionPx = 0.5f, float highMotionPx = 4.0f);
+
+    // whether the caller has to run a full detection on this frame
+    bool needsDetection() const { return !hasPoints || sinceDetection >= interval; }
+    // feed back the result of a full detection on gray, points is empty when nothing was found
+    void detected(const cv::Mat &gray, const std::vector<cv::Point2f> &points);
+    // propagate the points to gray, returns false when they cannot be trusted and the caller has to detect
+    bool track(const cv::Mat &gray, std::vector<cv::Point2f> &points);
+    // forget the points, the next frame is detected
+    void reset();
+
+    const TrackStats &lastStats() const { return stats; }
+    long detections() const { return numDetections; }
+    long trackedFrames() const { return numTracked; }
+
+private:
+    void shrinkInterval();
+
+    int minInterval, maxInterval;
+    float lowMotionPx, highMotionPx;
+    int interval;
+    int sinceDetection;
+    bool hasPoints;
+    float cycleMaxMotion;  // largest motion since the last detection
+
+    // the pyramid of the previous frame is kept, so every frame is decimated once
+    std::vector<cv::Mat> prevPyramid, pyramid;
+    std::vector<cv::Point2f> prevPoints, nextPoints, backPoints;
+    std::vector<unsigned char> status, backStatus;
+    std::vector<float> errors;
+    std::vector<float> motions;
+
+    TrackStats stats;
+    long numDetections;
+    long numTracked;
+};
+
+}  // namespace flowtrack
+
+#endif /* flowtrack_hpp */
@@ -0,0 +1,143 @@
+// framesource.hpp
+
+#ifndef framesource_hpp
+#define framesource_hpp
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <opencv2/core/mat.hpp>
+#include <opencv2/videoio.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace framesource {
+
+// steady clock, the time base of the capture timestamps
+int64_t nowNs();
+
+// Where the frames of a live loop or a tool come from.
+// read() is called from one thread at a time, the capture thread of the pipeline or engine.
+class FrameSource {
+public:
+    virtual ~FrameSource() {}
+
+    // the next frame, decoded exactly once, stamped with the steady clock time it was captured at;
+    // false at the end of the source or when a frame cannot be read
+    virtual bool read(cv::Mat &image, int64_t &timestampNs) = 0;
+    // size of the frames, empty when it is not known before the first read
+    virtual cv::Size frameSize() const { return cv::Size(); }
+    // whether frames arrive in real time whether or not they are read, like a camera's. A live source is read into
+    // queues that drop the oldest frame; any other source is read no faster than it is processed, so every frame is.
+    virtual bool isLive() const { return false; }
+};
+
+// A camera, a video file or a URL through cv::VideoCapture.
+// read() grabs, takes the timestamp, then retrieves: one grab and one decode per frame.
+// Cameras and URLs (a path with "://") are live, video files are not.
+class CaptureSource : public FrameSource {
+public:
+    explicit CaptureSource(int device);
+    explicit CaptureSource(const std::string &path);
+
+    bool isOpened() const { return capture.isOpened(); }
+    bool read(cv::Mat &image, int64_t &timestampNs);
+    cv::Size frameSize() const;
+    bool isLive() const { return live; }
+
+private:
+    cv::VideoCapture capture;
+    bool live;
+};
+
+// Image files in order, e.g. the sorted files of a directory, decoded one per read; unreadable files are skipped
+class ImageSequenceSource : public FrameSource {
+public:
+    ImageSequenceSource(const std::vector<std::string> &files, bool loop = false);
+
+    bool read(cv::Mat &image, int64_t &timestampNs);
+
+private:
+    std::vector<std::string> files;
+    bool loop;
+    size_t next;
+};
+
+// An animated GIF, decoded once when opened and then replayed from memory, looping by default.
+// Each read copies the frame out, so the caller may draw on it.
+class GifSource : public FrameSource {
+public:
+    GifSource(const std::string &path, bool loop = true);
+
+    bool isOpened() const { return !frames.empty(); }
+    bool read(cv::Mat &image, int64_t &timestampNs);
+    cv::Size frameSize() const { return frames.empty() ? cv::Size() : frames[0].size(); }
+    int numFrames() const { return (int)frames.size(); }
+
+private:
+    std::vector<cv::Mat> frames;
+    bool loop;
+    size_t next;
+};
+
+// Generated frames of a chessboard of 8x6 inner corners gliding over a gray background, for runs without a
+// camera. fps 0 generates as fast as the reader asks, maxFrames 0 never ends.
+class SyntheticSource : public FrameSource {
+public:
+    SyntheticSource(cv::Size size = cv::Size(1280, 720), double fps = 30, long maxFrames = 0);
+
+    bool read(cv::Mat &image, int64_t &timestampNs);
+    cv::Size frameSize() const { return size; }
+    // paced like a camera, unless fps is 0
+    bool isLive() const { return fps > 0; }
+
+private:
+    cv::Size size;
+    double fps;
+    long maxFrames;
+    long index;
+    int64_t nextNs;
+};
+
+// Decodes ahead of the reader on a thread of its own, up to depth frames, for any other source.
+// Unlike the pipeline's RingBuffer nothing is dropped: the decoder waits while the queue is full.
+class PrefetchSource : public FrameSource {
+public:
+    PrefetchSource(FrameSource *source, size_t depth = 4);  // takes ownership of source
+    ~PrefetchSource();
+
+    bool read(cv::Mat &image, int64_t &timestampNs);
+    cv::Size frameSize() const { return source->frameSize(); }
+    bool isLive() const { return source->isLive(); }
+
+private:
+    void decodeLoop();
+
+    std::unique_ptr<FrameSource> source;
+    size_t depth;
+    std::deque<std::pair<cv::Mat, int64_t> > queue;
+    bool ended;
+    bool stopping;
+    std::mutex m;
+    std::condition_variable changed;
+    std::thread decodeThread;
+};
+
+// Source from a command line spec:
+//   <n>, camera:<n>        camera device n
+//   video:<path or URL>    video file or stream
+//   images:<path>          image directory or list file, see imagefiles.hpp
+//   gif:<path>             animated GIF, looped
+//   synthetic[:WxH[@fps]]  generated chessboard frames, 1280x720@30 by default
+//   prefetch:<spec>        any of these, decoded ahead on a thread of its own
+// anything else is a directory, a .gif or a video file, judged by its name. Returns NULL when the spec is unknown
+// or the source cannot be opened.
+FrameSource *create(const std::string &spec);
+
+}  // namespace framesource
+
+#endif /* framesource_hpp */
@@ -0,0 +1,123 @@
+// harris.hpp
+
+#ifndef harris_hpp
+#define harris_hpp
+
+#include <opencv2/core/mat.hpp>
+#include <stdint.h>
+
+#include <cstdio>
+#include <opencv2/core/types.hpp>
+#include <string>
+#include <vector>
+
+namespace harris {
+
+// the response level of the original detector, on the 0..255 scale of the min-max normalized response
+const int DEFAULT_THRESHOLD = 180;
+
+// Buffers of the Harris stage, owned across frames so the steady-state loop does not allocate
+struct HarrisBuffers {
+    cv::Mat gray;
+    cv::Mat response;  // CV_32F
+};
+
+// cv::cornerHarris(gray, response, 2, 3, k) of an 8-bit gray image in one pass instead of one per stage.
+// Row bands run in parallel, and each band is swept in column tiles: the Sobel derivatives, their products, the
+// 2x2 box sum and the response of a tile are made a row at a time in buffers that stay in the cache.
+// The arithmetic follows the order of OpenCV's generic filters, with the same BORDER_REFLECT_101 borders.
+// Other image types fall back to cv::cornerHarris.
+void cornerHarrisFused(const cv::Mat &gray, cv::Mat &response, double k = 0.04);
+// Harris corners of a BGR or gray frame: the Harris response, thresholded and reduced to local maxima
+void detectHarrisCorners(const cv::Mat &frame, std::vector<cv::KeyPoint> &keypoints, HarrisBuffers &buffers, int threshold = DEFAULT_THRESHOLD);
+// Keypoints of a CV_32F response map: pixels above threshold (on the 0..255 scale of the response's min-max range)
+// that are the maximum of their 3x3 neighborhood, scanned four pixels at a time with universal intrinsics.
+// A plateau of equal maxima gives one keypoint, the 1-pixel border is not searched.
+void extractKeypoints(const cv::Mat &response, int threshold, std::vector<cv::KeyPoint> &keypoints);
+// a circle per keypoint, the optional last step
+void drawKeypoints(cv::Mat &frame, const std::vector<cv::KeyPoint> &keypoints);
+
+// detect and draw in one call, with buffers of its own
+void detectAndDrawHarrisCorners(cv::Mat &frame);
+
+// Harris corners of a video from a mostly static camera, kept up to date a tile at a time.
+// Each frame is compared per tile with the gray image the tile's response was last computed from. A tile whose area,
+// widened by the 2-pixel reach of the response, changed by more than diffThreshold gray levels is recomputed; the
+// others keep their response and keypoints. With diffThreshold 0 the result is the same as a full detection on
+// every frame; above it, changes smaller than the threshold are ignored until a larger one hits the tile.
+class IncrementalHarris {
+public:
+    explicit IncrementalHarris(int tileSize = 64, int diffThreshold = 8);
+
+    // update with the next BGR or gray frame, a new frame size starts over with a full detection
+    void update(const cv::Mat &frame, std::vector<cv::KeyPoint> &keypoints, int threshold = DEFAULT_THRESHOLD);
+    // forget the running state, the next frame is computed in full
+    void reset();
+
+    const cv::Mat &response() const { return buffers.response; }
+    // tiles whose response was recomputed by the last update, out of tileCount()
+    int lastRecomputed() const { return (int)dirtyTiles.size(); }
+    int tileCount() const { return tilesX * tilesY; }
+
+private:
+    cv::Rect tileRect(int tile) const;
+    void extractTile(int tile, float level);
+
+    int tileSize, diffThreshold;
+    int tilesX, tilesY;
+    HarrisBuffers buffers;
+    cv::Mat reference;  // the gray pixels each tile's response was computed from
+    cv::Mat diff;
+    std::vector<int> dirtyTiles;
+    std::vector<int> extractTiles;  // tiles whose keypoints are extracted again
+    std::vector<unsigned char> markedTiles;
+    std::vector<float> tileMin, tileMax;  // response range of each tile, for the global threshold level
+    std::vector<std::vector<cv::KeyPoint> > tileKeypoints;
+    float level;  // the threshold level the tile keypoints were extracted at
+    int lastThreshold;
+};
+
+const char KEYPOINT_MAGIC[4] = {'H', 'K', 'P', 'T'};
+const uint32_t KEYPOINT_VERSION = 1;
+
+// The binary keypoint file: a KeypointFileHeader, then for each image an ImageHeader, its path (pathLength bytes,
+// not terminated) and keypointCount KeypointEntries. All fields are little-endian.
+#pragma pack(push, 1)
+struct KeypointFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t entrySize;
+    uint32_t reserved;
+};
+
+struct ImageHeader {
+    uint32_t pathLength;
+    int32_t width, height;  // 0 when the image cannot be decoded
+    uint32_t keypointCount;
+};
+
+struct KeypointEntry {
+    float x, y;
+    float response;
+};
+#pragma pack(pop)
+
+// Writes the keypoints of a set of images, as CSV rows of file,x,y,response or in the binary format above
+class KeypointWriter {
+public:
+    KeypointWriter() : file(NULL), csv(false) {}
+    ~KeypointWriter() { close(); }
+
+    // a path ending in .csv writes CSV, "-" CSV on stdout, anything else the binary format
+    bool open(const char *path);
+    void write(const std::string &image, cv::Size size, const std::vector<cv::KeyPoint> &keypoints);
+    void close();
+
+private:
+    FILE *file;
+    bool csv;
+};
+
+}  // namespace harris
+
+#endif /* harris_hpp */
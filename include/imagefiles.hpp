@@ -0,0 +1,24 @@
+// imagefiles.hpp
+
+#ifndef imagefiles_hpp
+#define imagefiles_hpp
+
+#include <string>
+#include <vector>
+
+namespace imagefiles {
+
+// whether the name ends in an image extension OpenCV decodes (.jpg, .jpeg, .png, .ppm, .pgm, .bmp, .tif, .tiff,
+// .webp), in any case
+bool isImageFile(const std::string &name);
+// the image files of a directory, sorted by name, empty when it cannot be read
+std::vector<std::string> listDirectory(const char *dirPath);
+// the paths of a list file, one per line; blank lines and lines starting with '#' are skipped, and relative
+// paths are taken from the list file's directory
+std::vector<std::string> readListFile(const char *listPath);
+// a directory, a single image or a list file, whichever path is
+std::vector<std::string> collect(const char *path);
+
+}  // namespace imagefiles
+
+#endif /* imagefiles_hpp */
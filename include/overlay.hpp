@@ -0,0 +1,37 @@
+// overlay.hpp
+
+#ifndef overlay_hpp
+#define overlay_hpp
+
+#include <opencv2/core/mat.hpp>
+#include <opencv2/imgproc.hpp>
+#include <vector>
+
+namespace overlay {
+
+// Scratch buffers of compositeImage, owned by the caller so they are reused across frames
+struct CompositeBuffers {
+    CompositeBuffers();
+
+    std::vector<cv::Point> pts_src;
+    cv::Mat mappedImage;
+    cv::Mat mask;
+    cv::Mat element;
+};
+
+// Warp the source image onto a quad of the frame (top left, top right, bottom right, bottom left),
+// eroding the mask edge so the boundary effects of the mapping are not copied.
+void compositeImage(const cv::Mat &imgSrc, const std::vector<cv::Point> &pts_dst, cv::Mat &frame, CompositeBuffers &buffers);
+
+// The same composite, touching only the quad's bounding rectangle of the frame.
+// The inside of the quad, inset as by the eroded mask, is solved per row from the four edge lines instead of drawn.
+// Row bands of the rectangle run in parallel: each band is warped into a scratch buffer that stays in the cache,
+// then the inside span of every row is copied into the frame in the same pass.
+// interpolation is cv::INTER_CUBIC (the look of compositeImage) or the cheaper cv::INTER_LINEAR; the source has to be of the
+// frame's type, other sources and quads fall back to compositeImage.
+void compositeImageRoi(const cv::Mat &imgSrc, const std::vector<cv::Point> &pts_dst, cv::Mat &frame, CompositeBuffers &buffers,
+                       int interpolation = cv::INTER_CUBIC);
+
+}  // namespace overlay
+
+#endif /* overlay_hpp */
@@ -0,0 +1,269 @@
+// pipeline.hpp
+
+#ifndef pipeline_hpp
+#define pipeline_hpp
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <opencv2/core/mat.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "framesource.hpp"
+
+namespace pipeline {
+
+// A captured frame, tagged with its capture order and time
+struct Frame {
+    cv::Mat image;
+    long index;
+    int64_t timestampNs;  // steady clock, see framesource::nowNs
+
+    Frame() : index(0), timestampNs(0) {}
+};
+
+// Bounded ring buffer connecting two stages.
+// When it is full, push() overwrites the oldest item, so a slow consumer sees the newest frames instead of stalling the producer.
+// pushWait() waits for room instead, for producers that must not lose an item.
+template <typename T>
+class RingBuffer {
+public:
+    explicit RingBuffer(size_t capacity) : slots(capacity), head(0), count(0), closed(false), numDropped(0) {}
+
+    // returns false if the oldest item had to be dropped
+    bool push(T item) {
+        std::lock_guard<std::mutex> lock(m);
+        bool dropped = false;
+        if (count == slots.size()) {
+            head = (head + 1) % slots.size();
+            count--;
+            numDropped++;
+            dropped = true;
+        }
+        slots[(head + count) % slots.size()] = std::move(item);
+        count++;
+        notEmpty.notify_one();
+        return !dropped;
+    }
+
+    // blocks while the buffer is full, returns false if it was closed meanwhile and the item was not added
+    bool pushWait(T item) {
+        std::unique_lock<std::mutex> lock(m);
+        notFull.wait(lock, [this] { return count < slots.size() || closed; });
+        if (closed) {
+            return false;
+        }
+        slots[(head + count) % slots.size()] = std::move(item);
+        count++;
+        notEmpty.notify_one();
+        return true;
+    }
+
+    // blocks until an item is available, returns false once the buffer is closed and drained
+    bool pop(T &item) {
+        std::unique_lock<std::mutex> lock(m);
+        notEmpty.wait(lock, [this] { return count > 0 || closed; });
+        if (count == 0) {
+            return false;
+        }
+        item = std::move(slots[head]);
+        slots[head] = T();
+        head = (head + 1) % slots.size();
+        count--;
+        notFull.notify_one();
+        return true;
+    }
+
+    // wake up all consumers and waiting producers, pending items can still be popped
+    void close() {
+        std::lock_guard<std::mutex> lock(m);
+        closed = true;
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(m);
+        return count;
+    }
+
+    size_t capacity() const { return slots.size(); }
+
+    long dropped() const {
+        std::lock_guard<std::mutex> lock(m);
+        return numDropped;
+    }
+
+private:
+    std::vector<T> slots;
+    size_t head;
+    size_t count;
+    bool closed;
+    long numDropped;
+    mutable std::mutex m;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+};
+
+// Frame rate of one stage, measured over windows of about one second
+class StageStats {
+public:
+    StageStats();
+    void tick();
+    double fps() const;
+
+private:
+    mutable std::mutex m;
+    int64_t windowStart;
+    int count;
+    double rate;
+};
+
+// Three-stage live loop: a capture thread, worker thread(s) and a sink running on the calling thread.
+// For a live source the stages are connected by RingBuffers that drop the oldest frame, so a slow worker never stalls
+// the camera. Any other source, e.g. a video file, is read no faster than the slowest stage and every frame reaches the
+// sink in capture order.
+// The sink stays on the calling thread because imshow/waitKey must run on the main thread.
+template <typename Result>
+class Pipeline {
+public:
+    // runs on a worker thread, fills the result for a captured frame and may draw on frame.image
+    typedef std::function<void(Frame &, Result &)> ProcessFn;
+    // runs on the calling thread for each processed frame, returns false to stop the pipeline
+    typedef std::function<bool(Frame &, Result &)> SinkFn;
+
+    Pipeline(framesource::FrameSource &source, ProcessFn process, SinkFn sink, int numWorkers = 1, size_t queueCapacity = 2)
+        : source(source), process(process), sink(sink), numWorkers(numWorkers), live(source.isLive()), running(false), activeWorkers(0), captured(queueCapacity), processed(queueCapacity) {}
+
+    // blocks until the source runs dry or the sink asks to stop
+    void run() {
+        running = true;
+        activeWorkers = numWorkers;
+
+        std::thread captureThread(&Pipeline::captureLoop, this);
+        std::vector<std::thread> workerThreads;
+        for (int i = 0; i < numWorkers; i++) {
+            workerThreads.push_back(std::thread(&Pipeline::workerLoop, this));
+        }
+
+        // with several workers results can arrive out of order: a live run never shows an older frame after a newer
+        // one, any other run holds the early results back until the frames before them are shown
+        long lastIndex = -1;
+        std::map<long, std::pair<Frame, Result> > early;
+        std::pair<Frame, Result> item;
+        bool more = true;
+        while (more && processed.pop(item)) {
+            if (item.first.index < lastIndex) {
+                continue;
+            }
+            if (!live && item.first.index > lastIndex + 1) {
+                early[item.first.index] = item;
+                continue;
+            }
+            lastIndex = item.first.index;
+            sinkStage.tick();
+            more = sink(item.first, item.second);
+            while (more && !early.empty() && early.begin()->first == lastIndex + 1) {
+                lastIndex++;
+                sinkStage.tick();
+                more = sink(early.begin()->second.first, early.begin()->second.second);
+                early.erase(early.begin());
+            }
+        }
+
+        stop();
+        captureThread.join();
+        for (int i = 0; i < workerThreads.size(); i++) {
+            workerThreads[i].join();
+        }
+    }
+
+    void stop() {
+        running = false;
+        captured.close();
+        processed.close();
+    }
+
+    const StageStats &captureStats() const { return captureStage; }
+    const StageStats &workerStats() const { return workerStage; }
+    const StageStats &sinkStats() const { return sinkStage; }
+    size_t capturedDepth() const { return captured.size(); }
+    size_t processedDepth() const { return processed.size(); }
+    long droppedFrames() const { return captured.dropped() + processed.dropped(); }
+
+    // one line summary of every stage's fps and queue depth
+    std::string statsText() const {
+        char text[160];
+        snprintf(text, sizeof(text), "capture %.1f fps [%lu/%lu] | process %.1f fps [%lu/%lu] | display %.1f fps | dropped %ld",
+                 captureStage.fps(), captured.size(), captured.capacity(),
+                 workerStage.fps(), processed.size(), processed.capacity(),
+                 sinkStage.fps(), droppedFrames());
+        return std::string(text);
+    }
+
+private:
+    void captureLoop() {
+        long index = 0;
+        while (running) {
+            Frame frame;
+            // one decode per frame, treat as a stream
+            if (!source.read(frame.image, frame.timestampNs) || frame.image.empty()) {
+                printf("frame is empty\n");
+                break;
+            }
+            frame.index = index++;
+            captureStage.tick();
+            if (live) {
+                captured.push(frame);
+            } else if (!captured.pushWait(frame)) {
+                break;
+            }
+        }
+        captured.close();
+    }
+
+    void workerLoop() {
+        Frame frame;
+        while (captured.pop(frame)) {
+            std::pair<Frame, Result> item;
+            item.first = frame;
+            process(item.first, item.second);
+            workerStage.tick();
+            if (live) {
+                processed.push(item);
+            } else {
+                processed.pushWait(item);
+            }
+        }
+        // the last worker to finish closes the output queue
+        if (--activeWorkers == 0) {
+            processed.close();
+        }
+    }
+
+    framesource::FrameSource &source;
+    ProcessFn process;
+    SinkFn sink;
+    int numWorkers;
+    bool live;
+    std::atomic<bool> running;
+    std::atomic<int> activeWorkers;
+    RingBuffer<Frame> captured;
+    RingBuffer<std::pair<Frame, Result> > processed;
+    StageStats captureStage;
+    StageStats workerStage;
+    StageStats sinkStage;
+};
+
+// Draw a stats line at the bottom left of a frame
+void drawStats(cv::Mat &frame, const std::string &text);
+
+}  // namespace pipeline
+
+#endif /* pipeline_hpp */
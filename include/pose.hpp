@@ -0,0 +1,63 @@
+// pose.hpp
+
+#ifndef pose_hpp
+#define pose_hpp
+
+#include <opencv2/core/mat.hpp>
+#include <vector>
+
+namespace pose {
+
+// Solver report of one frame
+struct SolveStats {
+    bool warmStart;    // seeded from the predicted pose instead of a closed-form solve
+    int refinements;   // Levenberg-Marquardt refinements, 2 when a rejected warm start was solved again cold
+    double solveMs;    // latency of the whole solve, including the convergence checks
+    double errorPx;    // RMS reprojection error of the measured pose
+
+    SolveStats() : warmStart(false), refinements(0), solveMs(0), errorPx(0) {}
+};
+
+// RMS reprojection error of a pose in pixels, projected is a reusable buffer
+double reprojectionError(const std::vector<cv::Point3f> &point_set, const std::vector<cv::Point2f> &corner_set,
+                         const cv::Mat &cameraMatrix, const cv::Mat &distCoeffs, const cv::Mat &rvec, const cv::Mat &tvec,
+                         std::vector<cv::Point2f> &projected);
+
+// Pose estimation across frames of one stream.
+// The solve is seeded with the pose predicted from the previous frames and refined by a single Levenberg-Marquardt
+// run, instead of a closed-form solve followed by one. The measured poses are smoothed by a constant-velocity alpha-beta filter
+// over the six components of rvec/tvec, which removes the frame-to-frame jitter of the overlay.
+class PoseTracker {
+public:
+    // alpha and beta are the position and velocity gains of the filter, 1 and 0 disable the smoothing;
+    // maxIterations bounds each Levenberg-Marquardt run
+    PoseTracker(double alpha = 0.6, double beta = 0.2, int maxIterations = 20);
+
+    // solve the pose of frame frameIndex, rvec/tvec (3x1 CV_64F) receive the filtered pose
+    bool estimate(const std::vector<cv::Point3f> &point_set, const std::vector<cv::Point2f> &corner_set,
+                  const cv::Mat &cameraMatrix, const cv::Mat &distCoeffs, long frameIndex, cv::Mat &rvec, cv::Mat &tvec);
+    // the board was lost, the next solve starts cold
+    void reset();
+
+    const SolveStats &lastStats() const { return stats; }
+
+private:
+    void refine(const std::vector<cv::Point3f> &point_set, const std::vector<cv::Point2f> &corner_set,
+               const cv::Mat &cameraMatrix, const cv::Mat &distCoeffs, double &error);
+    void filter(long frameIndex);
+
+    double alpha, beta;
+    int maxIterations;
+    bool hasState;
+    long lastIndex;
+    double state[6];     // filtered rvec, tvec
+    double velocity[6];  // per frame
+    cv::Mat rvecMeasured, tvecMeasured;  // 3x1 CV_64F, solved in place
+    cv::Mat rvecSeed, tvecSeed;          // the pose before a refinement, restored when it does not improve
+    std::vector<cv::Point2f> projected;
+    SolveStats stats;
+};
+
+}  // namespace pose
+
+#endif /* pose_hpp */
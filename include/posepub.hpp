@@ -0,0 +1,106 @@
+// posepub.hpp
+
+#ifndef posepub_hpp
+#define posepub_hpp
+
+#include <stdint.h>
+
+#include <opencv2/core/mat.hpp>
+#include <string>
+#include <vector>
+
+#include "shmring.hpp"
+
+namespace posepub {
+
+// where the poses of a message come from
+const int32_t SOURCE_CHESSBOARD = 0;  // one pose for the whole board, id -1
+const int32_t SOURCE_ARUCO = 1;       // one pose per marker, id is the marker id
+
+// Start of each message in the shared memory ring.
+// The offsets are from the start of the message, so a reader needs no knowledge of the writer's limits.
+#pragma pack(push, 1)
+struct MessageHeader {
+    int64_t frameIndex;
+    int64_t timestampNs;  // steady clock when the message was committed, see telemetry::nowNs
+    int32_t source;
+    int32_t poseCount;
+    int32_t cornerCount;  // corners of all the poses
+    int32_t imageWidth;   // 0 when the message carries no image
+    int32_t imageHeight;
+    int32_t imageType;  // OpenCV type, e.g. CV_8UC3
+    uint32_t posesOffset;
+    uint32_t cornersOffset;  // cornerCount pairs of float x, y
+    uint32_t imageOffset;    // the rows of pixels without padding
+    uint32_t reserved;
+};
+
+struct PoseEntry {
+    int32_t id;
+    int32_t firstCorner;  // into the corners of the message
+    int32_t cornerCount;
+    int32_t reserved;
+    double rvec[3];
+    double tvec[3];
+};
+#pragma pack(pop)
+
+// Writes the poses of each frame, with their ids and image corners and optionally the annotated frame,
+// into a shmring::ShmRing. Everything is written in place in the slot, so a message costs one copy of the image.
+// The ring is created on the first message and again whenever the image size changes.
+class Publisher {
+public:
+    // maxPoses and maxCorners bound a message, extra poses are not published
+    Publisher(const std::string &name, int maxPoses = 64, int maxCorners = 512, uint32_t slotCount = 8);
+
+    // start the message of a frame, image is copied when it is not empty
+    bool begin(int64_t frameIndex, int32_t source, const cv::Mat &image);
+    // rvec and tvec are 3 doubles, as from solvePnP or estimatePoseSingleMarkers
+    bool addPose(int id, const cv::Vec3d &rvec, const cv::Vec3d &tvec, const std::vector<cv::Point2f> &corners);
+    // commit the message, readers see it from now on
+    void end();
+    void close();
+
+    const std::string &getName() const { return name; }
+
+private:
+    std::string name;
+    int maxPoses, maxCorners;
+    uint32_t slotCount;
+    shmring::ShmRing ring;
+    MessageHeader *message;  // in the slot being written, NULL outside begin/end
+};
+
+// Reads the newest message of a Publisher in place.
+// A message is only valid if stillValid() returns true after it has been used, otherwise it was
+// overwritten while being read and must be discarded.
+class Subscriber {
+public:
+    Subscriber() : current(0) {}
+
+    bool open(const char *name);
+    void close();
+    bool isOpen() const { return ring.isOpen(); }
+
+    // the newest message, NULL if none was published yet
+    const MessageHeader *latest();
+    bool stillValid() const;
+    // write order of the message returned by latest()
+    uint64_t index() const { return current; }
+    // how many messages the writer committed, a writer that stopped committing may have recreated the ring
+    uint64_t writeCount() const { return ring.writeCount(); }
+
+private:
+    shmring::ShmRing ring;
+    uint64_t current;
+};
+
+// views into a message, pointing into shared memory
+const PoseEntry *poses(const MessageHeader *message);
+const cv::Point2f *corners(const MessageHeader *message);
+// a Mat header over the pixels, empty when the message carries no image
+cv::Mat image(const MessageHeader *message);
+
+}  // namespace posepub
+
+#endif /* posepub_hpp */
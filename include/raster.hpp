@@ -0,0 +1,54 @@
+// raster.hpp
+
+#ifndef raster_hpp
+#define raster_hpp
+
+#include <opencv2/core/mat.hpp>
+#include <vector>
+
+namespace raster {
+
+// One corner of a triangle, in pixels with its camera depth and color
+struct Vertex {
+    float x, y;
+    float z;        // distance along the optical axis, in the units of the pose
+    float b, g, r;  // 0..255, interpolated across the triangle
+};
+
+// Software rasterizer of filled, depth-tested triangles onto an 8-bit BGR frame.
+// Triangles are set up four at a time with universal intrinsics (edge functions and the planes of 1/z and
+// the color channels), binned into square tiles, and the tiles are rasterized in parallel, four pixels at a time.
+// Each tile clears its part of the depth buffer before use, so untouched tiles cost nothing.
+// Depth is 1/z interpolated in screen space, colors are interpolated affinely.
+class Rasterizer {
+public:
+    explicit Rasterizer(int tileSize = 64);
+
+    // draw vertices.size() / 3 triangles, a triangle with a corner closer than nearZ is skipped
+    void draw(cv::Mat &frame, const std::vector<Vertex> &vertices, float nearZ = 1e-3f);
+
+    // triangles that reached the bins in the last draw
+    int lastTriangles() const { return (int)setups.size(); }
+
+private:
+    // everything the inner loop needs from one triangle, each plane as value = dx * x + dy * y + c
+    struct Setup {
+        float edge[3][3];  // A, B, C of the three edge functions, all >= 0 inside
+        float plane[4][3];  // 1/z, b, g, r
+        int minX, minY, maxX, maxY;
+    };
+
+    void setupTriangles(const std::vector<Vertex> &vertices, cv::Size frameSize, float nearZ);
+    void rasterizeTile(cv::Mat &frame, int tile);
+
+    int tileSize;
+    int tilesX, tilesY;
+    cv::Mat depth;  // CV_32F, 1/z of the closest surface, 0 where nothing was drawn
+    std::vector<Setup> setups;
+    std::vector<std::vector<int> > bins;  // triangles overlapping each tile, in draw order
+    std::vector<int> activeTiles;
+};
+
+}  // namespace raster
+
+#endif /* raster_hpp */
@@ -0,0 +1,109 @@
+// scene.hpp
+
+#ifndef scene_hpp
+#define scene_hpp
+
+#include <opencv2/core/mat.hpp>
+#include <vector>
+
+#include "raster.hpp"
+
+namespace scene {
+
+// Geometry in its own units: vertices, edges as pairs of vertex indices, and optional faces as triangles
+struct Mesh {
+    std::vector<cv::Point3f> vertices;
+    std::vector<int> edges;               // 2 indices per edge
+    std::vector<cv::Scalar> edgeColors;   // one per edge
+    int thickness;
+    bool arrows;                          // draw edges as arrows from their first vertex
+    std::vector<int> triangles;           // 3 indices per face, any winding
+    std::vector<cv::Scalar> faceColors;   // one per triangle
+
+    Mesh() : thickness(2), arrows(false) {}
+
+    void addEdge(int from, int to, const cv::Scalar &color);
+    void addTriangle(int a, int b, int c, const cv::Scalar &color);
+};
+
+// How the faces of meshes are drawn. In the solid modes a mesh with faces is drawn filled and depth-tested,
+// and only the edges of meshes without faces (e.g. the axes) are drawn on top.
+enum Shading {
+    SHADING_WIREFRAME,  // edges only
+    SHADING_FLAT,       // one color per face, lit from the camera
+    SHADING_GOURAUD     // lit per vertex with averaged normals, interpolated across the faces
+};
+
+// the three axes of ar::project3DAxes, x red, y green, z blue
+Mesh makeAxes(float length = 1.0f);
+// a box with one corner at the origin, spanning +x, -y and +z like the board, edges and sides colored in turn
+Mesh makeBox(float width, float height, float depth);
+// the vertices, face outlines and triangulated faces of a Wavefront OBJ file, all in one color
+bool loadOBJ(const char *path, Mesh &mesh, const cv::Scalar &color);
+
+// object-to-board transforms
+cv::Matx44f translation(float x, float y, float z);
+cv::Matx44f scaling(float s);
+// OBJ models are y-up, the board's z axis comes towards the viewer
+cv::Matx44f yUpToBoard();
+
+// Virtual objects placed on the board.
+// Every object's vertices are baked into one board-space vertex buffer when objects change,
+// so a frame costs one projectPoints call for all objects and one pass over the edge index buffer,
+// plus one raster::Rasterizer draw of all the faces in the solid shading modes.
+class Scene {
+public:
+    Scene();
+
+    // returns the object id
+    int add(const Mesh &mesh, const cv::Matx44f &transform = cv::Matx44f::eye());
+    void setTransform(int id, const cv::Matx44f &transform);
+    void setVisible(int id, bool visible);
+    void setShading(Shading shading) { this->shading = shading; }
+
+    // project every visible object with the board pose and draw it onto frame
+    void render(cv::Mat &frame, const cv::Mat &cameraMatrix, const cv::Mat &distCoeffs, const cv::Mat &rvec, const cv::Mat &tvec);
+
+    int numObjects() const { return (int)objects.size(); }
+    int numVertices() const { return (int)boardVertices.size(); }
+    int numEdges() const { return (int)indices.size() / 2; }
+    int numTriangles() const { return (int)triangles.size() / 3; }
+
+private:
+    struct Object {
+        Mesh mesh;
+        cv::Matx44f transform;
+        bool visible;
+    };
+
+    void rebuild();
+    void fill(cv::Mat &frame);
+
+    std::vector<Object> objects;
+    bool dirty;
+    Shading shading;
+
+    // buffers of all visible objects, rebuilt only when dirty
+    std::vector<cv::Point3f> boardVertices;
+    std::vector<int> indices;
+    std::vector<cv::Scalar> colors;
+    std::vector<int> thickness;
+    std::vector<bool> arrows;
+    std::vector<bool> solid;  // the edge belongs to a mesh with faces
+    std::vector<int> triangles;
+    std::vector<cv::Scalar> triangleColors;
+    std::vector<cv::Point3f> normals;  // per vertex, board space, averaged over its faces
+
+    // per-frame buffers, reused
+    cv::Mat rotation;
+    std::vector<cv::Point2f> projected;
+    std::vector<bool> inFront;
+    std::vector<cv::Point3f> cameraVertices;
+    std::vector<float> intensity;
+    std::vector<raster::Vertex> rasterVertices;
+    raster::Rasterizer rasterizer;
+};
+
+}  // namespace scene
+
+#endif /* scene_hpp */
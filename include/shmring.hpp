@@ -0,0 +1,80 @@
+// shmring.hpp
+
+#ifndef shmring_hpp
+#define shmring_hpp
+
+#include <stdint.h>
+
+#include <atomic>
+#include <cstddef>
+
+namespace shmring {
+
+const char MAGIC[4] = {'S', 'H', 'M', 'R'};
+const uint32_t VERSION = 1;
+
+// Start of the shared memory object, followed by slotCount slots of SlotHeader + slotSize bytes,
+// each slot aligned to a cache line.
+struct RingHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t slotCount;
+    uint32_t slotStride;               // bytes from one slot to the next
+    uint64_t slotSize;                 // payload capacity of a slot
+    std::atomic<uint64_t> writeCount;  // number of completed writes
+    uint8_t reserved[32];
+};
+
+// Seqlock of one slot: odd while the writer is copying, even and increasing once the payload is complete
+struct SlotHeader {
+    std::atomic<uint64_t> sequence;
+    uint64_t size;
+    uint8_t reserved[48];
+};
+
+// Single-writer, multi-reader ring of fixed size slots in POSIX shared memory (shm_open + mmap).
+// The writer never waits for readers: a slow reader detects a slot overwritten under it through the
+// slot's sequence number and retries, so readers always get a complete copy of a recent item.
+class ShmRing {
+public:
+    ShmRing();
+    ~ShmRing();
+
+    // writer side, replaces an existing object of the same name
+    bool create(const char *name, uint32_t slotCount, size_t slotSize);
+    // reader side, the object must have been created by a writer
+    bool open(const char *name);
+    // unmap, and remove the name if this side created it
+    void close();
+    bool isOpen() const { return header != NULL; }
+
+    size_t slotSize() const { return header->slotSize; }
+    uint32_t slotCount() const { return header->slotCount; }
+    uint64_t writeCount() const { return header->writeCount.load(std::memory_order_acquire); }
+
+    // writer: the payload of the next slot, to fill in place before endWrite
+    uint8_t *beginWrite();
+    void endWrite(size_t size);
+    // writer: beginWrite, one copy, endWrite
+    void write(const void *data, size_t size);
+
+    // reader: copy the newest complete item, returns false if nothing was written yet or the writer kept overtaking the read
+    bool readLatest(void *buffer, size_t capacity, size_t &size, uint64_t &index) const;
+    // reader: the payload of the newest complete item in place, without a copy, NULL if nothing was written yet.
+    // The writer may overwrite it at any time, whatever was read from it is only valid if validate(index) holds afterwards.
+    const uint8_t *peekLatest(size_t &size, uint64_t &index) const;
+    bool validate(uint64_t index) const;
+
+private:
+    SlotHeader *slot(uint64_t index) const;
+
+    RingHeader *header;
+    size_t mappedSize;
+    char name[64];
+    bool owner;
+    uint64_t writing;
+};
+
+}  // namespace shmring
+
+#endif /* shmring_hpp */
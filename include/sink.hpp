@@ -0,0 +1,141 @@
+// sink.hpp
+
+#ifndef sink_hpp
+#define sink_hpp
+
+#include <stdint.h>
+
+#include <atomic>
+#include <opencv2/core/mat.hpp>
+#include <opencv2/videoio.hpp>
+#include <string>
+#include <thread>
+
+#include "pipeline.hpp"
+#include "shmring.hpp"
+
+namespace sink {
+
+// Destination of the frames of a live loop: a window, or one of the headless outputs.
+// write() is called from the pipeline's sink stage, on the main thread.
+class FrameSink {
+public:
+    virtual ~FrameSink() {}
+
+    // the sink may keep a reference to the frame, so it must not be drawn on afterwards
+    virtual void write(const cv::Mat &frame) = 0;
+    // the key pressed within delayMs, -1 if there is none or no window to press it in
+    virtual int pollKey(int delayMs) { return -1; }
+    // finish pending writes
+    virtual void close() {}
+    // frames skipped because the output fell behind
+    virtual long dropped() const { return 0; }
+};
+
+// imshow/waitKey, the only interactive sink
+class WindowSink : public FrameSink {
+public:
+    WindowSink(const std::string &windowName);
+    void write(const cv::Mat &frame);
+    int pollKey(int delayMs);
+
+private:
+    std::string windowName;
+};
+
+// discards every frame, for pure throughput runs
+class NullSink : public FrameSink {
+public:
+    void write(const cv::Mat &frame) {}
+};
+
+// Hands frames to an output thread through a RingBuffer that drops the oldest frame,
+// so a slow encoder or disk never stalls the detection stages.
+class AsyncSink : public FrameSink {
+public:
+    AsyncSink(size_t queueCapacity);
+    ~AsyncSink();
+
+    void write(const cv::Mat &frame);
+    void close();
+    long dropped() const { return queue.dropped(); }
+
+protected:
+    // runs on the output thread, in write order
+    virtual void encode(const cv::Mat &frame) = 0;
+    void start();
+
+private:
+    void outputLoop();
+
+    pipeline::RingBuffer<cv::Mat> queue;
+    std::thread outputThread;
+    bool started;
+};
+
+// encoded video file, MJPG for .avi and mp4v otherwise; the writer opens on the first frame, whose size it takes
+class VideoFileSink : public AsyncSink {
+public:
+    VideoFileSink(const std::string &path, double fps = 30, size_t queueCapacity = 8);
+    ~VideoFileSink();
+
+protected:
+    void encode(const cv::Mat &frame);
+
+private:
+    std::string path;
+    double fps;
+    cv::VideoWriter writer;
+    bool failed;
+};
+
+// numbered images, pattern is a printf pattern of the frame number such as out/frame_%06d.png
+class ImageSequenceSink : public AsyncSink {
+public:
+    ImageSequenceSink(const std::string &pattern, size_t queueCapacity = 8);
+    ~ImageSequenceSink();
+
+protected:
+    void encode(const cv::Mat &frame);
+
+private:
+    std::string pattern;
+    long index;
+};
+
+// Header of each frame in the shared memory ring, followed by the rows of pixels without padding
+struct ShmFrameHeader {
+    int32_t width;
+    int32_t height;
+    int32_t type;  // OpenCV type, e.g. CV_8UC3
+    int32_t reserved;
+    int64_t index;  // write order
+};
+
+// raw frames in a shmring::ShmRing, written synchronously since it is a single copy;
+// the ring is created on the first frame and again whenever the frame size changes
+class ShmSink : public FrameSink {
+public:
+    ShmSink(const std::string &name, uint32_t slotCount = 4);
+    void write(const cv::Mat &frame);
+    void close();
+
+private:
+    std::string name;
+    uint32_t slotCount;
+    shmring::ShmRing ring;
+    int64_t index;
+};
+
+// Sink from a command line spec:
+//   window          the "windowName" window, the default
+//   null            no output
+//   video:<path>    encoded video file
+//   images:<pattern>  numbered image files, the pattern has exactly one integer conversion such as %06d
+//   shm:<name>      POSIX shared memory ring, e.g. shm:/ar_frames
+// returns NULL for an unknown spec or an invalid images pattern
+FrameSink *create(const std::string &spec, const std::string &windowName);
+
+}  // namespace sink
+
+#endif /* sink_hpp */
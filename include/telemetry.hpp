@@ -0,0 +1,115 @@
+// telemetry.hpp
+
+#ifndef telemetry_hpp
+#define telemetry_hpp
+
+#include <stdint.h>
+
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace telemetry {
+
+const char MAGIC[4] = {'T', 'L', 'M', 'Y'};
+const uint32_t VERSION = 1;
+
+// record flags
+const uint32_t FLAG_FOUND = 1;       // the board was found and a pose solved
+const uint32_t FLAG_WARM_START = 2;  // the pose was solved from the predicted pose
+const uint32_t FLAG_FLOW = 4;        // the corners were propagated by optical flow, no detection ran
+
+// One frame of one stream, written to the log as is.
+// All fields are little-endian.
+#pragma pack(push, 1)
+struct Record {
+    int64_t timestampNs;  // steady clock, when the frame finished processing
+    int64_t frameIndex;
+    int32_t stream;
+    uint32_t flags;
+    double rvec[3];
+    double tvec[3];
+    float reprojectionError;  // RMS, pixels
+    float detectMs;           // chessboard search
+    float solveMs;            // pose estimation
+    float renderMs;           // virtual objects
+    int32_t iterations;       // Levenberg-Marquardt refinements of the solve, 0 when not reported
+    uint32_t reserved;
+};
+
+// Start of a log file, followed by Records until the end of the file
+struct FileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t recordSize;
+    uint32_t reserved;
+};
+#pragma pack(pop)
+
+int64_t nowNs();
+
+// Lock-free ring between one producer thread and one consumer thread.
+// push() never blocks: when the ring is full the record is dropped and counted.
+class SpscRing {
+public:
+    // capacity is rounded up to a power of two
+    explicit SpscRing(size_t capacity);
+
+    bool push(const Record &record);
+    bool pop(Record &record);
+    long dropped() const { return numDropped.load(std::memory_order_relaxed); }
+
+private:
+    std::vector<Record> slots;
+    size_t mask;
+    // head and tail padded onto their own cache lines, so producer and consumer do not share one
+    char pad0[64];
+    std::atomic<size_t> head;  // next slot to read, written by the consumer
+    char pad1[64];
+    std::atomic<size_t> tail;  // next slot to write, written by the producer
+    char pad2[64];
+    std::atomic<long> numDropped;
+};
+
+// Collects Records from any number of threads, each through its own SpscRing, so record() takes no lock.
+// A background thread drains the rings into a binary log and prints the newest record on the console
+// at most once per consoleInterval.
+class Recorder {
+public:
+    // path NULL writes no log, consoleInterval 0 prints nothing
+    Recorder(const char *path, double consoleInterval = 1.0, size_t ringCapacity = 4096);
+    ~Recorder();
+
+    bool isOpen() const { return file != NULL; }
+    void record(const Record &record);
+    // drain what is left and close the log
+    void close();
+    long dropped() const;
+    long written() const { return numWritten; }
+
+private:
+    SpscRing &ringOfThisThread();
+    void drainLoop();
+    bool drain();
+    void printRecord(const Record &record);
+
+    long id;  // tells the per-thread ring caches of different recorders apart
+    FILE *file;
+    double consoleInterval;
+    size_t ringCapacity;
+    mutable std::mutex ringsMutex;
+    std::vector<std::unique_ptr<SpscRing> > rings;
+    std::atomic<bool> running;
+    std::thread drainThread;
+    long numWritten;
+    int64_t lastPrintNs;
+    Record latest;
+    bool hasLatest;
+};
+
+}  // namespace telemetry
+
+#endif /* telemetry_hpp */
@@ -0,0 +1,56 @@
+// undistort.hpp
+
+#ifndef undistort_hpp
+#define undistort_hpp
+
+#include <stdint.h>
+
+#include <opencv2/core/mat.hpp>
+#include <string>
+
+namespace undistort {
+
+// Cache key of a calibration, a hash of the camera matrix, the distortion coefficients and the frame size
+uint32_t calibrationKey(const cv::Mat &cameraMatrix, const cv::Mat &distCoeffs, cv::Size frameSize);
+
+// On-disk cache of initUndistortRectifyMap outputs in fixed-point form (CV_16SC2 + CV_16UC1).
+// Entries are calibfile binary files named after their key, so a restart reuses the maps instead of rebuilding them.
+class MapCache {
+public:
+    MapCache(const std::string &cacheDir = "../data/cache");
+
+    // load the maps of a calibration, or build and store them on a miss
+    bool get(const cv::Mat &cameraMatrix, const cv::Mat &distCoeffs, cv::Size frameSize, cv::Mat &map1, cv::Mat &map2);
+    std::string entryPath(uint32_t key, cv::Size frameSize) const;
+
+private:
+    std::string cacheDir;
+};
+
+// Undistorts whole frames with a single remap, so that the rest of the pipeline can use a zero-distortion model.
+// The remapped frames keep the original camera matrix, and the distortion coefficients become empty.
+class Undistorter {
+public:
+    Undistorter(const cv::Mat &cameraMatrix, const cv::Mat &distCoeffs, MapCache &cache);
+
+    // remap the frame in place, the maps are fetched again when the frame size changes
+    void apply(cv::Mat &frame);
+
+    cv::Mat &cameraMatrix() { return newCameraMatrix; }
+    // empty, which every calib3d function treats as zero distortion
+    cv::Mat &distCoeffs() { return zeroDistortion; }
+
+private:
+    cv::Mat originalCameraMatrix;
+    cv::Mat originalDistCoeffs;
+    cv::Mat newCameraMatrix;
+    cv::Mat zeroDistortion;
+    MapCache &cache;
+    cv::Size mapSize;
+    cv::Mat map1, map2;
+    cv::Mat remapped;
+};
+
+}  // namespace undistort
+
+#endif /* undistort_hpp */
@@ -0,0 +1,71 @@
+#include "allocdebug.hpp"
+
+#include <cstdlib>
+#include <new>
+#include <opencv2/opencv.hpp>
+
+using namespace cv;
+using namespace allocdebug;
+
+#ifdef AR_ALLOC_DEBUG
+
+// per thread, so the capture and display threads do not show up in a worker's count
+static thread_local long numAllocations = 0;
+
+// Replacements of the global allocation functions, new[] and the nothrow forms forward to these
+void *operator new(size_t size) {
+    numAllocations++;
+    void *p = malloc(size == 0 ? 1 : size);
+    if (p == NULL) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+// Counts cv::Mat buffer allocations, and leaves the work to OpenCV's standard allocator
+class CountingAllocator : public cv::MatAllocator {
+public:
+    CountingAllocator() : base(cv::Mat::getStdAllocator()) {}
+
+    cv::UMatData *allocate(int dims, const int *sizes, int type, void *data, size_t *step, cv::AccessFlag flags, cv::UMatUsageFlags usageFlags) const {
+        // user data is wrapped, not allocated
+        if (data == NULL) {
+            numAllocations++;
+        }
+        return base->allocate(dims, sizes, type, data, step, flags, usageFlags);
+    }
+
+    bool allocate(cv::UMatData *data, cv::AccessFlag accessflags, cv::UMatUsageFlags usageFlags) const {
+        return base->allocate(data, accessflags, usageFlags);
+    }
+
+    void deallocate(cv::UMatData *data) const {
+        base->deallocate(data);
+    }
+
+private:
+    cv::MatAllocator *base;
+};
+
+void allocdebug::install() {
+    static CountingAllocator allocator;
+    cv::Mat::setDefaultAllocator(&allocator);
+}
+
+long allocdebug::count() {
+    return numAllocations;
+}
+
+#else
+
+void allocdebug::install() {}
+
+long allocdebug::count() {
+    return -1;
+}
+
+#endif
@@ -6,67 +6,16 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
-#include <fstream>
-#include <iostream>
 #include <opencv2/opencv.hpp>
-#include <sstream>
 #include <string>
 #include <vector>
 
+#include "calibration.hpp"
+
 using namespace cv;
 using namespace std;
 using namespace ar;
 
-// Load camera calibration info from a .txt file
-void ar::readCameraCalibrationInfo(const char *cameraCalibrationFile, cv::Mat &cameraMatrix, std::vector<double> &coeffs) {
-    ifstream infile(cameraCalibrationFile);
-
-    if (!infile.is_open()) {
-        printf("calibration file cannot be opened. check its input path....\n");
-        exit(-1);
-    } else {
-        string line;
-
-        // load cameraMatrix info
-        printf("\nloading cameraMatrix info...\n");
-        for (int i = 0; i < 3; i++) {
-            std::getline(infile, line);
-
-            // split a string by delimeter
-            // https://www.techiedelight.com/split-string-cpp-using-delimiter/
-            size_t start;
-            size_t end = 0;
-
-            int idx = 0;
-            while ((start = line.find_first_not_of(" ", end)) != std::string::npos) {
-                end = line.find(" ", start);
-                string temp = line.substr(start, end - start);
-
-                cameraMatrix.at<double>(i, idx) = stod(temp);
-                printf("%lf\n", cameraMatrix.at<double>(i, idx));
-                idx++;
-            }
-        }
-
-        printf("\nloading co-efficients info...\n");
-        std::getline(infile, line);
-
-        // https://www.techiedelight.com/split-string-cpp-using-delimiter/
-        size_t start;
-        size_t end = 0;
-
-        int idx = 0;
-        while ((start = line.find_first_not_of(" ", end)) != std::string::npos) {
-            end = line.find(" ", start);
-            string temp = line.substr(start, end - start);
-
-            coeffs.push_back(stod(temp));
-            printf("%lf\n", coeffs[idx]);
-            idx++;
-        }
-    }
-}
-
 // Project 3D Axes:
 // use the projectPoints function to project the 3D points corresponding to the four outside corners of the chessboard onto the image plane
 // in real time as the chessboard or camera moves around.
@@ -74,12 +23,13 @@ void ar::project3DAxes(cv::Mat &frame, cv::Mat &cameraMatrix, cv::Mat &distCoeff
     // projectPoints()
     // https://docs.opencv.org/3.4/d9/d0c/group__calib3d.html#ga1019495a2c8d1743ed5cc23fa0daff8c
 
-    std::vector<Point3f> axesPointsIn3DUnits{
+    // constant, and the output buffer is reused by each thread, so the per-frame call does not allocate
+    static const std::vector<Point3f> axesPointsIn3DUnits{
         {0, 0, 0},   // 0
         {1, 0, 0},   // x
         {0, -1, 0},  // y
         {0, 0, 1}};  // z
-    std::vector<Point2f> axesPointsInImage;
+    static thread_local std::vector<Point2f> axesPointsInImage;
 
     cv::projectPoints(axesPointsIn3DUnits, rvec, tvec, cameraMatrix, distCoeffs, axesPointsInImage);
 
@@ -92,17 +42,18 @@ void ar::project3DAxes(cv::Mat &frame, cv::Mat &cameraMatrix, cv::Mat &distCoeff
 // Project 3D Triangular:
 // Reference - https://gist.github.com/MareArts/54011c365ec0d66d59562945df13dbfe
 void ar::project3DTriangular(cv::Mat &frame, float x, float y, cv::Mat &cameraMatrix, cv::Mat &distCoeffs, cv::Mat &rvec, cv::Mat &tvec) {
-    std::vector<Point3f> axesPointsIn3DUnits{
-        {x, y, 0},                 // upper left
-        {x + 2.0f, y, 0},          // upper right
-        {x, y - 2.0f, 0},          // bottom left
-        {x + 2.0f, y - 2.0f, 0},   // bottom right
-        {x, y, 4},                 // upper left
-        {x + 2.0f, y, 4},          // upper right
-        {x, y - 2.0f, 4},          // bottom left
-        {x + 2.0f, y - 2.0f, 4},   // bottom right
-        {x + 1.0f, y - 1.0f, 4}};  // center z
-    std::vector<Point2f> axesPointsInImage;
+    // per-thread buffers, refilled in place so the per-frame call does not allocate
+    static thread_local std::vector<Point3f> axesPointsIn3DUnits(9);
+    static thread_local std::vector<Point2f> axesPointsInImage;
+    axesPointsIn3DUnits[0] = Point3f(x, y, 0);                 // upper left
+    axesPointsIn3DUnits[1] = Point3f(x + 2.0f, y, 0);          // upper right
+    axesPointsIn3DUnits[2] = Point3f(x, y - 2.0f, 0);          // bottom left
+    axesPointsIn3DUnits[3] = Point3f(x + 2.0f, y - 2.0f, 0);   // bottom right
+    axesPointsIn3DUnits[4] = Point3f(x, y, 4);                 // upper left
+    axesPointsIn3DUnits[5] = Point3f(x + 2.0f, y, 4);          // upper right
+    axesPointsIn3DUnits[6] = Point3f(x, y - 2.0f, 4);          // bottom left
+    axesPointsIn3DUnits[7] = Point3f(x + 2.0f, y - 2.0f, 4);   // bottom right
+    axesPointsIn3DUnits[8] = Point3f(x + 1.0f, y - 1.0f, 4);   // center z
 
     cv::projectPoints(axesPointsIn3DUnits, rvec, tvec, cameraMatrix, distCoeffs, axesPointsInImage);
 
@@ -124,14 +75,111 @@ void ar::project3DTriangular(cv::Mat &frame, float x, float y, cv::Mat &cameraMa
     cv::line(frame, axesPointsInImage[1], axesPointsInImage[5], G, 2);
     cv::line(frame, axesPointsInImage[2], axesPointsInImage[6], B, 2);
     cv::line(frame, axesPointsInImage[3], axesPointsInImage[7], ORIANGE, 2);
+}
+
+ar::FrameContext::FrameContext(cv::Size boardSize) : boardSize(boardSize) {
+    point_set = calibration::get3DWorldUnits(this->boardSize);
+    corner_set.reserve(boardSize.area());
+    rvec = Mat::zeros(3, 1, CV_64F);
+    tvec = Mat::zeros(3, 1, CV_64F);
+}
 
-    // push points in 2D image into contours
-    std::vector<Point2f> contours;
-    contours.push_back(axesPointsInImage[0]);
-    contours.push_back(axesPointsInImage[1]);
-    contours.push_back(axesPointsInImage[4]);
+cv::Mat &ar::reusableBuffer(std::vector<cv::Mat> &pool) {
+    for (int i = 0; i < pool.size(); i++) {
+        if (pool[i].u == NULL || pool[i].u->refcount == 1) {
+            return pool[i];
+        }
+    }
+    // every buffer is still in use downstream, grow the pool
+    pool.push_back(cv::Mat());
+    return pool.back();
+}
+
+ar::BoardTracker::BoardTracker(cv::Size boardSize, float padding) : boardSize(boardSize), padding(padding), hasPose(false), hasPrevPose(false), numRoiSearches(0), numFullSearches(0) {
+    // the four outer corners of the board, in the same world units as calibration::get3DWorldUnits
+    float w = boardSize.width - 1;
+    float h = boardSize.height - 1;
+    outerCorners.push_back(Point3f(0, 0, 0));
+    outerCorners.push_back(Point3f(w, 0, 0));
+    outerCorners.push_back(Point3f(w, -h, 0));
+    outerCorners.push_back(Point3f(0, -h, 0));
+}
 
-    // draw filled surface
-    // https://docs.opencv.org/4.x/d6/d6e/group__imgproc__draw.html#ga746c0625f1781f1ffc9056259103edbc
-    // cv::drawContours(frame, contours, 0, ORIANGE, 2);
+void ar::BoardTracker::reset() {
+    lastCorners.clear();
+    hasPose = false;
+    hasPrevPose = false;
+}
+
+// The pose buffers are copied into, not reassigned, so tracking does not allocate once warm
+void ar::BoardTracker::updatePose(cv::Mat &rvec, cv::Mat &tvec, cv::Mat &cameraMatrix, cv::Mat &distCoeffs) {
+    if (hasPose) {
+        rvecLast.copyTo(rvecPrev);
+        tvecLast.copyTo(tvecPrev);
+        hasPrevPose = true;
+    }
+    rvec.copyTo(rvecLast);
+    tvec.copyTo(tvecLast);
+    hasPose = true;
+    this->cameraMatrix = cameraMatrix;
+    this->distCoeffs = distCoeffs;
+}
+
+// Predict where the board will be in the next frame.
+// With two poses, the board is moved forward at constant velocity and its outer corners are projected.
+// The bounding box of the last corners is always included, so a wrong extrapolation only grows the region.
+bool ar::BoardTracker::predictROI(cv::Size frameSize, cv::Rect &roi) {
+    if (lastCorners.empty()) {
+        return false;
+    }
+
+    cv::Rect box = cv::boundingRect(lastCorners);
+    if (hasPrevPose) {
+        cv::addWeighted(rvecLast, 2, rvecPrev, -1, 0, rvecNext);
+        cv::addWeighted(tvecLast, 2, tvecPrev, -1, 0, tvecNext);
+        cv::projectPoints(outerCorners, rvecNext, tvecNext, cameraMatrix, distCoeffs, predicted);
+        box |= cv::boundingRect(predicted);
+    }
+
+    // the detector needs the white border around the outer corners, at least one square on each side
+    int squareSize = std::max(box.width / boardSize.width, box.height / boardSize.height);
+    int margin = std::max((int)(padding * std::max(box.width, box.height)), 2 * squareSize);
+    box.x -= margin;
+    box.y -= margin;
+    box.width += 2 * margin;
+    box.height += 2 * margin;
+
+    roi = box & cv::Rect(0, 0, frameSize.width, frameSize.height);
+    return roi.area() > 0;
+}
+
+// Search the predicted region first, and the full frame only after a miss
+bool ar::BoardTracker::findCorners(cv::Mat &frame, std::vector<cv::Point2f> &corner_set) {
+    cv::Rect roi;
+    bool found = false;
+
+    if (predictROI(frame.size(), roi)) {
+        numRoiSearches++;
+        searchArea = roi;
+        found = cv::findChessboardCorners(frame(roi), boardSize, corner_set);
+        if (found) {
+            for (int i = 0; i < corner_set.size(); i++) {
+                corner_set[i].x += roi.x;
+                corner_set[i].y += roi.y;
+            }
+        }
+    }
+
+    if (!found) {
+        numFullSearches++;
+        searchArea = cv::Rect(0, 0, frame.cols, frame.rows);
+        found = cv::findChessboardCorners(frame, boardSize, corner_set);
+    }
+
+    if (found) {
+        lastCorners = corner_set;
+    } else {
+        reset();
+    }
+    return found;
 }
@@ -0,0 +1,291 @@
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <opencv2/aruco.hpp>
+#include <opencv2/opencv.hpp>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "arucotune.hpp"
+#include "imagefiles.hpp"
+
+using namespace cv;
+using namespace std;
+
+// One profile tried on the footage
+struct Trial {
+    arucotune::Profile profile;
+    double rate;          // reference markers found, 0..1
+    long falsePositives;  // markers the reference does not have
+    double meanMs, p99Ms;
+    bool front;
+};
+
+/* Helper method to get a percentile of sorted timings. */
+double percentile(std::vector<double> &sorted, double p) {
+    int index = (int)ceil(p * sorted.size()) - 1;
+    return sorted[std::min(std::max(index, 0), (int)sorted.size() - 1)];
+}
+
+/* Helper method to tell an image directory, an image or a .txt list file from a video, by the path alone. */
+bool isImageSource(const string &path) {
+    struct stat info;
+    if (stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode)) {
+        return true;
+    }
+    if (imagefiles::isImageFile(path)) {
+        return true;
+    }
+    string lower = path;
+    std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+    return lower.size() >= 4 && lower.compare(lower.size() - 4, 4, ".txt") == 0;
+}
+
+/* Helper method to load every step-th frame of a video, an image directory or a list file as gray, up to maxFrames. */
+std::vector<cv::Mat> loadFootage(const char *path, int maxFrames, int step) {
+    std::vector<cv::Mat> frames;
+    if (isImageSource(path)) {
+        std::vector<string> files = imagefiles::collect(path);
+        for (int i = 0; i < files.size() && frames.size() < maxFrames; i += step) {
+            cv::Mat frame = cv::imread(files[i], IMREAD_GRAYSCALE);
+            if (!frame.empty()) {
+                frames.push_back(frame);
+            }
+        }
+        return frames;
+    }
+
+    cv::VideoCapture video(path);
+    cv::Mat frame;
+    for (int i = 0; frames.size() < maxFrames && video.read(frame); i++) {
+        if (i % step == 0) {
+            cv::Mat gray;
+            cv::cvtColor(frame, gray, COLOR_BGR2GRAY);
+            frames.push_back(gray);
+        }
+    }
+    return frames;
+}
+
+/* Helper method to detect the markers of every frame with one profile, keeping their ids and the time of each frame. */
+void runProfile(const std::vector<cv::Mat> &frames, const arucotune::Profile &profile, const cv::Ptr<cv::aruco::Dictionary> &dictionary,
+                std::vector<std::vector<int> > &ids, std::vector<double> &timings) {
+    cv::Ptr<cv::aruco::DetectorParameters> parameters = profile.toParameters();
+    std::vector<std::vector<cv::Point2f> > corners;
+    ids.assign(frames.size(), std::vector<int>());
+    timings.clear();
+
+    // one untimed frame, so first-call allocations are not measured
+    cv::aruco::detectMarkers(frames[0], dictionary, corners, ids[0], parameters);
+    for (int i = 0; i < frames.size(); i++) {
+        int64 start = cv::getTickCount();
+        cv::aruco::detectMarkers(frames[i], dictionary, corners, ids[i], parameters);
+        timings.push_back((cv::getTickCount() - start) * 1000.0 / cv::getTickFrequency());
+    }
+    std::sort(timings.begin(), timings.end());
+}
+
+/* Helper method to count the markers of the reference found again per frame, and the ones the reference does not have. */
+void score(const std::vector<std::vector<int> > &reference, const std::vector<std::vector<int> > &ids, long &matched, long &extra) {
+    matched = extra = 0;
+    std::vector<int> expected, found;
+    for (int i = 0; i < reference.size(); i++) {
+        expected = reference[i];
+        found = ids[i];
+        std::sort(expected.begin(), expected.end());
+        std::sort(found.begin(), found.end());
+        std::vector<int> common;
+        std::set_intersection(expected.begin(), expected.end(), found.begin(), found.end(), std::back_inserter(common));
+        matched += common.size();
+        extra += found.size() - common.size();
+    }
+}
+
+/* Helper method to pick one value of a list at random. */
+template <typename T>
+T pick(cv::RNG &rng, const T *values, int count) {
+    return values[rng.uniform(0, count)];
+}
+
+/* Helper method to print a trial as a JSON line. */
+void printTrial(const Trial &trial, int index, bool defaults) {
+    printf("{\"trial\":%d,\"defaults\":%s,\"pareto\":%s,\"rate\":%.4f,\"false_positives\":%ld,\"mean_ms\":%.3f,\"p99_ms\":%.3f,\"profile\":\"%s\"}\n",
+           index, defaults ? "true" : "false", trial.front ? "true" : "false", trial.rate, trial.falsePositives,
+           trial.meanMs, trial.p99Ms, trial.profile.describe().c_str());
+}
+
+/*
+  Autotune the ArUco detector parameters on recorded footage.
+  Replays the frames with the DetectorParameters defaults and with randomly drawn profiles of the parameters that
+  cost time (threshold window sweep, perimeter limits, contour approximation, corner refinement). The detection rate
+  of a profile is the share of the markers found by a thorough reference profile that it finds in the same frames.
+  Prints one JSON line per profile on the Pareto front of detection rate against mean per-frame latency, then the
+  defaults, and saves the fastest front profile that reaches the minimum rate, for arucoProjector --profile.
+
+  Usage: arucoTune <video, image directory or .txt list file> [--frames <n>] [--step <n>] [--trials <n>] [--min-rate <r>]
+                   [--threads <n>] [--seed <n>] [--out <file>]
+    --frames <n>    frames replayed, default 100
+    --step <n>      keep every n-th frame of the footage, default 1
+    --trials <n>    profiles drawn besides the defaults, default 60
+    --min-rate <r>  detection rate the saved profile must reach, default 0.99
+    --threads <n>   OpenCV threads while detecting, default all
+    --seed <n>      seed of the random search, default 1
+    --out <file>    where the chosen profile goes, default aruco_profile.txt
+ */
+int main(int argc, char *argv[]) {
+    if (argc < 2 || argv[1][0] == '-') {
+        printf("Usage: arucoTune <video, image directory or .txt list file> [--frames <n>] [--step <n>] [--trials <n>] [--min-rate <r>] [--threads <n>] [--seed <n>] [--out <file>]\n");
+        exit(-1);
+    }
+    int maxFrames = 100, step = 1, numTrials = 60, numThreads = -1;
+    double minRate = 0.99;
+    uint64 seed = 1;
+    const char *outPath = "aruco_profile.txt";
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            maxFrames = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--step") == 0 && i + 1 < argc) {
+            step = std::max(atoi(argv[++i]), 1);
+        } else if (strcmp(argv[i], "--trials") == 0 && i + 1 < argc) {
+            numTrials = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--min-rate") == 0 && i + 1 < argc) {
+            minRate = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            numThreads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            outPath = argv[++i];
+        } else {
+            printf("Unknown option %s\n", argv[i]);
+            exit(-1);
+        }
+    }
+    if (numThreads > 0) {
+        cv::setNumThreads(numThreads);
+    }
+
+    std::vector<cv::Mat> frames = loadFootage(argv[1], maxFrames, step);
+    if (frames.empty()) {
+        fprintf(stderr, "No frame can be read from %s\n", argv[1]);
+        exit(-1);
+    }
+    fprintf(stderr, "%zu frames of %dx%d, %d threads\n", frames.size(), frames[0].cols, frames[0].rows, cv::getNumThreads());
+    cv::Ptr<cv::aruco::Dictionary> dictionary = cv::aruco::getPredefinedDictionary(cv::aruco::DICT_6X6_250);
+
+    // the reference sweeps the threshold finely and accepts small candidates, it is slow but misses little
+    arucotune::Profile reference;
+    reference.winSizeMin = 3;
+    reference.winSizeMax = 53;
+    reference.winSizeStep = 4;
+    reference.minPerimeterRate = 0.01;
+    std::vector<std::vector<int> > referenceIds, ids;
+    std::vector<double> timings;
+    runProfile(frames, reference, dictionary, referenceIds, timings);
+    long numMarkers = 0;
+    for (int i = 0; i < referenceIds.size(); i++) {
+        numMarkers += referenceIds[i].size();
+    }
+    if (numMarkers == 0) {
+        fprintf(stderr, "The reference finds no marker in the footage, nothing to tune\n");
+        exit(-1);
+    }
+    fprintf(stderr, "reference: %ld markers, %.3f ms/frame\n", numMarkers, percentile(timings, 0.5));
+
+    // the search space, each trial draws one value per parameter
+    const int winSizeMins[] = {3, 5, 7, 10};
+    const int winSizeMaxs[] = {13, 23, 33, 53};
+    const int winSizeSteps[] = {4, 10, 20};
+    const double minPerimeterRates[] = {0.01, 0.02, 0.03, 0.05, 0.08};
+    const double maxPerimeterRates[] = {1.0, 4.0};
+    const double approxRates[] = {0.03, 0.05, 0.08};
+    const int refinements[] = {cv::aruco::CORNER_REFINE_NONE, cv::aruco::CORNER_REFINE_SUBPIX, cv::aruco::CORNER_REFINE_CONTOUR};
+
+    std::vector<arucotune::Profile> profiles(1);  // the defaults first
+    std::set<string> seen;
+    seen.insert(profiles[0].describe());
+    cv::RNG rng(seed);
+    for (int attempt = 0; profiles.size() < numTrials + 1 && attempt < 100 * (numTrials + 1); attempt++) {
+        arucotune::Profile profile;
+        profile.winSizeMin = pick(rng, winSizeMins, 4);
+        profile.winSizeMax = std::max(pick(rng, winSizeMaxs, 4), profile.winSizeMin);
+        profile.winSizeStep = pick(rng, winSizeSteps, 3);
+        profile.minPerimeterRate = pick(rng, minPerimeterRates, 5);
+        profile.maxPerimeterRate = pick(rng, maxPerimeterRates, 2);
+        profile.polygonalApproxAccuracyRate = pick(rng, approxRates, 3);
+        profile.cornerRefinementMethod = pick(rng, refinements, 3);
+        if (seen.insert(profile.describe()).second) {
+            profiles.push_back(profile);
+        }
+    }
+
+    std::vector<Trial> trials;
+    for (int t = 0; t < profiles.size(); t++) {
+        Trial trial;
+        trial.profile = profiles[t];
+        runProfile(frames, trial.profile, dictionary, ids, timings);
+        long matched, extra;
+        score(referenceIds, ids, matched, extra);
+        trial.rate = (double)matched / numMarkers;
+        trial.falsePositives = extra;
+        double total = 0;
+        for (int i = 0; i < timings.size(); i++) {
+            total += timings[i];
+        }
+        trial.meanMs = total / timings.size();
+        trial.p99Ms = percentile(timings, 0.99);
+        trial.front = false;
+        trials.push_back(trial);
+        fprintf(stderr, "\rtrial %d/%zu", t + 1, profiles.size());
+    }
+    fprintf(stderr, "\n");
+
+    // a trial is on the front when no other one is at least as good on both axes and better on one
+    std::vector<int> front;
+    for (int a = 0; a < trials.size(); a++) {
+        bool dominated = false;
+        for (int b = 0; b < trials.size() && !dominated; b++) {
+            dominated = trials[b].rate >= trials[a].rate && trials[b].meanMs <= trials[a].meanMs &&
+                        (trials[b].rate > trials[a].rate || trials[b].meanMs < trials[a].meanMs);
+        }
+        if (!dominated) {
+            trials[a].front = true;
+            front.push_back(a);
+        }
+    }
+    std::sort(front.begin(), front.end(), [&](int a, int b) { return trials[a].meanMs < trials[b].meanMs; });
+    for (int i = 0; i < front.size(); i++) {
+        printTrial(trials[front[i]], front[i], front[i] == 0);
+    }
+    if (!trials[0].front) {
+        printTrial(trials[0], 0, true);
+    }
+
+    // the fastest front profile good enough, or the most complete one if none is
+    int chosen = -1;
+    for (int i = 0; i < front.size() && chosen < 0; i++) {
+        if (trials[front[i]].rate >= minRate) {
+            chosen = front[i];
+        }
+    }
+    if (chosen < 0) {
+        chosen = front.back();
+        fprintf(stderr, "No profile reaches a rate of %.3f, the most complete one is saved\n", minRate);
+    }
+
+    const Trial &best = trials[chosen];
+    char comment[256];
+    snprintf(comment, sizeof(comment), "rate %.4f, %.3f ms/frame (defaults: rate %.4f, %.3f ms/frame) on %s",
+             best.rate, best.meanMs, trials[0].rate, trials[0].meanMs, argv[1]);
+    if (!arucotune::save(outPath, best.profile, comment)) {
+        exit(-1);
+    }
+    fprintf(stderr, "saved trial %d to %s: %s\n", chosen, outPath, comment);
+    return 0;
+}
@@ -7,7 +7,16 @@
 #include <opencv2/opencv.hpp>
 #include <sstream>
 
+#include "allocdebug.hpp"
 #include "ar.hpp"
+#include "arucotune.hpp"
+#include "calibfile.hpp"
+#include "flowtrack.hpp"
+#include "framesource.hpp"
+#include "overlay.hpp"
+#include "pipeline.hpp"
+#include "posepub.hpp"
+#include "sink.hpp"
 
 using namespace cv;
 using namespace aruco;
@@ -24,370 +33,332 @@ void printOptions() {
               << std::endl;
 }
 
-// Detect aruco makers, and show their borders in the video frame
-void detectAndShowMarkers(cv::Mat &cameraMatrix, std::vector<double> &distCoeffs) {
-    cv::VideoCapture videoCap;
-    videoCap.open(0);
-    cv::Ptr<cv::aruco::Dictionary> dictionary = cv::aruco::getPredefinedDictionary(cv::aruco::DICT_6X6_250);
-
-    while (videoCap.grab()) {
-        cv::Mat image, imageCopy;
-        videoCap.retrieve(image);
-        image.copyTo(imageCopy);
-        std::vector<int> ids;
-        std::vector<std::vector<cv::Point2f> > corners;
-        cv::aruco::detectMarkers(image, dictionary, corners, ids);
-        // if at least one marker detected
-        if (ids.size() > 0) {
-            cv::aruco::drawDetectedMarkers(imageCopy, corners, ids);
-
-            std::vector<cv::Vec3d> rvecs, tvecs;
-            cv::aruco::estimatePoseSingleMarkers(corners, 0.05, cameraMatrix, distCoeffs, rvecs, tvecs);
-            // draw axis for each marker
-            for (int i = 0; i < ids.size(); i++) {
-                cv::drawFrameAxes(imageCopy, cameraMatrix, distCoeffs, rvecs[i], tvecs[i], 0.1);
-            }
+// Buffers of one marker stream, owned across frames so the steady-state loop does not allocate.
+// Images handed to the display stage come from pools, see ar::reusableBuffer.
+struct MarkerContext {
+    // parameters NULL uses the defaults
+    MarkerContext(bool flowTracking, const cv::Ptr<DetectorParameters> &parameters) : parameters(parameters), interpolation(cv::INTER_CUBIC), flowTracking(flowTracking) {
+        dictionary = cv::aruco::getPredefinedDictionary(cv::aruco::DICT_6X6_250);
+        // Initialize the detector parameters using default values, created once for the whole stream
+        if (!this->parameters) {
+            this->parameters = DetectorParameters::create();
         }
-        cv::imshow("out", imageCopy);
+        pts_dst.reserve(4);
+    }
 
-        char key = (char)cv::waitKey(10);
+    cv::Ptr<cv::aruco::Dictionary> dictionary;
+    cv::Ptr<DetectorParameters> parameters;
+    std::vector<int> ids;
+    std::vector<std::vector<cv::Point2f> > corners, failedCandidates;
+    std::vector<cv::Vec3d> rvecs, tvecs;
+    std::vector<Point> pts_dst;
+    overlay::CompositeBuffers composite;
+    int interpolation;  // of the source image warped onto the markers
+    std::vector<cv::Mat> frameCopies, mappedResults, outputs;
+    allocdebug::FrameMeter meter;
+
+    // detect every N frames only, and follow the marker corners with optical flow in between
+    bool flowTracking;
+    flowtrack::AdaptiveTracker flowTracker;
+    cv::Mat gray;
+    std::vector<cv::Point2f> flatCorners;  // the four corners of every marker, in marker order
+};
+
+// Where the frames of a mode go, and when the mode stops
+struct Output {
+    sink::FrameSink *frames;
+    // 0 runs until 'q' or ESC
+    long maxFrames;
+    long numShown;
+    // marker poses go to shared memory for local consumers, NULL for none
+    posepub::Publisher *poses;
+    // also publish the annotated frames
+    bool publishImage;
+    // where the frames of the mode come from
+    framesource::FrameSource *source;
+    // passed on to the MarkerContext of the mode
+    bool flowTracking;
+    cv::Ptr<DetectorParameters> parameters;  // a profile of arucoTune, NULL for the defaults
+    int interpolation;
+
+    Output() : frames(NULL), maxFrames(0), numShown(0), poses(NULL), publishImage(false), source(NULL), flowTracking(false), interpolation(cv::INTER_CUBIC) {}
+
+    // write a frame, returns false once the mode should stop
+    bool show(const cv::Mat &image) {
+        frames->write(image);
+        char key = (char)frames->pollKey(10);
         if (key == 'q' || key == 27) {
-            break;
+            return false;
         }
+        return maxFrames == 0 || ++numShown < maxFrames;
     }
-}
+};
 
-// Map a source image to the markers' area in the video frame
-void mapImageToMarker(cv::Mat &cameraMatrix, std::vector<double> &distCoeffs) {
-    cv::VideoCapture videoCap;
-    cv::VideoWriter videoWriter;
-
-    videoCap.open(0);
-    cv::Ptr<cv::aruco::Dictionary> dictionary = cv::aruco::getPredefinedDictionary(cv::aruco::DICT_6X6_250);
-
-    cv::Mat imgSrc = cv::imread("../data/image_source_4.jpg");
-    // cv::imshow("image", imgSrc);
-
-    Mat concatenatedOutput;
-    Mat frame;
-
-    while (videoCap.grab()) {
-        cv::Mat image, imageCopy;
-        cv::Mat mappedResult;
-        videoCap.retrieve(image);
-        image.copyTo(imageCopy);
-
-        videoCap >> frame;
-
-        std::vector<int> ids;
-        std::vector<std::vector<cv::Point2f> > corners, failedCandidates;
-
-        // Initialize the detector parameters using default values
-        Ptr<DetectorParameters> parameters = DetectorParameters::create();
-
-        // detect markers
-        // corner index
-        // markerCorners is the list of corners of the detected markers. For each marker, its four corners are returned in their original order (which is clockwise starting with top left).
-        // So, the first corner is the top left corner, followed by the top right, bottom right and bottom left.
-        // https://docs.opencv.org/4.x/d5/dae/tutorial_aruco_detection.html
-        cv::aruco::detectMarkers(frame, dictionary, corners, ids, parameters, failedCandidates);
-
-        // Process original frame and draw corners
-        cv::Mat frameCopy;
-        frameCopy = frame.clone();
-        cv::aruco::drawDetectedMarkers(frameCopy, corners, ids);
-
-        // Process original frame and draw 3D axises
-        std::vector<cv::Vec3d> rvecs, tvecs;
-        cv::aruco::estimatePoseSingleMarkers(corners, 0.05, cameraMatrix, distCoeffs, rvecs, tvecs);
-        // draw axis for each marker
-        for (int i = 0; i < ids.size(); i++) {
-            cv::drawFrameAxes(frameCopy, cameraMatrix, distCoeffs, rvecs[i], tvecs[i], 0.1);
-        }
+/* Helper method to show the allocations of the last frame, only counted in -DAR_ALLOC_DEBUG=ON builds. */
+void drawAllocations(cv::Mat &image, MarkerContext &context) {
+    if (context.meter.lastFrame() >= 0) {
+        string text = "allocations/frame: " + to_string(context.meter.lastFrame()) + " (OpenCV " + to_string(context.meter.lastLibrary()) + ")";
+        cv::putText(image, text, Point(10, 30), FONT_HERSHEY_PLAIN, 1.2, YELLOW, 1);
+    }
+}
 
-        // if at least one marker detected
-        if (ids.size() == 4) {
-            // locate the points in the destination frame
-            vector<Point> pts_dst;
-            float scalingFactor = 0.02;
-
-            Point pt1, pt2, pt3, pt4;
-
-            // top left
-            std::vector<int>::iterator it = std::find(ids.begin(), ids.end(), 12);
-            int index = std::distance(ids.begin(), it);
-            // top left marker's top right corner
-            pt1 = corners.at(index).at(0);
-
-            // top right
-            it = std::find(ids.begin(), ids.end(), 22);
-            index = std::distance(ids.begin(), it);
-            // top right marker's bottom right corner
-            pt2 = corners.at(index).at(1);
-
-            float distance = norm(pt1 - pt2);
-
-            // Add a border to the mapped area
-            // src.at(i,j) is using (i,j) as (row,column) but Point(x,y) is using (x,y) as (column,row)
-            // Reference - https://stackoverflow.com/questions/25642532/opencv-pointx-y-represent-column-row-or-row-column
-            pts_dst.push_back(Point(pt1.x - round(scalingFactor * distance), pt1.y - round(scalingFactor * distance)));
-            pts_dst.push_back(Point(pt2.x + round(scalingFactor * distance), pt2.y - round(scalingFactor * distance)));
-
-            // bottom right
-            it = std::find(ids.begin(), ids.end(), 32);
-            index = std::distance(ids.begin(), it);
-            // bottom right marker's top left corner
-            pt3 = corners.at(index).at(2);
-            pts_dst.push_back(Point(pt3.x + round(scalingFactor * distance), pt3.y + round(scalingFactor * distance)));
-
-            // bottom left
-            it = std::find(ids.begin(), ids.end(), 42);
-            index = std::distance(ids.begin(), it);
-            // bottom left marker's top left corner
-            pt4 = corners.at(index).at(3);
-            pts_dst.push_back(Point(pt4.x - round(scalingFactor * distance), pt4.y + round(scalingFactor * distance)));
-
-            // corner points of the new source image
-            vector<Point> pts_src;
-            // top left
-            pts_src.push_back(Point(0, 0));
-            // top right
-            pts_src.push_back(Point(imgSrc.cols, 0));
-            // bottom right
-            pts_src.push_back(Point(imgSrc.cols, imgSrc.rows));
-            // bottom left
-            pts_src.push_back(Point(0, imgSrc.rows));
-
-            // calculate homography
-            // A Homography is a transformation ( a 3×3 matrix ) that maps the points in one image to the corresponding points in the other image.
-            // Reference - https://learnopencv.com/homography-examples-using-opencv-python-c/
-            cv::Mat homo = cv::findHomography(pts_src, pts_dst);
-
-            // Map the source image to the mapped image using the homography
-            cv::Mat mappedImage;
-            warpPerspective(imgSrc, mappedImage, homo, frame.size(), INTER_CUBIC);
-
-            // cv::imshow("src", imgSrc);
-
-            // Mask as the region to copy from the mapped image into the original frame
-            cv::Mat mask = Mat::zeros(frame.rows, frame.cols, CV_8UC1);
-            fillConvexPoly(mask, pts_dst, Scalar(255, 255, 255), LINE_AA);
-
-            // cv::imshow("mask", mask);
-
-            // Erode the mask to not copy the boundary effects from the mapping process
-            cv::Mat element = getStructuringElement(MORPH_RECT, Size(5, 5));
-            erode(mask, mask, element);
-
-            // Map the new source image into the mask area
-            mappedResult = frame.clone();
-            mappedImage.copyTo(mappedResult, mask);
-
-            // cv::aruco::drawDetectedMarkers(mappedResult, corners, ids);
-
-            hconcat(frameCopy, mappedResult, concatenatedOutput);
-
-            cv::imshow("out", concatenatedOutput);
-        } else {
-            cv::imshow("out", frameCopy);
+/*
+Helper method to find the markers of a frame, with a full detection or, in flow tracking mode and while the
+tracker trusts them, by following the corners of the last detected markers with optical flow.
+*/
+void findMarkers(cv::Mat &frame, MarkerContext &context) {
+    std::vector<std::vector<cv::Point2f> > &corners = context.corners;
+    std::vector<cv::Point2f> &flatCorners = context.flatCorners;
+    if (context.flowTracking) {
+        cv::cvtColor(frame, context.gray, COLOR_BGR2GRAY);
+        if (!context.flowTracker.needsDetection() && context.flowTracker.track(context.gray, flatCorners)) {
+            for (int i = 0; i < corners.size(); i++) {
+                for (int j = 0; j < 4; j++) {
+                    corners[i][j] = flatCorners[4 * i + j];
+                }
+            }
+            return;
         }
+    }
 
-        char key = (char)cv::waitKey(10);
-
-        if (key == 'q' || key == 27) {
-            break;
+    cv::aruco::detectMarkers(frame, context.dictionary, corners, context.ids, context.parameters, context.failedCandidates);
+    if (context.flowTracking) {
+        flatCorners.clear();
+        for (int i = 0; i < corners.size(); i++) {
+            flatCorners.insert(flatCorners.end(), corners[i].begin(), corners[i].end());
         }
+        context.flowTracker.detected(context.gray, flatCorners);
     }
 }
 
-// Helper function to load images from a GIF to a list of cv::Mat
-// Reference - https://blog.csdn.net/weixin_42699651/article/details/109381159
-std::vector<cv::Mat> loadGifToMats() {
-    cv::VideoCapture videoCap;
-    cv::Mat frame;
+/* Helper method to publish the ids, corners and poses of the markers detected in a frame. */
+void publishMarkers(Output &output, MarkerContext &context, long frameIndex, const cv::Mat &annotated) {
+    if (output.poses == NULL) {
+        return;
+    }
+    output.poses->begin(frameIndex, posepub::SOURCE_ARUCO, output.publishImage ? annotated : cv::Mat());
+    for (int i = 0; i < context.ids.size(); i++) {
+        output.poses->addPose(context.ids[i], context.rvecs[i], context.tvecs[i], context.corners[i]);
+    }
+    output.poses->end();
+}
 
-    frame = videoCap.open("../data/gif_source.gif");
+// Detect aruco makers, and show their borders in the video frame
+void detectAndShowMarkers(cv::Mat &cameraMatrix, std::vector<double> &distCoeffs, Output &output) {
+    MarkerContext context(output.flowTracking, output.parameters);
+
+    // marker detection runs on a worker thread, the window and keys stay on this thread
+    pipeline::Pipeline<cv::Mat> stages(
+        *output.source,
+        [&](pipeline::Frame &frame, cv::Mat &imageCopy) {
+            context.meter.begin();
+
+            cv::Mat &image = frame.image;
+            cv::Mat &copy = ar::reusableBuffer(context.frameCopies);
+            image.copyTo(copy);
+            std::vector<int> &ids = context.ids;
+            std::vector<std::vector<cv::Point2f> > &corners = context.corners;
+            context.meter.enterLibrary();
+            findMarkers(image, context);
+            context.meter.leaveLibrary();
+            // if at least one marker detected
+            if (ids.size() > 0) {
+                context.meter.enterLibrary();
+                cv::aruco::drawDetectedMarkers(copy, corners, ids);
+
+                std::vector<cv::Vec3d> &rvecs = context.rvecs;
+                std::vector<cv::Vec3d> &tvecs = context.tvecs;
+                cv::aruco::estimatePoseSingleMarkers(corners, 0.05, cameraMatrix, distCoeffs, rvecs, tvecs);
+                // draw axis for each marker
+                for (int i = 0; i < ids.size(); i++) {
+                    cv::drawFrameAxes(copy, cameraMatrix, distCoeffs, rvecs[i], tvecs[i], 0.1);
+                }
+                context.meter.leaveLibrary();
+            }
+            imageCopy = copy;
+            publishMarkers(output, context, frame.index, copy);
+
+            context.meter.end();
+        },
+        [&](pipeline::Frame &frame, cv::Mat &imageCopy) {
+            drawAllocations(imageCopy, context);
+            pipeline::drawStats(imageCopy, stages.statsText());
+            return output.show(imageCopy);
+        });
+    stages.run();
+}
 
-    if (!videoCap.isOpened()) {
-        printf("This GIF cannot be loaded.\n");
-        exit(-1);
+// Detect the four markers in a frame, and map a source image to the area they enclose.
+// The output is the annotated frame, concatenated with the mapped result when all four markers are found.
+// All intermediate buffers come from the stream's context.
+void mapSourceToMarkers(cv::Mat &frame, cv::Mat &imgSrc, cv::Mat &cameraMatrix, std::vector<double> &distCoeffs, MarkerContext &context, cv::Mat &output) {
+    std::vector<int> &ids = context.ids;
+    std::vector<std::vector<cv::Point2f> > &corners = context.corners;
+
+    // detect markers
+    // corner index
+    // markerCorners is the list of corners of the detected markers. For each marker, its four corners are returned in their original order (which is clockwise starting with top left).
+    // So, the first corner is the top left corner, followed by the top right, bottom right and bottom left.
+    // https://docs.opencv.org/4.x/d5/dae/tutorial_aruco_detection.html
+    context.meter.enterLibrary();
+    findMarkers(frame, context);
+    context.meter.leaveLibrary();
+
+    // Process original frame and draw corners
+    cv::Mat &frameCopy = ar::reusableBuffer(context.frameCopies);
+    frame.copyTo(frameCopy);
+    context.meter.enterLibrary();
+    cv::aruco::drawDetectedMarkers(frameCopy, corners, ids);
+
+    // Process original frame and draw 3D axises
+    std::vector<cv::Vec3d> &rvecs = context.rvecs;
+    std::vector<cv::Vec3d> &tvecs = context.tvecs;
+    cv::aruco::estimatePoseSingleMarkers(corners, 0.05, cameraMatrix, distCoeffs, rvecs, tvecs);
+    // draw axis for each marker
+    for (int i = 0; i < ids.size(); i++) {
+        cv::drawFrameAxes(frameCopy, cameraMatrix, distCoeffs, rvecs[i], tvecs[i], 0.1);
     }
-
-    std::vector<cv::Mat> frames;
-    int idx = 1;
-    while (videoCap.read(frame)) {
-        // NOTE: must add '.jpg' suffix
-        // https://stackoverflow.com/questions/9868963/cvimwrite-could-not-find-a-writer-for-the-specified-extension
-        string name = "image" + to_string(idx++) + ".jpg";
-        // cv::imwrite(name, frame);
-        // NOTE: here must create a temp Mat, deep copying the frame, or all the frames are loaded the same, as the last frame in the GIF
-        cv::Mat temp = frame.clone();
-        frames.push_back(temp);
+    context.meter.leaveLibrary();
+
+    // if at least one marker detected
+    if (ids.size() == 4) {
+        // locate the points in the destination frame
+        vector<Point> &pts_dst = context.pts_dst;
+        pts_dst.clear();
+        float scalingFactor = 0.02;
+
+        Point pt1, pt2, pt3, pt4;
+
+        // top left
+        std::vector<int>::iterator it = std::find(ids.begin(), ids.end(), 12);
+        int index = std::distance(ids.begin(), it);
+        // top left marker's top right corner
+        pt1 = corners.at(index).at(0);
+
+        // top right
+        it = std::find(ids.begin(), ids.end(), 22);
+        index = std::distance(ids.begin(), it);
+        // top right marker's bottom right corner
+        pt2 = corners.at(index).at(1);
+
+        float distance = norm(pt1 - pt2);
+
+        // Add a border to the mapped area
+        // src.at(i,j) is using (i,j) as (row,column) but Point(x,y) is using (x,y) as (column,row)
+        // Reference - https://stackoverflow.com/questions/25642532/opencv-pointx-y-represent-column-row-or-row-column
+        pts_dst.push_back(Point(pt1.x - round(scalingFactor * distance), pt1.y - round(scalingFactor * distance)));
+        pts_dst.push_back(Point(pt2.x + round(scalingFactor * distance), pt2.y - round(scalingFactor * distance)));
+
+        // bottom right
+        it = std::find(ids.begin(), ids.end(), 32);
+        index = std::distance(ids.begin(), it);
+        // bottom right marker's top left corner
+        pt3 = corners.at(index).at(2);
+        pts_dst.push_back(Point(pt3.x + round(scalingFactor * distance), pt3.y + round(scalingFactor * distance)));
+
+        // bottom left
+        it = std::find(ids.begin(), ids.end(), 42);
+        index = std::distance(ids.begin(), it);
+        // bottom left marker's top left corner
+        pt4 = corners.at(index).at(3);
+        pts_dst.push_back(Point(pt4.x - round(scalingFactor * distance), pt4.y + round(scalingFactor * distance)));
+
+        // Map the new source image into the area enclosed by the markers
+        cv::Mat &mappedResult = ar::reusableBuffer(context.mappedResults);
+        frame.copyTo(mappedResult);
+        // warpPerspective and parallel_for_ allocate inside
+        context.meter.enterLibrary();
+        overlay::compositeImageRoi(imgSrc, pts_dst, mappedResult, context.composite, context.interpolation);
+        context.meter.leaveLibrary();
+
+        // cv::aruco::drawDetectedMarkers(mappedResult, corners, ids);
+
+        cv::Mat &concatenated = ar::reusableBuffer(context.outputs);
+        hconcat(frameCopy, mappedResult, concatenated);
+        output = concatenated;
+    } else {
+        output = frameCopy;
     }
+}
 
-    // for (vector<cv::Mat>::iterator it = frames.begin(); it != frames.end(); it++) {
-    //     cv::imshow("GIF", *it);
-    // }
+// Map a source image to the markers' area in the video frame
+void mapImageToMarker(cv::Mat &cameraMatrix, std::vector<double> &distCoeffs, Output &output) {
+    MarkerContext context(output.flowTracking, output.parameters);
+    context.interpolation = output.interpolation;
 
-    videoCap.release();
-    return frames;
+    cv::Mat imgSrc = cv::imread("../data/image_source_4.jpg");
+    // cv::imshow("image", imgSrc);
+
+    // detection and mapping run on a worker thread, the window and keys stay on this thread
+    pipeline::Pipeline<cv::Mat> stages(
+        *output.source,
+        [&](pipeline::Frame &frame, cv::Mat &mapped) {
+            context.meter.begin();
+            mapSourceToMarkers(frame.image, imgSrc, cameraMatrix, distCoeffs, context, mapped);
+            publishMarkers(output, context, frame.index, mapped);
+            context.meter.end();
+        },
+        [&](pipeline::Frame &frame, cv::Mat &mapped) {
+            drawAllocations(mapped, context);
+            pipeline::drawStats(mapped, stages.statsText());
+            return output.show(mapped);
+        });
+    stages.run();
 }
 
 // Map a source GIF to the markers' area in the video frame
-void mapGifToMarker(cv::Mat &cameraMatrix, std::vector<double> &distCoeffs) {
-    cv::VideoCapture videoCap;
-    cv::VideoWriter videoWriter;
-
-    videoCap.open(0);
-    cv::Ptr<cv::aruco::Dictionary> dictionary = cv::aruco::getPredefinedDictionary(cv::aruco::DICT_6X6_250);
-
-    std::vector<cv::Mat> gifSources = loadGifToMats();
-    if (gifSources.size() > 0) {
-        printf("There are %lu images loaded from the GIF.\n", gifSources.size());
+void mapGifToMarker(cv::Mat &cameraMatrix, std::vector<double> &distCoeffs, Output &output) {
+    MarkerContext context(output.flowTracking, output.parameters);
+    context.interpolation = output.interpolation;
+
+    // the GIF is decoded once and then replayed from memory, looping
+    framesource::GifSource gif("../data/gif_source.gif");
+    if (gif.isOpened()) {
+        printf("There are %d images loaded from the GIF.\n", gif.numFrames());
     } else {
         printf("This GIF cannot be loaded.\n");
         exit(-1);
     }
 
-    cv::Mat concatenatedOutput;
-    cv::Mat frame;
-
-    int gifIdx = 0;
-    while (videoCap.grab()) {
-        // cv::Mat image, imageCopy;
-        cv::Mat mappedResult;
-        // videoCap.retrieve(image);
-        // image.copyTo(imageCopy);
-
-        cv::Mat imgSrc = gifSources[gifIdx];
-        gifIdx = (gifIdx + 1) % (int)gifSources.size();
-
-        videoCap >> frame;
-
-        std::vector<int> ids;
-        std::vector<std::vector<cv::Point2f> > corners, failedCandidates;
-
-        // Initialize the detector parameters using default values
-        Ptr<DetectorParameters> parameters = DetectorParameters::create();
-
-        // detect markers
-        // corner index
-        // markerCorners is the list of corners of the detected markers. For each marker, its four corners are returned in their original order (which is clockwise starting with top left).
-        // So, the first corner is the top left corner, followed by the top right, bottom right and bottom left.
-        // https://docs.opencv.org/4.x/d5/dae/tutorial_aruco_detection.html
-        cv::aruco::detectMarkers(frame, dictionary, corners, ids, parameters, failedCandidates);
-
-        // Process original frame and draw corners
-        cv::Mat frameCopy;
-        frameCopy = frame.clone();
-        cv::aruco::drawDetectedMarkers(frameCopy, corners, ids);
-
-        // Process original frame and draw 3D axises
-        std::vector<cv::Vec3d> rvecs, tvecs;
-        cv::aruco::estimatePoseSingleMarkers(corners, 0.05, cameraMatrix, distCoeffs, rvecs, tvecs);
-        // draw axis for each marker
-        for (int i = 0; i < ids.size(); i++) {
-            cv::drawFrameAxes(frameCopy, cameraMatrix, distCoeffs, rvecs[i], tvecs[i], 0.1);
-        }
-
-        // if at least one marker detected
-        if (ids.size() == 4) {
-            // locate the points in the destination frame
-            vector<Point> pts_dst;
-            float scalingFactor = 0.02;
-
-            Point pt1, pt2, pt3, pt4;
-
-            // top left
-            std::vector<int>::iterator it = std::find(ids.begin(), ids.end(), 12);
-            int index = std::distance(ids.begin(), it);
-            // top left marker's top right corner
-            pt1 = corners.at(index).at(0);
-
-            // top right
-            it = std::find(ids.begin(), ids.end(), 22);
-            index = std::distance(ids.begin(), it);
-            // top right marker's bottom right corner
-            pt2 = corners.at(index).at(1);
-
-            float distance = norm(pt1 - pt2);
-
-            // Add a border to the mapped area
-            // src.at(i,j) is using (i,j) as (row,column) but Point(x,y) is using (x,y) as (column,row)
-            // Reference - https://stackoverflow.com/questions/25642532/opencv-pointx-y-represent-column-row-or-row-column
-            pts_dst.push_back(Point(pt1.x - round(scalingFactor * distance), pt1.y - round(scalingFactor * distance)));
-            pts_dst.push_back(Point(pt2.x + round(scalingFactor * distance), pt2.y - round(scalingFactor * distance)));
-
-            // bottom right
-            it = std::find(ids.begin(), ids.end(), 32);
-            index = std::distance(ids.begin(), it);
-            // bottom right marker's top left corner
-            pt3 = corners.at(index).at(2);
-            pts_dst.push_back(Point(pt3.x + round(scalingFactor * distance), pt3.y + round(scalingFactor * distance)));
-
-            // bottom left
-            it = std::find(ids.begin(), ids.end(), 42);
-            index = std::distance(ids.begin(), it);
-            // bottom left marker's top left corner
-            pt4 = corners.at(index).at(3);
-            pts_dst.push_back(Point(pt4.x - round(scalingFactor * distance), pt4.y + round(scalingFactor * distance)));
-
-            // corner points of the new source image
-            vector<Point> pts_src;
-            // top left
-            pts_src.push_back(Point(0, 0));
-            // top right
-            pts_src.push_back(Point(imgSrc.cols, 0));
-            // bottom right
-            pts_src.push_back(Point(imgSrc.cols, imgSrc.rows));
-            // bottom left
-            pts_src.push_back(Point(0, imgSrc.rows));
-
-            // calculate homography
-            // A Homography is a transformation ( a 3×3 matrix ) that maps the points in one image to the corresponding points in the other image.
-            // Reference - https://learnopencv.com/homography-examples-using-opencv-python-c/
-            cv::Mat homo = cv::findHomography(pts_src, pts_dst);
-
-            // Map the source image to the mapped image using the homography
-            cv::Mat mappedImage;
-            warpPerspective(imgSrc, mappedImage, homo, frame.size(), INTER_CUBIC);
-
-            // cv::imshow("src", imgSrc);
-
-            // Mask as the region to copy from the mapped image into the original frame
-            cv::Mat mask = Mat::zeros(frame.rows, frame.cols, CV_8UC1);
-            fillConvexPoly(mask, pts_dst, Scalar(255, 255, 255), LINE_AA);
-
-            // cv::imshow("mask", mask);
-
-            // Erode the mask to not copy the boundary effects from the mapping process
-            cv::Mat element = getStructuringElement(MORPH_RECT, Size(5, 5));
-            erode(mask, mask, element);
-
-            // Map the new source image into the mask area
-            mappedResult = frame.clone();
-            mappedImage.copyTo(mappedResult, mask);
-
-            // cv::aruco::drawDetectedMarkers(mappedResult, corners, ids);
-
-            hconcat(frameCopy, mappedResult, concatenatedOutput);
-
-            cv::imshow("out", concatenatedOutput);
-        } else {
-            cv::imshow("out", frameCopy);
-        }
-
-        char key = (char)cv::waitKey(10);
-
-        if (key == 'q' || key == 27) {
-            break;
-        }
-    }
+    // one worker, so the GIF frames advance in capture order
+    cv::Mat imgSrc;
+    int64_t gifTimestampNs;
+    pipeline::Pipeline<cv::Mat> stages(
+        *output.source,
+        [&](pipeline::Frame &frame, cv::Mat &mapped) {
+            context.meter.begin();
+
+            gif.read(imgSrc, gifTimestampNs);
+
+            mapSourceToMarkers(frame.image, imgSrc, cameraMatrix, distCoeffs, context, mapped);
+            publishMarkers(output, context, frame.index, mapped);
+            context.meter.end();
+        },
+        [&](pipeline::Frame &frame, cv::Mat &mapped) {
+            drawAllocations(mapped, context);
+            pipeline::drawStats(mapped, stages.statsText());
+            return output.show(mapped);
+        });
+    stages.run();
 }
 
 // Entry function to project a new image to the targeted area in the video frame,
 // leveraging the aruco AR library.
 // Reference - https://docs.opencv.org/3.4/d5/dae/tutorial_aruco_detection.html
+//
+// Usage: arucoProjector <calibration file> <d|m|g> [--source <spec>] [--sink <spec>] [--frames <n>] [--publish <name> [--publish-image]] [--flow]
+//                       [--profile <file>] [--interp <cubic|linear>]
+//   --source <spec>    camera index (default 0), video:<file>, images:<dir>, synthetic[:WxH[@fps]], ...,
+//                      see framesource.hpp
+//   --sink <spec>      window (default), null, video:<file>, images:<pattern> or shm:<name>, see sink.hpp
+//   --frames <n>       stop after n frames
+//   --publish <name>   publish the ids, corners and poses of the markers to POSIX shared memory, e.g. /aruco_poses,
+//                      see posepub.hpp and poseReader
+//   --publish-image    also publish the annotated frames
+//   --flow             detect the markers every N frames and follow their corners with Lucas-Kanade in between,
+//                      N adapts to the motion and a lost corner triggers a detection
+//   --profile <file>   detector parameters saved by arucoTune instead of the defaults
+//   --interp <mode>    interpolation of the mapped image, cubic (default) or the cheaper linear
 int main(int argc, char *argv[]) {
     printOptions();
 
@@ -402,22 +373,91 @@ int main(int argc, char *argv[]) {
     cv::Mat cameraMatrix(3, 3, CV_64FC1);
     std::strcpy(cameraCalibrationFile, argv[1]);
 
-    std::vector<double> coeffs;
-    ar::readCameraCalibrationInfo(cameraCalibrationFile, cameraMatrix, coeffs);
+    // binary or text calibration file, see calibfile.hpp
+    calibfile::Calibration calib;
+    if (!calibfile::load(cameraCalibrationFile, calib)) {
+        cout << "Camera calibration info cannot be loaded. Please give a correct file path.\n";
+        exit(-1);
+    }
+    cameraMatrix = calib.cameraMatrix;
+    std::vector<double> coeffs(calib.distCoeffs.begin<double>(), calib.distCoeffs.end<double>());
+
+    const char *sourceSpec = "0";
+    const char *sinkSpec = "window";
+    const char *publishName = NULL;
+    Output output;
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--source") == 0 && i + 1 < argc) {
+            sourceSpec = argv[++i];
+        } else if (strcmp(argv[i], "--sink") == 0 && i + 1 < argc) {
+            sinkSpec = argv[++i];
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            output.maxFrames = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--publish") == 0 && i + 1 < argc) {
+            publishName = argv[++i];
+        } else if (strcmp(argv[i], "--publish-image") == 0) {
+            output.publishImage = true;
+        } else if (strcmp(argv[i], "--flow") == 0) {
+            output.flowTracking = true;
+        } else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            arucotune::Profile profile;
+            if (!arucotune::load(argv[++i], profile)) {
+                cout << "Detector profile " << argv[i] << " cannot be loaded.\n";
+                exit(-1);
+            }
+            output.parameters = profile.toParameters();
+        } else if (strcmp(argv[i], "--interp") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "cubic") == 0) {
+                output.interpolation = cv::INTER_CUBIC;
+            } else if (strcmp(argv[i], "linear") == 0) {
+                output.interpolation = cv::INTER_LINEAR;
+            } else {
+                cout << "Unknown interpolation " << argv[i] << "\n";
+                exit(-1);
+            }
+        } else {
+            cout << "Unknown option " << argv[i] << "\n";
+            exit(-1);
+        }
+    }
+    output.source = framesource::create(sourceSpec);
+    if (output.source == NULL) {
+        exit(-1);
+    }
+    output.frames = sink::create(sinkSpec, "out");
+    if (output.frames == NULL) {
+        cout << "Unknown sink " << sinkSpec << "\n";
+        exit(-1);
+    }
+
+    if (publishName != NULL) {
+        output.poses = new posepub::Publisher(publishName);
+    }
+
+    allocdebug::install();
 
     if (strcmp(argv[2], "d") == 0) {
-        detectAndShowMarkers(cameraMatrix, coeffs);
+        detectAndShowMarkers(cameraMatrix, coeffs, output);
     } else if (strcmp(argv[2], "m") == 0) {
-        mapImageToMarker(cameraMatrix, coeffs);
+        mapImageToMarker(cameraMatrix, coeffs, output);
     } else if (strcmp(argv[2], "g") == 0) {
-        mapGifToMarker(cameraMatrix, coeffs);
+        mapGifToMarker(cameraMatrix, coeffs, output);
     } else {
         cout << "The specified mode is not correct.\n";
         exit(-1);
     }
 
     // NOTE: must add waitKey, or the program will terminate, without showing the result images
-    waitKey(0);
+    // headless sinks have no keys and return at once
+    output.frames->pollKey(0);
+    output.frames->close();
+    if (output.frames->dropped() > 0) {
+        printf("%ld frames dropped by the output\n", output.frames->dropped());
+    }
+    delete output.frames;
+    delete output.poses;
+    delete output.source;
     printf("Terminating\n");
 
     return 0;
@@ -0,0 +1,101 @@
+#include "arucotune.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+using namespace cv;
+using namespace std;
+
+arucotune::Profile::Profile() {
+    cv::Ptr<cv::aruco::DetectorParameters> defaults = cv::aruco::DetectorParameters::create();
+    winSizeMin = defaults->adaptiveThreshWinSizeMin;
+    winSizeMax = defaults->adaptiveThreshWinSizeMax;
+    winSizeStep = defaults->adaptiveThreshWinSizeStep;
+    minPerimeterRate = defaults->minMarkerPerimeterRate;
+    maxPerimeterRate = defaults->maxMarkerPerimeterRate;
+    polygonalApproxAccuracyRate = defaults->polygonalApproxAccuracyRate;
+    cornerRefinementMethod = defaults->cornerRefinementMethod;
+}
+
+cv::Ptr<cv::aruco::DetectorParameters> arucotune::Profile::toParameters() const {
+    cv::Ptr<cv::aruco::DetectorParameters> parameters = cv::aruco::DetectorParameters::create();
+    parameters->adaptiveThreshWinSizeMin = winSizeMin;
+    parameters->adaptiveThreshWinSizeMax = winSizeMax;
+    parameters->adaptiveThreshWinSizeStep = winSizeStep;
+    parameters->minMarkerPerimeterRate = minPerimeterRate;
+    parameters->maxMarkerPerimeterRate = maxPerimeterRate;
+    parameters->polygonalApproxAccuracyRate = polygonalApproxAccuracyRate;
+    parameters->cornerRefinementMethod = cornerRefinementMethod;
+    return parameters;
+}
+
+std::string arucotune::Profile::describe() const {
+    char text[256];
+    snprintf(text, sizeof(text), "win=%d..%d/%d perimeter=%g..%g approx=%g refine=%d",
+             winSizeMin, winSizeMax, winSizeStep, minPerimeterRate, maxPerimeterRate, polygonalApproxAccuracyRate, cornerRefinementMethod);
+    return text;
+}
+
+bool arucotune::save(const char *path, const Profile &profile, const std::string &comment) {
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        printf("%s cannot be opened for the detector profile\n", path);
+        return false;
+    }
+    fprintf(file, "# cv::aruco::DetectorParameters, see arucoTune\n");
+    if (!comment.empty()) {
+        fprintf(file, "# %s\n", comment.c_str());
+    }
+    fprintf(file, "adaptiveThreshWinSizeMin %d\n", profile.winSizeMin);
+    fprintf(file, "adaptiveThreshWinSizeMax %d\n", profile.winSizeMax);
+    fprintf(file, "adaptiveThreshWinSizeStep %d\n", profile.winSizeStep);
+    fprintf(file, "minMarkerPerimeterRate %.17g\n", profile.minPerimeterRate);
+    fprintf(file, "maxMarkerPerimeterRate %.17g\n", profile.maxPerimeterRate);
+    fprintf(file, "polygonalApproxAccuracyRate %.17g\n", profile.polygonalApproxAccuracyRate);
+    fprintf(file, "cornerRefinementMethod %d\n", profile.cornerRefinementMethod);
+    return fclose(file) == 0;
+}
+
+bool arucotune::load(const char *path, Profile &profile) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        std::istringstream fields(line);
+        string name;
+        double value;
+        if (!(fields >> name) || name[0] == '#') {
+            continue;
+        }
+        if (!(fields >> value)) {
+            printf("%s:%d: no value for %s\n", path, lineNumber, name.c_str());
+            return false;
+        }
+
+        if (name == "adaptiveThreshWinSizeMin") {
+            profile.winSizeMin = (int)value;
+        } else if (name == "adaptiveThreshWinSizeMax") {
+            profile.winSizeMax = (int)value;
+        } else if (name == "adaptiveThreshWinSizeStep") {
+            profile.winSizeStep = (int)value;
+        } else if (name == "minMarkerPerimeterRate") {
+            profile.minPerimeterRate = value;
+        } else if (name == "maxMarkerPerimeterRate") {
+            profile.maxPerimeterRate = value;
+        } else if (name == "polygonalApproxAccuracyRate") {
+            profile.polygonalApproxAccuracyRate = value;
+        } else if (name == "cornerRefinementMethod") {
+            profile.cornerRefinementMethod = (int)value;
+        } else {
+            printf("%s:%d: unknown parameter %s, ignored\n", path, lineNumber, name.c_str());
+        }
+    }
+    return true;
+}
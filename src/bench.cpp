@@ -0,0 +1,464 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <opencv2/aruco.hpp>
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+
+#include "ar.hpp"
+#include "calibfile.hpp"
+#include "calibration.hpp"
+#include "flowtrack.hpp"
+#include "harris.hpp"
+#include "overlay.hpp"
+#include "pose.hpp"
+#include "scene.hpp"
+
+using namespace cv;
+using namespace std;
+
+// One benchmarked kernel at one resolution.
+// prepare runs before every iteration and is not timed, e.g. to restore a frame the kernel draws on.
+struct Kernel {
+    string name;
+    std::function<void(int)> prepare;
+    std::function<void(int)> run;
+};
+
+/* Helper method to get a percentile of sorted timings. */
+double percentile(std::vector<double> &sorted, double p) {
+    int index = (int)ceil(p * sorted.size()) - 1;
+    return sorted[std::min(std::max(index, 0), (int)sorted.size() - 1)];
+}
+
+/*
+Helper method to check the fused Harris kernel against cv::cornerHarris on one frame and print one JSON line:
+the largest difference, absolute and relative to the largest response, the share of bit-identical pixels, and
+whether both give the same keypoints.
+*/
+void compareResponses(const cv::Mat &gray, Size size) {
+    cv::Mat reference, fused;
+    cv::cornerHarris(gray, reference, 2, 3, 0.04);
+    harris::cornerHarrisFused(gray, fused, 0.04);
+
+    double maxResponse = cv::norm(reference, NORM_INF);
+    double maxDiff = cv::norm(reference, fused, NORM_INF);
+    long identical = 0;
+    for (int y = 0; y < reference.rows; y++) {
+        for (int x = 0; x < reference.cols; x++) {
+            identical += memcmp(reference.ptr<float>(y) + x, fused.ptr<float>(y) + x, sizeof(float)) == 0;
+        }
+    }
+
+    std::vector<cv::KeyPoint> referenceKeypoints, fusedKeypoints;
+    harris::extractKeypoints(reference, harris::DEFAULT_THRESHOLD, referenceKeypoints);
+    harris::extractKeypoints(fused, harris::DEFAULT_THRESHOLD, fusedKeypoints);
+    bool sameKeypoints = referenceKeypoints.size() == fusedKeypoints.size();
+    for (int i = 0; sameKeypoints && i < referenceKeypoints.size(); i++) {
+        sameKeypoints = referenceKeypoints[i].pt == fusedKeypoints[i].pt;
+    }
+
+    printf("{\"kernel\":\"harris::cornerHarrisFused\",\"resolution\":\"%dx%d\",\"reference\":\"cv::cornerHarris\",\"max_abs_diff\":%g,\"max_rel_diff\":%g,\"identical_pct\":%.3f,\"keypoints\":%zu,\"same_keypoints\":%s}\n",
+           size.width, size.height, maxDiff, maxResponse > 0 ? maxDiff / maxResponse : 0.0,
+           100.0 * identical / reference.total(), referenceKeypoints.size(), sameKeypoints ? "true" : "false");
+    fflush(stdout);
+}
+
+/*
+Helper method to check overlay::compositeImageRoi against overlay::compositeImage and print one JSON line.
+A white source on a black frame gives each path's mask: the share of the reference mask's pixels the analytic
+inset gets wrong, over the bench quad and two tilted ones. Then, on the pixels both paths write, the largest
+difference of the composited source image and the share of identical pixels.
+*/
+void compareComposites(const cv::Mat &imgSrc, Size size) {
+    std::vector<std::vector<Point> > quads(3);
+    quads[0] = {Point(size.width / 8, size.height / 8), Point(size.width * 7 / 8, size.height / 8), Point(size.width * 7 / 8, size.height * 7 / 8), Point(size.width / 8, size.height * 7 / 8)};
+    quads[1] = {Point(size.width / 5, size.height / 10), Point(size.width * 4 / 5, size.height / 4), Point(size.width * 7 / 10, size.height * 9 / 10), Point(size.width / 6, size.height * 2 / 3)};
+    quads[2] = {Point(size.width / 2, size.height / 12), Point(size.width * 11 / 12, size.height / 2), Point(size.width / 2, size.height * 11 / 12), Point(size.width / 12, size.height / 2)};
+
+    overlay::CompositeBuffers buffers;
+    cv::Mat white(imgSrc.size(), imgSrc.type(), Scalar::all(255));
+    long referencePixels = 0, maskDiff = 0, shared = 0, identical = 0;
+    int maxDiff = 0;
+    for (int q = 0; q < quads.size(); q++) {
+        cv::Mat referenceMask = cv::Mat::zeros(size, imgSrc.type()), roiMask = cv::Mat::zeros(size, imgSrc.type());
+        overlay::compositeImage(white, quads[q], referenceMask, buffers);
+        overlay::compositeImageRoi(white, quads[q], roiMask, buffers);
+
+        cv::Mat reference = cv::Mat::zeros(size, imgSrc.type()), roi = cv::Mat::zeros(size, imgSrc.type());
+        overlay::compositeImage(imgSrc, quads[q], reference, buffers);
+        overlay::compositeImageRoi(imgSrc, quads[q], roi, buffers);
+
+        for (int y = 0; y < size.height; y++) {
+            const Vec3b *rm = referenceMask.ptr<Vec3b>(y), *om = roiMask.ptr<Vec3b>(y);
+            const Vec3b *r = reference.ptr<Vec3b>(y), *o = roi.ptr<Vec3b>(y);
+            for (int x = 0; x < size.width; x++) {
+                bool inReference = rm[x][0] > 0, inRoi = om[x][0] > 0;
+                referencePixels += inReference;
+                maskDiff += inReference != inRoi;
+                if (inReference && inRoi) {
+                    shared++;
+                    identical += memcmp(&r[x], &o[x], sizeof(Vec3b)) == 0;
+                    for (int c = 0; c < 3; c++) {
+                        maxDiff = std::max(maxDiff, std::abs((int)r[x][c] - (int)o[x][c]));
+                    }
+                }
+            }
+        }
+    }
+
+    printf("{\"kernel\":\"overlay::compositeImageRoi\",\"resolution\":\"%dx%d\",\"reference\":\"overlay::compositeImage\",\"mask_diff_pct\":%.3f,\"max_abs_diff\":%d,\"identical_pct\":%.3f}\n",
+           size.width, size.height, referencePixels > 0 ? 100.0 * maskDiff / referencePixels : 0.0, maxDiff,
+           shared > 0 ? 100.0 * identical / shared : 0.0);
+    fflush(stdout);
+}
+
+/* Helper method to load an image resized to the benchmark resolution, exits if it is missing. */
+cv::Mat loadResized(const string &path, Size size) {
+    cv::Mat image = cv::imread(path);
+    if (image.empty()) {
+        fprintf(stderr, "%s cannot be loaded\n", path.c_str());
+        exit(-1);
+    }
+    cv::Mat resized;
+    cv::resize(image, resized, size, 0, 0, INTER_AREA);
+    return resized;
+}
+
+/* Helper method to load every frame of a GIF resized to the benchmark resolution. */
+std::vector<cv::Mat> loadGifResized(const string &path, Size size) {
+    cv::VideoCapture videoCap(path);
+    std::vector<cv::Mat> frames;
+    cv::Mat frame;
+    while (videoCap.read(frame)) {
+        cv::Mat resized;
+        cv::resize(frame, resized, size, 0, 0, INTER_AREA);
+        frames.push_back(resized);
+    }
+    if (frames.empty()) {
+        fprintf(stderr, "%s cannot be loaded\n", path.c_str());
+        exit(-1);
+    }
+    return frames;
+}
+
+/*
+Helper method to build a scene with the four markers used by arucoProjector (ids 12, 22, 32, 42),
+one in each quarter of a background image, each on a white quiet zone.
+*/
+cv::Mat buildMarkerScene(const string &dataDir, Size size) {
+    cv::Mat scene = loadResized(dataDir + "/image_source_3.jpg", size);
+    cv::Ptr<cv::aruco::Dictionary> dictionary = cv::aruco::getPredefinedDictionary(cv::aruco::DICT_6X6_250);
+
+    int markerSize = size.height / 5;
+    int border = markerSize / 6;
+    int ids[] = {12, 22, 32, 42};
+    Point origins[] = {Point(size.width / 8, size.height / 8),
+                       Point(size.width * 7 / 8 - markerSize, size.height / 8),
+                       Point(size.width * 7 / 8 - markerSize, size.height * 7 / 8 - markerSize),
+                       Point(size.width / 8, size.height * 7 / 8 - markerSize)};
+
+    for (int i = 0; i < 4; i++) {
+        cv::Mat marker, markerBGR;
+        cv::aruco::drawMarker(dictionary, ids[i], markerSize, marker, 1);
+        cv::cvtColor(marker, markerBGR, COLOR_GRAY2BGR);
+        cv::rectangle(scene, Rect(origins[i].x - border, origins[i].y - border, markerSize + 2 * border, markerSize + 2 * border), Scalar(255, 255, 255), FILLED);
+        cv::Mat roi = scene(Rect(origins[i].x, origins[i].y, markerSize, markerSize));
+        markerBGR.copyTo(roi);
+    }
+    return scene;
+}
+
+/*
+  Microbenchmarks of the hot kernels on fixed inputs from data/.
+  Every kernel runs at 720p, 1080p and 4K, and at each OpenCV thread count.
+  Results are printed as one JSON object per line, progress goes to stderr.
+
+  Usage: bench [iterations] [thread counts, e.g. 1,2,4] [data dir]
+ */
+int main(int argc, char *argv[]) {
+    int iterations = argc >= 2 ? atoi(argv[1]) : 30;
+    string dataDir = argc >= 4 ? argv[3] : "../data";
+
+    std::vector<int> threadCounts;
+    if (argc >= 3) {
+        char list[256];
+        strncpy(list, argv[2], sizeof(list) - 1);
+        list[sizeof(list) - 1] = 0;
+        for (char *token = strtok(list, ","); token != NULL; token = strtok(NULL, ",")) {
+            threadCounts.push_back(atoi(token));
+        }
+    } else {
+        int counts[] = {1, 2, 4, cv::getNumberOfCPUs()};
+        for (int i = 0; i < 4; i++) {
+            if (std::find(threadCounts.begin(), threadCounts.end(), counts[i]) == threadCounts.end()) {
+                threadCounts.push_back(counts[i]);
+            }
+        }
+    }
+
+    // intrinsics of the saved calibration, scaled per resolution below
+    calibfile::Calibration calib;
+    if (!calibfile::load((dataDir + "/calibration.txt").c_str(), calib)) {
+        fprintf(stderr, "%s/calibration.txt cannot be loaded\n", dataDir.c_str());
+        exit(-1);
+    }
+
+    Size boardSize(8, 6);
+    Size resolutions[] = {Size(1280, 720), Size(1920, 1080), Size(3840, 2160)};
+
+    for (int r = 0; r < 3; r++) {
+        Size size = resolutions[r];
+        fprintf(stderr, "preparing inputs at %dx%d\n", size.width, size.height);
+
+        // chessboard frames saved by the AR program
+        std::vector<cv::Mat> boards;
+        for (int i = 1; i <= 3; i++) {
+            boards.push_back(loadResized(dataDir + "/ar/image_" + to_string(i) + ".jpg", size));
+        }
+        cv::Mat harrisInput = loadResized(dataDir + "/harris_original.jpg", size);
+        cv::Mat markerScene = buildMarkerScene(dataDir, size);
+        cv::Mat overlaySource = cv::imread(dataDir + "/image_source_4.jpg");
+        std::vector<cv::Mat> gifFrames = loadGifResized(dataDir + "/gif_source.gif", Size(600, 400));
+
+        // the calibration was made at 720p, scale the focal lengths and principal point with the resolution
+        cv::Mat cameraMatrix = calib.cameraMatrix.clone();
+        double scale = size.width / 1280.0;
+        cameraMatrix.at<double>(0, 0) *= scale;
+        cameraMatrix.at<double>(0, 2) *= scale;
+        cameraMatrix.at<double>(1, 1) *= scale;
+        cameraMatrix.at<double>(1, 2) *= scale;
+        cv::Mat distCoeffs = calib.distCoeffs.clone();
+
+        // a real pose from the first board, or a fixed one in front of the camera if it is not found
+        cv::Mat rvec = Mat::zeros(3, 1, CV_64F);
+        cv::Mat tvec = (cv::Mat_<double>(3, 1) << -3.5, 2.5, 20);
+        std::vector<cv::Point2f> corner_set;
+        bool boardFound = cv::findChessboardCorners(boards[0], boardSize, corner_set);
+        if (boardFound) {
+            cv::solvePnP(calibration::get3DWorldUnits(boardSize), corner_set, cameraMatrix, distCoeffs, rvec, tvec);
+        }
+
+        // the corners of that pose, so the solvers below always have a board; a tracker that has seen them once
+        // starts every later solve warm
+        std::vector<cv::Point3f> posePoints = calibration::get3DWorldUnits(boardSize);
+        std::vector<cv::Point2f> poseCorners;
+        cv::projectPoints(posePoints, rvec, tvec, cameraMatrix, distCoeffs, poseCorners);
+        cv::Mat rvecSolved = Mat::zeros(3, 1, CV_64F), tvecSolved = Mat::zeros(3, 1, CV_64F);
+        pose::PoseTracker warmTracker, coldTracker;
+        long warmFrame = 0;
+        warmTracker.estimate(posePoints, poseCorners, cameraMatrix, distCoeffs, warmFrame, rvecSolved, tvecSolved);
+
+        // the quad spanned by the four markers, as arucoProjector maps it
+        std::vector<cv::Point> quad;
+        quad.push_back(Point(size.width / 8, size.height / 8));
+        quad.push_back(Point(size.width * 7 / 8, size.height / 8));
+        quad.push_back(Point(size.width * 7 / 8, size.height * 7 / 8));
+        quad.push_back(Point(size.width / 8, size.height * 7 / 8));
+
+        cv::Mat work;
+        cv::Ptr<cv::aruco::Dictionary> dictionary = cv::aruco::getPredefinedDictionary(cv::aruco::DICT_6X6_250);
+        cv::Ptr<cv::aruco::DetectorParameters> parameters = cv::aruco::DetectorParameters::create();
+        std::vector<int> ids;
+        std::vector<std::vector<cv::Point2f> > markerCorners;
+        overlay::CompositeBuffers compositeBuffers;
+
+        std::vector<Kernel> kernels;
+
+        Kernel detectCorners;
+        detectCorners.name = "calibration::detectCorners";
+        detectCorners.prepare = [&](int i) { boards[i % boards.size()].copyTo(work); };
+        detectCorners.run = [&](int i) { calibration::detectCorners(work, boardSize); };
+        kernels.push_back(detectCorners);
+
+        // what a frame costs between two detections in flow tracking mode: the corners of the first board
+        // followed into the same board shifted by a few pixels
+        cv::Mat boardGray, shiftedBoard, flowGray;
+        cv::cvtColor(boards[0], boardGray, COLOR_BGR2GRAY);
+        cv::Mat shift = (cv::Mat_<double>(2, 3) << 1, 0, 2, 0, 1, 1);
+        cv::warpAffine(boards[0], shiftedBoard, shift, boards[0].size());
+        flowtrack::AdaptiveTracker flowTracker;
+        std::vector<cv::Point2f> flowCorners;
+        if (boardFound) {
+            Kernel flow;
+            flow.name = "flowtrack::AdaptiveTracker::track";
+            flow.prepare = [&](int i) { flowTracker.detected(boardGray, corner_set); };
+            flow.run = [&](int i) {
+                cv::cvtColor(shiftedBoard, flowGray, COLOR_BGR2GRAY);
+                flowTracker.track(flowGray, flowCorners);
+            };
+            kernels.push_back(flow);
+        }
+
+        Kernel harrisCorners;
+        harrisCorners.name = "harris::detectAndDrawHarrisCorners";
+        harrisCorners.prepare = [&](int i) { harrisInput.copyTo(work); };
+        harrisCorners.run = [&](int i) { harris::detectAndDrawHarrisCorners(work); };
+        kernels.push_back(harrisCorners);
+
+        // the threshold and non-maximum suppression alone, on a response computed once
+        harris::HarrisBuffers harrisBuffers;
+        std::vector<cv::KeyPoint> keypoints;
+        harris::detectHarrisCorners(harrisInput, keypoints, harrisBuffers);
+
+        // the response alone: OpenCV's pass-per-stage cornerHarris against the fused kernel, on the same gray frame
+        cv::Mat harrisGray, referenceResponse, fusedResponse;
+        cv::cvtColor(harrisInput, harrisGray, COLOR_BGR2GRAY);
+
+        Kernel cornerHarris;
+        cornerHarris.name = "cv::cornerHarris";
+        cornerHarris.prepare = [&](int i) {};
+        cornerHarris.run = [&](int i) { cv::cornerHarris(harrisGray, referenceResponse, 2, 3, 0.04); };
+        kernels.push_back(cornerHarris);
+
+        Kernel cornerHarrisFused;
+        cornerHarrisFused.name = "harris::cornerHarrisFused";
+        cornerHarrisFused.prepare = [&](int i) {};
+        cornerHarrisFused.run = [&](int i) { harris::cornerHarrisFused(harrisGray, fusedResponse, 0.04); };
+        kernels.push_back(cornerHarrisFused);
+
+        compareResponses(harrisGray, size);
+
+        Kernel extractKeypoints;
+        extractKeypoints.name = "harris::extractKeypoints";
+        extractKeypoints.prepare = [&](int i) {};
+        extractKeypoints.run = [&](int i) { harris::extractKeypoints(harrisBuffers.response, harris::DEFAULT_THRESHOLD, keypoints); };
+        kernels.push_back(extractKeypoints);
+
+        // a fixed camera: every other frame has one 64x64 block changed, so one to four tiles are recomputed
+        cv::Mat changedInput = harrisInput.clone();
+        cv::rectangle(changedInput, Rect(size.width / 2, size.height / 2, 64, 64), Scalar(255, 255, 255), FILLED);
+        harris::IncrementalHarris incrementalHarris;
+        incrementalHarris.update(harrisInput, keypoints);
+
+        Kernel incremental;
+        incremental.name = "harris::IncrementalHarris::update";
+        incremental.prepare = [&](int i) {};
+        incremental.run = [&](int i) { incrementalHarris.update(i % 2 == 0 ? changedInput : harrisInput, keypoints); };
+        kernels.push_back(incremental);
+
+        Kernel project;
+        project.name = "ar::project3DAxes+project3DTriangular";
+        project.prepare = [&](int i) { boards[0].copyTo(work); };
+        project.run = [&](int i) {
+            ar::project3DAxes(work, cameraMatrix, distCoeffs, rvec, tvec);
+            ar::project3DTriangular(work, 4, -1, cameraMatrix, distCoeffs, rvec, tvec);
+        };
+        kernels.push_back(project);
+
+        // the same two objects through the batched scene
+        scene::Scene virtualObjects;
+        virtualObjects.add(scene::makeAxes());
+        virtualObjects.add(scene::makeBox(2, 2, 4), scene::translation(4, -1, 0));
+
+        Kernel render;
+        render.name = "scene::Scene::render";
+        render.prepare = [&](int i) { boards[0].copyTo(work); };
+        render.run = [&](int i) { virtualObjects.render(work, cameraMatrix, distCoeffs, rvec, tvec); };
+        kernels.push_back(render);
+
+        // the same objects filled, the box as a close-up covering most of the frame
+        scene::Scene solidObjects;
+        solidObjects.setShading(scene::SHADING_GOURAUD);
+        solidObjects.add(scene::makeAxes());
+        solidObjects.add(scene::makeBox(2, 2, 4), scene::translation(4, -1, 0));
+        solidObjects.add(scene::makeBox(7, 5, 3));
+
+        Kernel renderSolid;
+        renderSolid.name = "scene::Scene::render/gouraud";
+        renderSolid.prepare = [&](int i) { boards[0].copyTo(work); };
+        renderSolid.run = [&](int i) { solidObjects.render(work, cameraMatrix, distCoeffs, rvec, tvec); };
+        kernels.push_back(renderSolid);
+
+        Kernel solvePnP;
+        solvePnP.name = "cv::solvePnP";
+        solvePnP.prepare = [&](int i) {};
+        solvePnP.run = [&](int i) { cv::solvePnP(posePoints, poseCorners, cameraMatrix, distCoeffs, rvecSolved, tvecSolved); };
+        kernels.push_back(solvePnP);
+
+        Kernel poseCold;
+        poseCold.name = "pose::PoseTracker::estimate/cold";
+        poseCold.prepare = [&](int i) { coldTracker.reset(); };
+        poseCold.run = [&](int i) { coldTracker.estimate(posePoints, poseCorners, cameraMatrix, distCoeffs, 0, rvecSolved, tvecSolved); };
+        kernels.push_back(poseCold);
+
+        Kernel poseWarm;
+        poseWarm.name = "pose::PoseTracker::estimate/warm";
+        poseWarm.prepare = [&](int i) {};
+        poseWarm.run = [&](int i) { warmTracker.estimate(posePoints, poseCorners, cameraMatrix, distCoeffs, ++warmFrame, rvecSolved, tvecSolved); };
+        kernels.push_back(poseWarm);
+
+        Kernel detectMarkers;
+        detectMarkers.name = "aruco::detectMarkers";
+        detectMarkers.prepare = [&](int i) {};
+        detectMarkers.run = [&](int i) { cv::aruco::detectMarkers(markerScene, dictionary, markerCorners, ids, parameters); };
+        kernels.push_back(detectMarkers);
+
+        Kernel compositeImage;
+        compositeImage.name = "overlay::compositeImage/image";
+        compositeImage.prepare = [&](int i) { markerScene.copyTo(work); };
+        compositeImage.run = [&](int i) { overlay::compositeImage(overlaySource, quad, work, compositeBuffers); };
+        kernels.push_back(compositeImage);
+
+        Kernel compositeGif;
+        compositeGif.name = "overlay::compositeImage/gif";
+        compositeGif.prepare = [&](int i) { markerScene.copyTo(work); };
+        compositeGif.run = [&](int i) { overlay::compositeImage(gifFrames[i % gifFrames.size()], quad, work, compositeBuffers); };
+        kernels.push_back(compositeGif);
+
+        Kernel compositeRoi;
+        compositeRoi.name = "overlay::compositeImageRoi/image";
+        compositeRoi.prepare = [&](int i) { markerScene.copyTo(work); };
+        compositeRoi.run = [&](int i) { overlay::compositeImageRoi(overlaySource, quad, work, compositeBuffers, cv::INTER_CUBIC); };
+        kernels.push_back(compositeRoi);
+
+        Kernel compositeRoiLinear;
+        compositeRoiLinear.name = "overlay::compositeImageRoi/image/linear";
+        compositeRoiLinear.prepare = [&](int i) { markerScene.copyTo(work); };
+        compositeRoiLinear.run = [&](int i) { overlay::compositeImageRoi(overlaySource, quad, work, compositeBuffers, cv::INTER_LINEAR); };
+        kernels.push_back(compositeRoiLinear);
+
+        Kernel compositeRoiGif;
+        compositeRoiGif.name = "overlay::compositeImageRoi/gif";
+        compositeRoiGif.prepare = [&](int i) { markerScene.copyTo(work); };
+        compositeRoiGif.run = [&](int i) { overlay::compositeImageRoi(gifFrames[i % gifFrames.size()], quad, work, compositeBuffers, cv::INTER_CUBIC); };
+        kernels.push_back(compositeRoiGif);
+
+        compareComposites(overlaySource, size);
+
+        for (int t = 0; t < threadCounts.size(); t++) {
+            cv::setNumThreads(threadCounts[t]);
+
+            for (int k = 0; k < kernels.size(); k++) {
+                Kernel &kernel = kernels[k];
+
+                // one untimed warm up, so first-call allocations are not measured
+                kernel.prepare(0);
+                kernel.run(0);
+
+                std::vector<double> timings;
+                double total = 0;
+                for (int i = 0; i < iterations; i++) {
+                    kernel.prepare(i);
+                    int64 start = cv::getTickCount();
+                    kernel.run(i);
+                    double ms = (cv::getTickCount() - start) * 1000.0 / cv::getTickFrequency();
+                    timings.push_back(ms);
+                    total += ms;
+                }
+                std::sort(timings.begin(), timings.end());
+
+                printf("{\"kernel\":\"%s\",\"resolution\":\"%dx%d\",\"threads\":%d,\"iterations\":%d,\"p50_ms\":%.3f,\"p99_ms\":%.3f,\"throughput_fps\":%.2f}\n",
+                       kernel.name.c_str(), size.width, size.height, threadCounts[t], iterations,
+                       percentile(timings, 0.50), percentile(timings, 0.99), iterations * 1000.0 / total);
+                fflush(stdout);
+            }
+        }
+    }
+
+    return 0;
+}
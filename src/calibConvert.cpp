@@ -0,0 +1,81 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <opencv2/opencv.hpp>
+#include <string>
+
+#include "calibfile.hpp"
+
+using namespace cv;
+using namespace std;
+
+/* Helper method to check if a path ends with the given suffix. */
+bool endsWith(const char *path, const char *suffix) {
+    size_t n = strlen(path);
+    size_t m = strlen(suffix);
+    return n >= m && strcmp(path + n - m, suffix) == 0;
+}
+
+/*
+  Convert a camera calibration file between the text and the binary format.
+  The output format follows the output file's extension, '.bin' for binary and anything else for text.
+
+  Usage: calibConvert <input> <output> [-s WxH] [-m]
+    -s WxH    image size, required for text input since the text format does not store it
+    -m        compute the fixed-point undistortion maps and store them in the binary file
+ */
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        printf("Usage: calibConvert <input> <output> [-s WxH] [-m]\n");
+        exit(-1);
+    }
+
+    Size imageSize;
+    bool withMaps = false;
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%dx%d", &imageSize.width, &imageSize.height) != 2) {
+                printf("The image size should look like 1280x720.\n");
+                exit(-1);
+            }
+        } else if (strcmp(argv[i], "-m") == 0) {
+            withMaps = true;
+        } else {
+            printf("Unknown option %s\n", argv[i]);
+            exit(-1);
+        }
+    }
+
+    calibfile::Calibration calib;
+    if (!calibfile::load(argv[1], calib)) {
+        printf("%s is not a valid calibration file.\n", argv[1]);
+        exit(-1);
+    }
+    if (!imageSize.empty()) {
+        calib.imageSize = imageSize;
+    }
+
+    if (withMaps) {
+        if (calib.imageSize.empty()) {
+            printf("The undistortion maps need the image size, give it with -s.\n");
+            exit(-1);
+        }
+        cv::initUndistortRectifyMap(calib.cameraMatrix, calib.distCoeffs, Mat(), calib.cameraMatrix, calib.imageSize, CV_16SC2, calib.map1, calib.map2);
+    } else {
+        calib.map1.release();
+        calib.map2.release();
+    }
+
+    bool ok;
+    if (endsWith(argv[2], ".bin")) {
+        ok = calibfile::writeBinary(argv[2], calib);
+    } else {
+        ok = calibfile::writeText(argv[2], calib);
+    }
+
+    if (!ok) {
+        printf("%s cannot be written.\n", argv[2]);
+        exit(-1);
+    }
+    return 0;
+}
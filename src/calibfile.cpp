@@ -0,0 +1,255 @@
+#include "calibfile.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <opencv2/opencv.hpp>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace cv;
+using namespace std;
+using namespace calibfile;
+
+// lookup table of the CRC-32 below
+struct CrcTable {
+    uint32_t entries[256];
+};
+
+static CrcTable makeCrcTable() {
+    CrcTable table;
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        table.entries[i] = c;
+    }
+    return table;
+}
+
+// CRC-32 (IEEE 802.3), table driven. Streams compute keys concurrently, the table is built once by the
+// thread-safe initialization of a local static.
+uint32_t calibfile::crc32(const void *data, size_t size, uint32_t crc) {
+    static const CrcTable table = makeCrcTable();
+
+    const uint8_t *bytes = (const uint8_t *)data;
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) {
+        crc = table.entries[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static bool isSupportedModel(int numCoeffs) {
+    return numCoeffs == DIST_NONE || numCoeffs == DIST_RADIAL_TANGENTIAL_4 || numCoeffs == DIST_RADIAL_TANGENTIAL_5 ||
+           numCoeffs == DIST_RATIONAL_8 || numCoeffs == DIST_THIN_PRISM_12 || numCoeffs == DIST_TILTED_14;
+}
+
+// Write the binary format, the maps are stored only if they match the image size
+bool calibfile::writeBinary(const char *path, const Calibration &calib) {
+    int numCoeffs = (int)calib.distCoeffs.total();
+    if (!isSupportedModel(numCoeffs)) {
+        return false;
+    }
+
+    bool hasMaps = !calib.map1.empty() && !calib.map2.empty() &&
+                   calib.map1.type() == CV_16SC2 && calib.map2.type() == CV_16UC1 &&
+                   calib.map1.size() == calib.imageSize && calib.map2.size() == calib.imageSize;
+
+    // payload
+    std::vector<uint8_t> payload;
+    std::vector<double> values(9 + numCoeffs);
+    for (int i = 0; i < 9; i++) {
+        values[i] = calib.cameraMatrix.at<double>(i / 3, i % 3);
+    }
+    for (int i = 0; i < numCoeffs; i++) {
+        values[9 + i] = calib.distCoeffs.at<double>(i);
+    }
+    payload.insert(payload.end(), (uint8_t *)values.data(), (uint8_t *)(values.data() + values.size()));
+
+    if (hasMaps) {
+        for (int r = 0; r < calib.imageSize.height; r++) {
+            const uint8_t *row = calib.map1.ptr(r);
+            payload.insert(payload.end(), row, row + calib.imageSize.width * calib.map1.elemSize());
+        }
+        for (int r = 0; r < calib.imageSize.height; r++) {
+            const uint8_t *row = calib.map2.ptr(r);
+            payload.insert(payload.end(), row, row + calib.imageSize.width * calib.map2.elemSize());
+        }
+    }
+
+    FileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MAGIC, sizeof(header.magic));
+    header.version = VERSION;
+    header.headerSize = sizeof(FileHeader);
+    header.width = calib.imageSize.width;
+    header.height = calib.imageSize.height;
+    header.distortionModel = numCoeffs;
+    header.flags = hasMaps ? FLAG_HAS_MAPS : 0;
+    header.payloadSize = payload.size();
+    header.checksum = crc32(payload.data(), payload.size());
+
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL) {
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+              fwrite(payload.data(), 1, payload.size(), fp) == payload.size();
+    ok = fclose(fp) == 0 && ok;
+    return ok;
+}
+
+// Read the binary format through mmap, validating the header and the checksum
+bool calibfile::readBinary(const char *path, Calibration &calib) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(FileHeader)) {
+        close(fd);
+        return false;
+    }
+
+    size_t fileSize = st.st_size;
+    void *mapped = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        return false;
+    }
+
+    const uint8_t *base = (const uint8_t *)mapped;
+    FileHeader header;
+    memcpy(&header, base, sizeof(header));
+
+    bool ok = memcmp(header.magic, MAGIC, sizeof(header.magic)) == 0 &&
+              header.version == VERSION &&
+              header.headerSize >= sizeof(FileHeader) &&
+              (size_t)header.headerSize + header.payloadSize <= fileSize &&
+              isSupportedModel(header.distortionModel) &&
+              header.width >= 0 && header.height >= 0;
+    // maps need a real image size, small enough for the file to hold them
+    if (ok && (header.flags & FLAG_HAS_MAPS)) {
+        ok = header.width > 0 && header.height > 0 &&
+             (uint64_t)header.width * header.height <= fileSize / (2 * sizeof(int16_t) + sizeof(uint16_t));
+    }
+
+    size_t numCoeffs = header.distortionModel;
+    size_t paramBytes = (9 + numCoeffs) * sizeof(double);
+    size_t mapBytes = 0;
+    if (ok && (header.flags & FLAG_HAS_MAPS)) {
+        mapBytes = (size_t)header.width * header.height * (2 * sizeof(int16_t) + sizeof(uint16_t));
+    }
+    ok = ok && header.payloadSize == paramBytes + mapBytes;
+
+    const uint8_t *payload = base + header.headerSize;
+    ok = ok && crc32(payload, header.payloadSize) == header.checksum;
+
+    if (ok) {
+        calib.imageSize = Size(header.width, header.height);
+
+        std::vector<double> values(9 + numCoeffs);
+        memcpy(values.data(), payload, paramBytes);
+        calib.cameraMatrix = Mat(3, 3, CV_64F, values.data()).clone();
+        calib.distCoeffs = Mat((int)numCoeffs, 1, CV_64F, values.data() + 9).clone();
+
+        if (mapBytes > 0) {
+            const uint8_t *maps = payload + paramBytes;
+            calib.map1 = Mat(calib.imageSize, CV_16SC2, (void *)maps).clone();
+            calib.map2 = Mat(calib.imageSize, CV_16UC1, (void *)(maps + calib.map1.total() * calib.map1.elemSize())).clone();
+        } else {
+            calib.map1.release();
+            calib.map2.release();
+        }
+    }
+
+    munmap(mapped, fileSize);
+    return ok;
+}
+
+// Write the text format: three rows of the camera matrix, then one row of coefficients
+bool calibfile::writeText(const char *path, const Calibration &calib) {
+    ofstream ofile(path);
+    if (!ofile.is_open()) {
+        return false;
+    }
+
+    for (int i = 0; i < 3; i++) {
+        ofile << calib.cameraMatrix.at<double>(i, 0) << " "
+              << calib.cameraMatrix.at<double>(i, 1) << " "
+              << calib.cameraMatrix.at<double>(i, 2) << endl;
+    }
+    for (int i = 0; i < calib.distCoeffs.total(); i++) {
+        ofile << calib.distCoeffs.at<double>(i) << " ";
+    }
+    ofile << endl;
+
+    return ofile.good();
+}
+
+// Read the text format without printing, the image size is left empty
+bool calibfile::readText(const char *path, Calibration &calib) {
+    ifstream infile(path);
+    if (!infile.is_open()) {
+        return false;
+    }
+
+    calib.cameraMatrix = Mat::zeros(3, 3, CV_64F);
+    string line;
+    for (int i = 0; i < 3; i++) {
+        if (!std::getline(infile, line)) {
+            return false;
+        }
+        istringstream row(line);
+        for (int j = 0; j < 3; j++) {
+            if (!(row >> calib.cameraMatrix.at<double>(i, j))) {
+                return false;
+            }
+        }
+    }
+
+    std::vector<double> coeffs;
+    if (std::getline(infile, line)) {
+        istringstream row(line);
+        double value;
+        while (row >> value) {
+            coeffs.push_back(value);
+        }
+    }
+    if (!isSupportedModel((int)coeffs.size())) {
+        return false;
+    }
+
+    calib.distCoeffs = Mat::zeros((int)coeffs.size(), 1, CV_64F);
+    for (int i = 0; i < coeffs.size(); i++) {
+        calib.distCoeffs.at<double>(i) = coeffs[i];
+    }
+    calib.imageSize = Size();
+    calib.map1.release();
+    calib.map2.release();
+    return true;
+}
+
+bool calibfile::load(const char *path, Calibration &calib) {
+    char magic[4] = {0, 0, 0, 0};
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        return false;
+    }
+    size_t n = fread(magic, 1, sizeof(magic), fp);
+    fclose(fp);
+
+    if (n == sizeof(magic) && memcmp(magic, MAGIC, sizeof(magic)) == 0) {
+        return readBinary(path, calib);
+    }
+    return readText(path, calib);
+}
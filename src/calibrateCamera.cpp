@@ -8,36 +8,219 @@
 #include <vector>
 
 #include "calibration.hpp"
+#include "framesource.hpp"
+#include "pipeline.hpp"
+#include "sink.hpp"
 
 using namespace cv;
 using namespace std;
 using namespace calibration;
 
+/*
+  Offline calibration from a directory of images or a video file.
+  The chessboard corners of all frames are detected on OpenCV's thread pool, then cv::calibrateCamera runs once.
+ */
+int batchMode(char *source, int numThreads, double downscale, int budget) {
+    Size boardSize(8, 6);
+
+    if (numThreads > 0) {
+        cv::setNumThreads(numThreads);
+    }
+    printf("Detecting corners with %d threads\n", cv::getNumThreads());
+
+    std::vector<std::vector<cv::Point3f> > point_list;
+    std::vector<std::vector<cv::Point2f> > corner_list;
+    cv::Size imageSize;
+    int numFrames = 0;
+
+    int64 start = cv::getTickCount();
+
+    std::vector<string> files = calibration::listImageFiles(source);
+    if (files.size() > 0) {
+        // a directory of images, each worker decodes its own file
+        std::vector<std::vector<cv::Point2f> > results;
+        std::vector<cv::Size> imageSizes;
+        calibration::detectCornersInFiles(files, boardSize, results, imageSizes, downscale);
+
+        for (int i = 0; i < files.size(); i++) {
+            if (imageSizes[i].empty()) {
+                printf("%s cannot be loaded, skipped\n", files[i].c_str());
+                continue;
+            }
+            if (imageSize.empty()) {
+                imageSize = imageSizes[i];
+            } else if (imageSizes[i] != imageSize) {
+                printf("%s has a different size, skipped\n", files[i].c_str());
+                continue;
+            }
+            numFrames++;
+            if (results[i].size() == (size_t)boardSize.area()) {
+                corner_list.push_back(results[i]);
+            }
+        }
+    } else {
+        // a video file, decoding is sequential so frames are handed to the workers in chunks,
+        // and the next chunk is decoded ahead while the workers detect
+        framesource::CaptureSource *capture = new framesource::CaptureSource(string(source));
+        if (!capture->isOpened()) {
+            printf("%s is neither an image directory nor a video file\n", source);
+            delete capture;
+            return (-1);
+        }
+
+        const int chunkSize = 4 * cv::getNumThreads();
+        framesource::PrefetchSource video(capture, chunkSize);
+        std::vector<cv::Mat> frames(chunkSize);
+        std::vector<std::vector<cv::Point2f> > results;
+
+        bool more = true;
+        int64_t timestampNs;
+        while (more) {
+            int n = 0;
+            while (n < chunkSize && (more = video.read(frames[n], timestampNs))) {
+                n++;
+            }
+            if (n == 0) {
+                break;
+            }
+
+            std::vector<cv::Mat> chunk(frames.begin(), frames.begin() + n);
+            calibration::detectCornersInFrames(chunk, boardSize, results, downscale);
+
+            imageSize = frames[0].size();
+            numFrames += n;
+            for (int i = 0; i < n; i++) {
+                if (results[i].size() == (size_t)boardSize.area()) {
+                    corner_list.push_back(results[i]);
+                }
+            }
+        }
+    }
+
+    double detectSeconds = (cv::getTickCount() - start) / cv::getTickFrequency();
+    printf("Found the chessboard in %lu of %d frames in %.2lf s\n", corner_list.size(), numFrames, detectSeconds);
+
+    // consecutive video frames are mostly near-duplicate poses, keep only the views that add coverage
+    if (budget > 0) {
+        calibration::ViewSelector selector(imageSize, boardSize, budget);
+        std::vector<std::vector<cv::Point2f> > selected;
+        for (int i = 0; i < corner_list.size(); i++) {
+            int slot = selector.offer(corner_list[i]);
+            if (slot < 0) {
+                continue;
+            } else if (slot == selected.size()) {
+                selected.push_back(corner_list[i]);
+            } else {
+                selected[slot] = corner_list[i];
+            }
+        }
+        printf("Selected %lu of %lu views\n", selected.size(), corner_list.size());
+        corner_list.swap(selected);
+    }
+
+    if (corner_list.size() < 5) {
+        printf("at least 5 frames with a detected chessboard are needed\n");
+        return (-1);
+    }
+
+    std::vector<cv::Point3f> point_set = calibration::get3DWorldUnits(boardSize);
+    point_list.assign(corner_list.size(), point_set);
+
+    // same initial guess as the live mode
+    double camera_matrix[3][3] = {
+        {1, 0, imageSize.width / 2.0},
+        {0, 1, imageSize.height / 2.0},
+        {0, 0, 1}};
+    cv::Mat cameraMatrix(3, 3, CV_64FC1, camera_matrix);
+    cv::Mat distCoeffs = Mat::zeros(8, 1, CV_64F);
+    std::vector<cv::Mat> rvecs;
+    std::vector<cv::Mat> tvecs;
+
+    start = cv::getTickCount();
+    double error = cv::calibrateCamera(point_list, corner_list, imageSize, cameraMatrix, distCoeffs, rvecs, tvecs);
+    printf("Calibrated in %.2lf s\n", (cv::getTickCount() - start) / cv::getTickFrequency());
+
+    calibration::printCalibrateCameraInfo(cameraMatrix, distCoeffs, error);
+
+    // > half-pixel
+    if (error > 0.5) {
+        printf("the error should be less than a half-pixel. please reran the calibration images.\n");
+        return (-1);
+    }
+
+    calibration::writeCalibrateCameraInfo2File(cameraMatrix, distCoeffs, imageSize);
+    return (0);
+}
+
 /*
   Entry function to the calibration
   Reference: Camera calibration With OpenCV
   https://docs.opencv.org/4.x/d4/d94/tutorial_camera_calibration.html
+
+  Usage:
+    calibrateCamera [-p factor] [-b budget]                                  live calibration from the camera
+    calibrateCamera [-p factor] [-b budget] <image dir | video> [threads]    offline batch calibration
+
+    -p factor    find the board on the image downscaled by factor, then refine the corners at full resolution
+    -b budget    keep at most budget views, rejecting the ones that add no coverage (e.g. 30; default 0 keeps every view)
+    --source spec  live mode input: camera index (default 0), video:<file>, images:<dir>, synthetic[:WxH[@fps]], ...,
+                 see framesource.hpp
+    --sink spec  live mode output: window (default), null, video:<file>, images:<pattern> or shm:<name>, see sink.hpp
+    --frames n   stop the live mode after n frames
  */
 int main(int argc, char *argv[]) {
-    cv::VideoCapture *capdev;
+    double downscale = 1.0;
+    int budget = 0;
+    const char *sourceSpec = "0";
+    const char *sinkSpec = "window";
+    long maxFrames = 0;
+    std::vector<char *> args;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            downscale = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            budget = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--source") == 0 && i + 1 < argc) {
+            sourceSpec = argv[++i];
+        } else if (strcmp(argv[i], "--sink") == 0 && i + 1 < argc) {
+            sinkSpec = argv[++i];
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            maxFrames = atol(argv[++i]);
+        } else {
+            args.push_back(argv[i]);
+        }
+    }
 
-    // open the video device
-    capdev = new cv::VideoCapture(0);
-    if (!capdev->isOpened()) {
-        printf("Unable to open video device\n");
+    if (args.size() >= 1) {
+        int numThreads = args.size() >= 2 ? atoi(args[1]) : 0;
+        return batchMode(args[0], numThreads, downscale, budget);
+    }
+
+    // open the video device, or the source given
+    framesource::FrameSource *source = framesource::create(sourceSpec);
+    if (source == NULL) {
         return (-1);
     }
 
     // get some properties of the image
-    cv::Size refS((int)capdev->get(cv::CAP_PROP_FRAME_WIDTH),
-                  (int)capdev->get(cv::CAP_PROP_FRAME_HEIGHT));
+    cv::Size refS = source->frameSize();
     printf("Expected size: %d %d\n", refS.width, refS.height);
 
-    cv::namedWindow("Video", 1);  // identifies a window
+    // a window, or a headless output
+    sink::FrameSink *output = sink::create(sinkSpec, "Video");
+    if (output == NULL) {
+        printf("Unknown sink %s\n", sinkSpec);
+        return (-1);
+    }
+    long numShown = 0;
 
     cv::Mat frame;
-    // must pass capdev to frame, to get updated frame size for initiating other Mat as below
-    *capdev >> frame;
+    // must read a frame, to get updated frame size for initiating other Mat as below
+    int64_t timestampNs;
+    if (!source->read(frame, timestampNs)) {
+        printf("No frame can be read from %s\n", sourceSpec);
+        return (-1);
+    }
 
     Size boardSize(8, 6);
 
@@ -50,7 +233,9 @@ int main(int argc, char *argv[]) {
     std::vector<cv::Point3f> point_set;
     std::vector<std::vector<cv::Point3f> > point_list;
     std::vector<std::vector<cv::Point2f> > corner_list;
-    int idx = 0;
+
+    // bounds the number of views, so the solve time stays about constant in long sessions
+    calibration::ViewSelector selector(frame.size(), boardSize, budget);
 
     // initialize camera matrix
     double camera_matrix[3][3] = {
@@ -61,78 +246,103 @@ int main(int argc, char *argv[]) {
     cv::Mat cameraMatrix(3, 3, CV_64FC1, camera_matrix);
     cv::Mat distCoeffs = Mat::zeros(8, 1, CV_64F);
 
-    // Output vector of rotation vectors (Rodrigues ) estimated for each pattern view (e.g. std::vector<cv::Mat>>).
-    // That is, each i-th rotation vector together with the corresponding i-th translation vector (see the next output parameter description) brings the calibration pattern from the object coordinate space (in which object points are specified) to the camera coordinate space.
-    // In more technical terms, the tuple of the i-th rotation and translation vector performs a change of basis from object coordinate space to camera coordinate space.
-    // Due to its duality, this tuple is equivalent to the position of the calibration pattern with respect to the camera coordinate space.
-    std::vector<cv::Mat> rvecs;
-
-    // Output vector of translation vectors estimated for each pattern view, see parameter describtion above.
-    std::vector<cv::Mat> tvecs;
+    // runs cv::calibrateCamera off the UI thread
+    calibration::CalibrationWorker solver;
 
     // Print out cmd options
     calibration::printOptions();
 
-    for (;;) {
-        *capdev >> frame;  // get a new frame from the camera, treat as a stream
-        if (frame.empty()) {
-            printf("frame is empty\n");
-            break;
-        }
+    // corner detection runs on a worker thread, so a slow findChessboardCorners call does not drop camera frames
+    pipeline::Pipeline<std::vector<cv::Point2f> > stages(
+        *source,
+        [&](pipeline::Frame &frame, std::vector<cv::Point2f> &corner_set) {
+            corner_set = calibration::detectCornersPyramid(frame.image, boardSize, downscale);
+        },
+        [&](pipeline::Frame &frame, std::vector<cv::Point2f> &corner_set) {
+            // see if there is a waiting keystroke
+            char key = output->pollKey(10);
 
-        std::vector<Point2f> corner_set = calibration::detectCorners(frame, boardSize);
+            // break the loop
+            if (key == 'q') {
+                return false;
+            }
+            // make sure the frame is calibrated
+            else if (key == 's' && corner_set.size() > 0) {
+                int slot = (int)corner_list.size();
+                if (budget > 0) {
+                    slot = selector.offer(corner_set);
+                    if (slot < 0) {
+                        printf("this view adds no coverage, rejected\n");
+                    } else if (slot < corner_list.size()) {
+                        printf("replacing the most redundant view %d\n", slot);
+                    }
+                }
 
-        // see if there is a waiting keystroke
-        char key = cv::waitKey(10);
+                if (slot == corner_list.size()) {
+                    // save the corner locations
+                    corner_list.push_back(corner_set);
 
-        // break the loop
-        if (key == 'q') {
-            break;
-        }
-        // make sure the frame is calibrated
-        else if (key == 's' && corner_set.size() > 0) {
-            // save the corner locations
-            corner_list.push_back(corner_set);
-
-            // create a point_set that specifies the 3D units of the corners in world coordinates
-            point_set = calibration::get3DWorldUnits(boardSize);
-            point_list.push_back(point_set);
-
-            // save the frame as an image
-            string fname = "../data/calibration/image_" + to_string(idx) + ".jpg";
-            imwrite(fname, frame);
-            idx++;
-        }
-        // calibrate the camera
-        else if (key == 'c') {
-            if (corner_list.size() < 5) {
-                printf("save at least 5 calibration frames\n");
-            } else {
-                // cv::calibrateCamera
-                // https://docs.opencv.org/3.4/d9/d0c/group__calib3d.html#ga3207604e4b1a1758aa66acb6ed5aa65d
-                double error = cv::calibrateCamera(point_list, corner_list, frame.size(), cameraMatrix, distCoeffs, rvecs, tvecs);
+                    // create a point_set that specifies the 3D units of the corners in world coordinates
+                    point_set = calibration::get3DWorldUnits(boardSize);
+                    point_list.push_back(point_set);
+                } else if (slot >= 0) {
+                    corner_list[slot] = corner_set;
+                }
+
+                // save the frame as an image, a replaced view overwrites its image
+                if (slot >= 0) {
+                    string fname = "../data/calibration/image_" + to_string(slot) + ".jpg";
+                    imwrite(fname, frame.image);
+                }
+            }
+            // calibrate the camera, on a background worker so the video keeps running during the solve
+            else if (key == 'c') {
+                if (corner_list.size() < 5) {
+                    printf("save at least 5 calibration frames\n");
+                } else if (!solver.start(point_list, corner_list, frame.image.size(), cameraMatrix, distCoeffs)) {
+                    printf("a calibration is already running\n");
+                }
+            }
+            // Enable the user to write out the intrinsic parameters to a file: both the camera_matrix and the distortion_ceofficients.
+            else if (key == 'w') {
+                // make sure the camera calibration has been run
+                if (distCoeffs.at<double>(0, 0) != 0) {
+                    calibration::writeCalibrateCameraInfo2File(cameraMatrix, distCoeffs, frame.image.size());
+                }
+            }
 
+            // pick up a finished solve
+            calibration::CalibrationResult result;
+            if (solver.takeResult(result)) {
                 // > half-pixel
-                if (error > 0.5) {
+                if (result.error > 0.5) {
                     printf("the error should be less than a half-pixel. please reran the calibration images.\n");
-                    break;
+                    return false;
                 }
 
+                // cv::calibrateCamera
+                // https://docs.opencv.org/3.4/d9/d0c/group__calib3d.html#ga3207604e4b1a1758aa66acb6ed5aa65d
+                result.cameraMatrix.copyTo(cameraMatrix);
+                result.distCoeffs.copyTo(distCoeffs);
+
                 // Print out the camera matrix and distortion coefficients after the calibration, along with the final re-projection error.
-                calibration::printCalibrateCameraInfo(cameraMatrix, distCoeffs, error);
+                calibration::printCalibrateCameraInfo(cameraMatrix, distCoeffs, result.error);
             }
-        }
-        // Enable the user to write out the intrinsic parameters to a file: both the camera_matrix and the distortion_ceofficients.
-        else if (key == 'w') {
-            // make sure the camera calibration has been run
-            if (distCoeffs.at<double>(0, 0) != 0) {
-                calibration::writeCalibrateCameraInfo2File(cameraMatrix, distCoeffs);
+
+            if (solver.isRunning()) {
+                char text[128];
+                snprintf(text, sizeof(text), "calibrating %d views: %.0f%%  error %.4f", solver.numViews(), solver.progress() * 100, solver.currentError());
+                cv::putText(frame.image, text, Point(10, 30), FONT_HERSHEY_SIMPLEX, 0.8, Scalar(0, 255, 255), 2);
             }
-        }
 
-        imshow("Video", frame);
-    }
+            pipeline::drawStats(frame.image, stages.statsText());
+            output->write(frame.image);
+            return maxFrames == 0 || ++numShown < maxFrames;
+        });
+    stages.run();
 
-    delete capdev;
+    output->close();
+    delete output;
+    delete source;
     return (0);
 }
\ No newline at end of file
@@ -1,8 +1,9 @@
 #include "calibration.hpp"
 
-#include <dirent.h>
 #include <math.h>
 
+#include <algorithm>
+#include <cfloat>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -11,6 +12,9 @@
 #include <opencv2/opencv.hpp>
 #include <vector>
 
+#include "calibfile.hpp"
+#include "imagefiles.hpp"
+
 using namespace cv;
 using namespace std;
 using namespace calibration;
@@ -27,7 +31,8 @@ void calibration::printOptions() {
 }
 
 // Finds the positions of internal corners of the chessboard.
-std::vector<cv::Point2f> calibration::detectCorners(cv::Mat &src, cv::Size &boardSize) {
+// If draw is false, the frame is left untouched, which is what the offline batch mode wants.
+std::vector<cv::Point2f> calibration::detectCorners(cv::Mat &src, cv::Size &boardSize, bool draw) {
     // Reference: https://docs.opencv.org/4.x/d9/d0c/group__calib3d.html#ga93efa9b0aa890de240ca32b11253dd4a
     // Sample usage of detecting and drawing chessboard corners
     std::vector<cv::Point2f> corner_set;
@@ -55,11 +60,88 @@ std::vector<cv::Point2f> calibration::detectCorners(cv::Mat &src, cv::Size &boar
     }
 
     // draw
-    cv::drawChessboardCorners(src, boardSize, Mat(corner_set), cornersFound);
+    if (draw) {
+        cv::drawChessboardCorners(src, boardSize, Mat(corner_set), cornersFound);
+    }
+
+    return corner_set;
+}
+
+// Coarse-to-fine variant of detectCorners.
+// The board is found on the image downscaled by the given factor, and the corners scaled back up are refined with cornerSubPix at full resolution.
+// A factor of 1 or less is the same as detectCorners.
+std::vector<cv::Point2f> calibration::detectCornersPyramid(cv::Mat &src, cv::Size &boardSize, double downscale, bool draw) {
+    if (downscale <= 1.0) {
+        return calibration::detectCorners(src, boardSize, draw);
+    }
+
+    std::vector<cv::Point2f> corner_set;
+
+    Mat gray;
+    cv::cvtColor(src, gray, cv::COLOR_BGR2GRAY);
+    Mat small;
+    cv::resize(gray, small, Size(), 1.0 / downscale, 1.0 / downscale, INTER_AREA);
+
+    bool cornersFound = cv::findChessboardCorners(small, boardSize, corner_set, cv::CALIB_CB_ADAPTIVE_THRESH + CALIB_CB_NORMALIZE_IMAGE + CALIB_CB_FAST_CHECK);
+
+    // scale back to full resolution, pixel centers of the two images are offset by half a pixel
+    for (int i = 0; i < corner_set.size(); i++) {
+        corner_set[i].x = (corner_set[i].x + 0.5f) * downscale - 0.5f;
+        corner_set[i].y = (corner_set[i].y + 0.5f) * downscale - 0.5f;
+    }
+
+    if (cornersFound) {
+        // the coarse corners can be off by about the downscale factor, so the search window grows with it
+        int halfWin = std::max(5, (int)ceil(2 * downscale));
+        Size winSize(halfWin, halfWin);
+        Size zeroZone(-1, -1);
+        cv::cornerSubPix(gray, corner_set, winSize, zeroZone, TermCriteria(TermCriteria::EPS + TermCriteria::COUNT, 30, 0.0001));
+    }
+
+    // draw
+    if (draw) {
+        cv::drawChessboardCorners(src, boardSize, Mat(corner_set), cornersFound);
+    }
 
     return corner_set;
 }
 
+// List the image files of a directory, sorted by name
+std::vector<std::string> calibration::listImageFiles(const char *dirPath) {
+    return imagefiles::listDirectory(dirPath);
+}
+
+// Load and detect the chessboard corners of each image file on OpenCV's thread pool.
+// results[i] is empty when no board is found in files[i]; imageSizes[i] is empty when the file cannot be loaded.
+// Each worker decodes its own image, so only about one frame per thread is alive at a time.
+void calibration::detectCornersInFiles(const std::vector<std::string> &files, cv::Size &boardSize, std::vector<std::vector<cv::Point2f> > &results, std::vector<cv::Size> &imageSizes, double downscale) {
+    results.assign(files.size(), std::vector<cv::Point2f>());
+    imageSizes.assign(files.size(), cv::Size());
+
+    cv::parallel_for_(cv::Range(0, (int)files.size()), [&](const cv::Range &range) {
+        for (int i = range.start; i < range.end; i++) {
+            cv::Mat image = cv::imread(files[i]);
+            if (image.empty()) {
+                continue;
+            }
+            imageSizes[i] = image.size();
+            results[i] = calibration::detectCornersPyramid(image, boardSize, downscale, false);
+        }
+    });
+}
+
+// Detect the chessboard corners of already decoded frames on OpenCV's thread pool.
+// results[i] is empty when no board is found in frames[i].
+void calibration::detectCornersInFrames(std::vector<cv::Mat> &frames, cv::Size &boardSize, std::vector<std::vector<cv::Point2f> > &results, double downscale) {
+    results.assign(frames.size(), std::vector<cv::Point2f>());
+
+    cv::parallel_for_(cv::Range(0, (int)frames.size()), [&](const cv::Range &range) {
+        for (int i = range.start; i < range.end; i++) {
+            results[i] = calibration::detectCornersPyramid(frames[i], boardSize, downscale, false);
+        }
+    });
+}
+
 // Get the 3D world unit coordinates of the chessboard
 std::vector<cv::Point3f> calibration::get3DWorldUnits(cv::Size &boardSize) {
     vector<cv::Point3f> point_set;
@@ -95,22 +177,194 @@ void calibration::printCalibrateCameraInfo(cv::Mat &cameraMatrix, cv::Mat &distC
     printf("\nerror: %lf\n\n", error);
 }
 
-// write information after camera calibration to file
-void calibration::writeCalibrateCameraInfo2File(cv::Mat &cameraMatrix, cv::Mat &distCoeffs) {
-    ofstream ofile;
-    ofile.open("../data/calibration.txt");
+// write information after camera calibration to file, both as text and in the binary format
+void calibration::writeCalibrateCameraInfo2File(cv::Mat &cameraMatrix, cv::Mat &distCoeffs, cv::Size imageSize) {
+    calibfile::Calibration calib;
+    calib.imageSize = imageSize;
+    calib.cameraMatrix = cameraMatrix;
+    calib.distCoeffs = distCoeffs;
 
     // https://stackoverflow.com/questions/16312904/how-to-write-a-float-mat-to-a-file-in-opencv
-    for (int i = 0; i < 3; i++) {
-        ofile << cameraMatrix.at<double>(i, 0) << " "
-              << cameraMatrix.at<double>(i, 1) << " "
-              << cameraMatrix.at<double>(i, 2) << endl;
+    if (!calibfile::writeText("../data/calibration.txt", calib)) {
+        printf("../data/calibration.txt cannot be written\n");
+    }
+    if (!calibfile::writeBinary("../data/calibration.bin", calib)) {
+        printf("../data/calibration.bin cannot be written\n");
     }
+}
 
-    for (int i = 0; i < distCoeffs.rows; i++) {
-        ofile << distCoeffs.at<double>(i, 0) << " ";
+calibration::ViewSelector::ViewSelector(cv::Size imageSize, cv::Size boardSize, int budget, double minNovelty)
+    : imageSize(imageSize), boardSize(boardSize), maxViews(budget), minNovelty(minNovelty) {}
+
+// Describe a view by [center x, center y, scale, horizontal tilt, vertical tilt]
+std::vector<double> calibration::ViewSelector::describe(const std::vector<cv::Point2f> &corner_set) const {
+    int w = boardSize.width;
+    int h = boardSize.height;
+    // outer corners: top left, top right, bottom right, bottom left
+    Point2f tl = corner_set[0];
+    Point2f tr = corner_set[w - 1];
+    Point2f br = corner_set[h * w - 1];
+    Point2f bl = corner_set[(h - 1) * w];
+
+    std::vector<Point2f> quad;
+    quad.push_back(tl);
+    quad.push_back(tr);
+    quad.push_back(br);
+    quad.push_back(bl);
+
+    Point2f center = (tl + tr + br + bl) * 0.25f;
+    double scale = sqrt(cv::contourArea(quad) / imageSize.area());
+
+    // a board tilted away from the camera looks shorter on its far side,
+    // so the log ratio of opposite edges is zero when facing the camera and grows with the tilt
+    double tiltX = log((cv::norm(tr - br) + 1e-6) / (cv::norm(tl - bl) + 1e-6));
+    double tiltY = log((cv::norm(tl - tr) + 1e-6) / (cv::norm(bl - br) + 1e-6));
+
+    std::vector<double> feature(5);
+    feature[0] = center.x / imageSize.width;
+    feature[1] = center.y / imageSize.height;
+    feature[2] = scale;
+    feature[3] = tiltX;
+    feature[4] = tiltY;
+    return feature;
+}
+
+double calibration::ViewSelector::distance(const std::vector<double> &a, const std::vector<double> &b) const {
+    double d = 0;
+    for (int i = 0; i < a.size(); i++) {
+        d += (a[i] - b[i]) * (a[i] - b[i]);
+    }
+    return sqrt(d);
+}
+
+double calibration::ViewSelector::novelty(const std::vector<cv::Point2f> &corner_set) const {
+    std::vector<double> feature = describe(corner_set);
+    double closest = DBL_MAX;
+    for (int i = 0; i < features.size(); i++) {
+        closest = std::min(closest, distance(feature, features[i]));
+    }
+    return closest;
+}
+
+// The accepted view whose nearest neighbour is closest, along with that distance
+int calibration::ViewSelector::mostRedundant(double &redundancy) const {
+    int index = -1;
+    redundancy = DBL_MAX;
+    for (int i = 0; i < features.size(); i++) {
+        for (int j = 0; j < features.size(); j++) {
+            if (i == j) {
+                continue;
+            }
+            double d = distance(features[i], features[j]);
+            if (d < redundancy) {
+                redundancy = d;
+                index = i;
+            }
+        }
+    }
+    return index;
+}
+
+int calibration::ViewSelector::offer(const std::vector<cv::Point2f> &corner_set) {
+    if (corner_set.size() != (size_t)boardSize.area()) {
+        return -1;
+    }
+
+    std::vector<double> feature = describe(corner_set);
+    double score = novelty(corner_set);
+    if (score < minNovelty) {
+        return -1;
+    }
+
+    if (maxViews <= 0 || features.size() < maxViews) {
+        features.push_back(feature);
+        return (int)features.size() - 1;
     }
 
-    ofile << endl;
-    ofile.close();
-}
\ No newline at end of file
+    // full: swap out the most redundant view, if the candidate adds more coverage than it does
+    double redundancy;
+    int slot = mostRedundant(redundancy);
+    if (slot < 0 || score <= redundancy) {
+        return -1;
+    }
+    features[slot] = feature;
+    return slot;
+}
+
+calibration::CalibrationWorker::CalibrationWorker(int maxRounds, int iterationsPerRound)
+    : maxRounds(maxRounds), iterationsPerRound(iterationsPerRound), running(false), progressValue(0), errorValue(-1), viewCount(0), hasResult(false) {}
+
+calibration::CalibrationWorker::~CalibrationWorker() {
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+// Snapshot the views and start a solve on the worker thread
+bool calibration::CalibrationWorker::start(const std::vector<std::vector<cv::Point3f> > &point_list, const std::vector<std::vector<cv::Point2f> > &corner_list, cv::Size imageSize, const cv::Mat &cameraMatrix, const cv::Mat &distCoeffs) {
+    if (running) {
+        return false;
+    }
+    // the previous solve has finished, its thread only needs to be joined
+    if (worker.joinable()) {
+        worker.join();
+    }
+
+    running = true;
+    progressValue = 0;
+    errorValue = -1;
+    viewCount = (int)corner_list.size();
+    worker = std::thread(&CalibrationWorker::solve, this, point_list, corner_list, imageSize, cameraMatrix.clone(), distCoeffs.clone());
+    return true;
+}
+
+// cv::calibrateCamera has no progress callback, so the solve is split into rounds of a few iterations.
+// The first round initializes the intrinsics the same way a single call does, later rounds continue from the last estimate.
+void calibration::CalibrationWorker::solve(std::vector<std::vector<cv::Point3f> > point_list, std::vector<std::vector<cv::Point2f> > corner_list, cv::Size imageSize, cv::Mat cameraMatrix, cv::Mat distCoeffs) {
+    // Output vector of rotation vectors (Rodrigues ) estimated for each pattern view (e.g. std::vector<cv::Mat>>).
+    // That is, each i-th rotation vector together with the corresponding i-th translation vector (see the next output parameter description) brings the calibration pattern from the object coordinate space (in which object points are specified) to the camera coordinate space.
+    // In more technical terms, the tuple of the i-th rotation and translation vector performs a change of basis from object coordinate space to camera coordinate space.
+    // Due to its duality, this tuple is equivalent to the position of the calibration pattern with respect to the camera coordinate space.
+    std::vector<cv::Mat> rvecs;
+
+    // Output vector of translation vectors estimated for each pattern view, see parameter describtion above.
+    std::vector<cv::Mat> tvecs;
+
+    double error = -1;
+
+    for (int round = 0; round < maxRounds; round++) {
+        int flags = round == 0 ? 0 : CALIB_USE_INTRINSIC_GUESS;
+        TermCriteria criteria(TermCriteria::COUNT + TermCriteria::EPS, iterationsPerRound, DBL_EPSILON);
+        double roundError = cv::calibrateCamera(point_list, corner_list, imageSize, cameraMatrix, distCoeffs, rvecs, tvecs, flags, criteria);
+
+        bool converged = error >= 0 && fabs(error - roundError) < 1e-6;
+        error = roundError;
+        errorValue = error;
+        progressValue = (round + 1) / (float)maxRounds;
+        if (converged) {
+            break;
+        }
+    }
+
+    // publish the result as a whole, the UI thread never sees a half written one
+    {
+        std::lock_guard<std::mutex> lock(resultMutex);
+        result.cameraMatrix = cameraMatrix;
+        result.distCoeffs = distCoeffs;
+        result.error = error;
+        result.numViews = (int)corner_list.size();
+        hasResult = true;
+    }
+    progressValue = 1;
+    running = false;
+}
+
+bool calibration::CalibrationWorker::takeResult(CalibrationResult &result) {
+    std::lock_guard<std::mutex> lock(resultMutex);
+    if (!hasResult) {
+        return false;
+    }
+    result = this->result;
+    hasResult = false;
+    return true;
+}
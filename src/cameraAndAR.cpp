@@ -1,14 +1,30 @@
 #include <dirent.h>
 
+#include <cmath>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <filesystem>
+#include <memory>
 #include <opencv2/opencv.hpp>
+#include <sstream>
+#include <string>
 #include <vector>
 
+#include "allocdebug.hpp"
 #include "ar.hpp"
+#include "calibfile.hpp"
 #include "calibration.hpp"
+#include "engine.hpp"
+#include "flowtrack.hpp"
+#include "framesource.hpp"
+#include "pipeline.hpp"
+#include "pose.hpp"
+#include "posepub.hpp"
+#include "scene.hpp"
+#include "sink.hpp"
+#include "telemetry.hpp"
+#include "undistort.hpp"
 
 using namespace cv;
 using namespace std;
@@ -32,101 +48,427 @@ void checkLoadedInfo(cv::Mat &cameraMatrix, cv::Mat &distCoeffs) {
     printf("\n\n");
 }
 
-/* Helper method to print out realtime rotation and translation result.*/
-void printRealtimeResult(cv::Mat &rvec, cv::Mat &tvec) {
-    // print out the rotation and translation data in real time
-    printf("Rotation vectors: [");
-    for (int i = 0; i < 3; i++) {
-        printf("%lf", rvec.at<double>(0, i));
-    }
-    printf("]\n");
-    printf("Translation vectors: [");
-    for (int i = 0; i < 3; i++) {
-        printf("%lf", tvec.at<double>(0, i));
+/* Command line options of the AR loop */
+struct Options {
+    // search the chessboard only around where it was in the previous frame
+    bool tracking;
+    // undistort each frame once with a cached remap, then use a zero-distortion model
+    bool undistort;
+    // seed solvePnP with the predicted pose and smooth the poses over time
+    bool poseTracking;
+    // detect the chessboard every N frames only, and follow its corners with optical flow in between
+    bool flowTracking;
+    // Wavefront OBJ model placed on the board, NULL for none
+    const char *model;
+    // wireframe, or filled and depth-tested faces
+    scene::Shading shading;
+    // where the frames come from, see framesource::create
+    const char *sourceSpec;
+    // where the frames go, see sink::create
+    const char *sinkSpec;
+    // stop after this many frames, 0 runs until 'q' or the end of the source
+    long maxFrames;
+    // multi-stream mode: one "<calibration>,<source>[,<max fps>]" per stream
+    std::vector<std::string> streams;
+    // size of the shared pool in multi-stream mode, 0 for every hardware thread
+    int workers;
+    // binary telemetry log, NULL for none
+    const char *logPath;
+    // seconds between two pose lines on the console, 0 for none
+    double consoleInterval;
+    // shared memory name the poses are published to, NULL for none
+    const char *publishName;
+    // also publish the annotated frames
+    bool publishImage;
+
+    Options() : tracking(false), undistort(false), poseTracking(false), flowTracking(false), model(NULL), shading(scene::SHADING_WIREFRAME), sourceSpec("0"), sinkSpec("window"), maxFrames(0), workers(0), logPath(NULL), consoleInterval(1.0), publishName(NULL), publishImage(false) {}
+};
+
+/*
+Per-stream state of the AR loop: the calibration, the reused buffers, the trackers and the virtual objects.
+Frames of one stream are processed one at a time, in the single-stream pipeline and in the multi-stream engine alike,
+so none of this is shared between threads.
+*/
+struct BoardStream {
+    BoardStream(int id, const cv::Mat &cameraMatrix, const cv::Mat &distCoeffs, Size boardSize, undistort::MapCache &mapCache, telemetry::Recorder &recorder)
+        : id(id), cameraMatrix(cameraMatrix), distCoeffs(distCoeffs), boardSize(boardSize), context(boardSize), tracker(boardSize), undistorter(cameraMatrix, distCoeffs, mapCache), recorder(recorder) {}
+
+    int id;
+    cv::Mat cameraMatrix;
+    cv::Mat distCoeffs;
+    Size boardSize;
+
+    // buffers reused by every frame of this stream
+    ar::FrameContext context;
+    allocdebug::FrameMeter meter;
+
+    // only used in tracking mode
+    ar::BoardTracker tracker;
+    // only used in pose tracking mode
+    pose::PoseTracker poseTracker;
+    // only used in flow tracking mode
+    flowtrack::AdaptiveTracker flowTracker;
+    cv::Mat gray;
+
+    // in undistort mode every frame is remapped first, and the model used downstream has no distortion
+    undistort::Undistorter undistorter;
+
+    // the virtual objects on the board, all projected with one call per frame
+    scene::Scene virtualObjects;
+
+    // shared by every stream, records without locking
+    telemetry::Recorder &recorder;
+    std::vector<cv::Point2f> projected;
+
+    // local consumers read the poses from shared memory, NULL when not published
+    std::unique_ptr<posepub::Publisher> publisher;
+};
+
+/* Helper method to get the milliseconds since a tick count. */
+float elapsedMs(int64 start) {
+    return (float)((cv::getTickCount() - start) * 1000.0 / cv::getTickFrequency());
+}
+
+/* Helper method to place the virtual objects on the board, returns false if the OBJ model cannot be loaded. */
+bool buildScene(BoardStream &stream, Options &options) {
+    scene::Scene &virtualObjects = stream.virtualObjects;
+    virtualObjects.setShading(options.shading);
+    virtualObjects.add(scene::makeAxes());
+    virtualObjects.add(scene::makeBox(2, 2, 4), scene::translation(4, -1, 0));
+    if (options.model != NULL) {
+        scene::Mesh mesh;
+        if (!scene::loadOBJ(options.model, mesh, YELLOW)) {
+            printf("%s cannot be loaded as an OBJ model\n", options.model);
+            return false;
+        }
+        // centered on the board, standing up towards the viewer
+        Size &boardSize = stream.boardSize;
+        virtualObjects.add(mesh, scene::translation((boardSize.width - 1) / 2.0f, -(boardSize.height - 1) / 2.0f, 0) * scene::yUpToBoard());
     }
-    printf("]\n");
+    return true;
 }
 
 /*
-Helper method to starts a video loop.
-For each frame, it tries to detect a chessboard.
+Helper method to process one frame of a stream.
+It tries to detect a chessboard.
 If found, it grabs the locations of the corners, and then uses solvePNP to get the board's pose (rotation and translation).
+The pose and the stage timings go to the telemetry recorder, the console only sees them rate-limited.
+Returns whether the board was found.
 */
-int loadVideo(cv::Mat &cameraMatrix, cv::Mat &distCoeffs) {
-    cv::VideoCapture *capdev;
-
-    // open the video device
-    capdev = new cv::VideoCapture(0);
-    if (!capdev->isOpened()) {
-        printf("Unable to open video device\n");
-        return (-1);
+bool processFrame(BoardStream &stream, pipeline::Frame &frame, Options &options) {
+    if (options.undistort) {
+        stream.undistorter.apply(frame.image);
     }
+    cv::Mat &modelMatrix = options.undistort ? stream.undistorter.cameraMatrix() : stream.cameraMatrix;
+    cv::Mat &modelCoeffs = options.undistort ? stream.undistorter.distCoeffs() : stream.distCoeffs;
 
-    // get some properties of the image
-    cv::Size refS((int)capdev->get(cv::CAP_PROP_FRAME_WIDTH),
-                  (int)capdev->get(cv::CAP_PROP_FRAME_HEIGHT));
-    printf("Expected size: %d %d\n", refS.width, refS.height);
+    stream.meter.begin();
 
-    cv::namedWindow("Video", 1);  // identifies a window
+    // the 3D world units, the corners and the pose all live in the stream's context
+    std::vector<cv::Point3f> &point_set = stream.context.point_set;
+    std::vector<Point2f> &corner_set = stream.context.corner_set;
+    cv::Mat &rvec = stream.context.rvec;
+    cv::Mat &tvec = stream.context.tvec;
 
-    cv::Mat frame;
-    // must pass capdev to frame, to get updated frame size for initiating other Mat as below
-    *capdev >> frame;
+    telemetry::Record record;
+    memset(&record, 0, sizeof(record));
+    record.stream = stream.id;
+    record.frameIndex = frame.index;
 
-    Size boardSize(8, 6);
+    // the detectors and the solvers allocate inside OpenCV, counted apart from the loop's own allocations
+    int64 start = cv::getTickCount();
+    bool foundChessBoard = false;
+    bool flowed = false;
+    stream.meter.enterLibrary();
+    if (options.flowTracking) {
+        cv::cvtColor(frame.image, stream.gray, COLOR_BGR2GRAY);
+        flowed = !stream.flowTracker.needsDetection() && stream.flowTracker.track(stream.gray, corner_set);
+        foundChessBoard = flowed;
+    }
+    if (!flowed) {
+        if (options.tracking) {
+            foundChessBoard = stream.tracker.findCorners(frame.image, corner_set);
+        } else {
+            foundChessBoard = cv::findChessboardCorners(frame.image, stream.boardSize, corner_set);
+        }
+        if (options.flowTracking) {
+            // no board, no points; clear() keeps the capacity, so nothing is allocated
+            if (!foundChessBoard) {
+                corner_set.clear();
+            }
+            stream.flowTracker.detected(stream.gray, corner_set);
+        }
+    }
+    stream.meter.leaveLibrary();
+    record.detectMs = elapsedMs(start);
+    if (flowed) {
+        record.flags |= telemetry::FLAG_FLOW;
+    }
 
-    int idx = 0;
-    for (;;) {
-        *capdev >> frame;  // get a new frame from the camera, treat as a stream
-        if (frame.empty()) {
-            printf("frame is empty\n");
-            break;
+    start = cv::getTickCount();
+    stream.meter.enterLibrary();
+    if (foundChessBoard) {
+        // Finds an object pose from 3D-2D point correspondences.
+        // This function returns the rotation and the translation vectors that transform a 3D point expressed in the object coordinate frame to the camera coordinate frame.
+        // https://docs.opencv.org/3.4/d9/d0c/group__calib3d.html#ga549c2075fac14829ff4a58bc931c033d
+        if (options.poseTracking) {
+            foundChessBoard = stream.poseTracker.estimate(point_set, corner_set, modelMatrix, modelCoeffs, frame.index, rvec, tvec);
+        } else {
+            cv::solvePnP(point_set, corner_set, modelMatrix, modelCoeffs, rvec, tvec);
         }
+    } else if (options.poseTracking) {
+        stream.poseTracker.reset();
+    }
+    stream.meter.leaveLibrary();
+    record.solveMs = elapsedMs(start);
 
-        char key = waitKey(10);
-        if (key == 'q') {
-            break;
+    if (foundChessBoard) {
+        if (options.tracking) {
+            stream.tracker.updatePose(rvec, tvec, modelMatrix, modelCoeffs);
         }
 
-        std::vector<cv::Point3f> point_set;
-        std::vector<Point2f> corner_set;
-        // https://stackoverflow.com/questions/15245262/opencv-mat-element-types-and-their-sizes
-        cv::Mat rvec = Mat::zeros(1, 3, DataType<double>::type);
-        cv::Mat tvec = Mat::zeros(1, 3, DataType<double>::type);
+        record.flags |= telemetry::FLAG_FOUND;
+        for (int i = 0; i < 3; i++) {
+            record.rvec[i] = rvec.at<double>(i);
+            record.tvec[i] = tvec.at<double>(i);
+        }
+        if (options.poseTracking) {
+            const pose::SolveStats &stats = stream.poseTracker.lastStats();
+            record.reprojectionError = stats.errorPx;
+            record.iterations = stats.refinements;
+            if (stats.warmStart) {
+                record.flags |= telemetry::FLAG_WARM_START;
+            }
+
+            char text[96];
+            snprintf(text, sizeof(text), "solvePnP: %s, %d refinements, %.3f ms, %.2f px", stats.warmStart ? "warm" : "cold", stats.refinements, stats.solveMs, stats.errorPx);
+            cv::putText(frame.image, text, Point(10, 50), FONT_HERSHEY_PLAIN, 1.2, YELLOW, 1);
+        } else {
+            stream.meter.enterLibrary();
+            record.reprojectionError = pose::reprojectionError(point_set, corner_set, modelMatrix, modelCoeffs, rvec, tvec, stream.projected);
+            stream.meter.leaveLibrary();
+        }
+
+        start = cv::getTickCount();
+        // projectPoints and parallel_for_ allocate inside
+        stream.meter.enterLibrary();
+        stream.virtualObjects.render(frame.image, modelMatrix, modelCoeffs, rvec, tvec);
+        stream.meter.leaveLibrary();
+        record.renderMs = elapsedMs(start);
+    }
+
+    if (options.tracking) {
+        cv::rectangle(frame.image, stream.tracker.lastSearchArea(), GRAY, 1);
+    }
+    if (options.flowTracking) {
+        const flowtrack::TrackStats &stats = stream.flowTracker.lastStats();
+        char text[96];
+        snprintf(text, sizeof(text), "%s, detect every %d frames, motion %.1f px", stats.detected ? "detected" : "flow", stats.interval, stats.motionPx);
+        cv::putText(frame.image, text, Point(10, 70), FONT_HERSHEY_PLAIN, 1.2, YELLOW, 1);
+    }
+
+    // only counted in -DAR_ALLOC_DEBUG=ON builds
+    if (stream.meter.end() >= 0) {
+        string text = "allocations/frame: " + to_string(stream.meter.lastFrame()) + " (OpenCV " + to_string(stream.meter.lastLibrary()) + ")";
+        cv::putText(frame.image, text, Point(10, 30), FONT_HERSHEY_PLAIN, 1.2, YELLOW, 1);
+    }
 
-        // load 3D world units
-        point_set = calibration::get3DWorldUnits(boardSize);
+    record.timestampNs = telemetry::nowNs();
+    stream.recorder.record(record);
 
-        bool foundChessBoard = cv::findChessboardCorners(frame, boardSize, corner_set);
+    if (stream.publisher) {
+        stream.publisher->begin(frame.index, posepub::SOURCE_CHESSBOARD, options.publishImage ? frame.image : cv::Mat());
         if (foundChessBoard) {
-            // Finds an object pose from 3D-2D point correspondences.
-            // This function returns the rotation and the translation vectors that transform a 3D point expressed in the object coordinate frame to the camera coordinate frame.
-            // https://docs.opencv.org/3.4/d9/d0c/group__calib3d.html#ga549c2075fac14829ff4a58bc931c033d
-            cv::solvePnP(point_set, corner_set, cameraMatrix, distCoeffs, rvec, tvec);
+            stream.publisher->addPose(-1, cv::Vec3d(record.rvec), cv::Vec3d(record.tvec), corner_set);
+        }
+        stream.publisher->end();
+    }
+    return foundChessBoard;
+}
+
+/*
+Helper method to starts a video loop.
+For each frame, it tries to detect a chessboard, and draws the virtual objects on it.
+*/
+int loadVideo(cv::Mat &cameraMatrix, cv::Mat &distCoeffs, Options &options, telemetry::Recorder &recorder) {
+    // open the video device, or the source given
+    framesource::FrameSource *source = framesource::create(options.sourceSpec);
+    if (source == NULL) {
+        return (-1);
+    }
+
+    // get some properties of the image
+    cv::Size refS = source->frameSize();
+    printf("Expected size: %d %d\n", refS.width, refS.height);
+
+    // a window, or a headless output
+    sink::FrameSink *output = sink::create(options.sinkSpec, "Video");
+    if (output == NULL) {
+        printf("Unknown sink %s\n", options.sinkSpec);
+        return (-1);
+    }
+    long numShown = 0;
+
+    Size boardSize(8, 6);
 
-            printRealtimeResult(rvec, tvec);
-            ar::project3DAxes(frame, cameraMatrix, distCoeffs, rvec, tvec);
+    int idx = 0;
 
-            ar::project3DTriangular(frame, 4, -1, cameraMatrix, distCoeffs, rvec, tvec);
+    // the pipeline has one worker, so the stream's state follows the capture order
+    undistort::MapCache mapCache;
+    BoardStream stream(0, cameraMatrix, distCoeffs, boardSize, mapCache, recorder);
+    if (!buildScene(stream, options)) {
+        return (-1);
+    }
+    if (options.publishName != NULL) {
+        stream.publisher.reset(new posepub::Publisher(options.publishName));
+    }
+
+    // chessboard detection and pose estimation run on a worker thread, the window and keys stay on this thread
+    pipeline::Pipeline<bool> stages(
+        *source,
+        [&](pipeline::Frame &frame, bool &foundChessBoard) {
+            foundChessBoard = processFrame(stream, frame, options);
+        },
+        [&](pipeline::Frame &frame, bool &foundChessBoard) {
+            char key = output->pollKey(10);
+            if (key == 'q') {
+                return false;
+            }
 
             // save the frame as an image
-            if (key == 'w') {
+            if (foundChessBoard && key == 'w') {
                 string fname = "../data/ar/image_" + to_string(idx) + ".jpg";
-                imwrite(fname, frame);
+                imwrite(fname, frame.image);
                 idx++;
             }
 
-            // if (idx < 6) {
-            //     string fname = "../data/ar/borders_" + to_string(idx) + ".jpg";
-            //     imwrite(fname, frame);
-            //     idx++;
-            // }
+            pipeline::drawStats(frame.image, stages.statsText());
+            output->write(frame.image);
+            return options.maxFrames == 0 || ++numShown < options.maxFrames;
+        });
+    stages.run();
+
+    output->close();
+    if (output->dropped() > 0) {
+        printf("%ld frames dropped by the output\n", output->dropped());
+    }
+    delete output;
+    delete source;
+    return (0);
+}
+
+/*
+Helper method to run many sources at once.
+Every stream has its own calibration and state, their frames are processed on one shared engine::ThreadPool,
+and the latest frame of each stream is shown as a tile of one mosaic.
+*/
+int multiStream(Options &options, telemetry::Recorder &recorder) {
+    Size boardSize(8, 6);
+    const Size tileSize(640, 360);
+
+    undistort::MapCache mapCache;
+    std::vector<BoardStream *> streams;
+    engine::ThreadPool pool(options.workers);
+    engine::StreamEngine streamEngine(pool, [&](int id, pipeline::Frame &frame) {
+        processFrame(*streams[id], frame, options);
+    });
+
+    for (int i = 0; i < options.streams.size(); i++) {
+        // <calibration>,<source>[,<max fps>]
+        std::vector<std::string> fields;
+        std::stringstream spec(options.streams[i]);
+        std::string field;
+        while (std::getline(spec, field, ',')) {
+            fields.push_back(field);
+        }
+        if (fields.size() < 2 || fields.size() > 3) {
+            printf("The stream %s should look like <calibration>,<source>[,<max fps>]\n", options.streams[i].c_str());
+            return (-1);
+        }
+
+        calibfile::Calibration calib;
+        if (!calibfile::load(fields[0].c_str(), calib)) {
+            printf("%s cannot be loaded as a calibration file\n", fields[0].c_str());
+            return (-1);
         }
 
-        imshow("Video", frame);
+        // a number is a camera index, anything else a source spec, a file or a URL
+        framesource::FrameSource *source = framesource::create(fields[1]);
+        if (source == NULL) {
+            return (-1);
+        }
+
+        BoardStream *stream = new BoardStream(i, calib.cameraMatrix, calib.distCoeffs, boardSize, mapCache, recorder);
+        if (!buildScene(*stream, options)) {
+            delete stream;
+            return (-1);
+        }
+        // one writer per ring, so each stream publishes under its own name
+        if (options.publishName != NULL) {
+            stream->publisher.reset(new posepub::Publisher(string(options.publishName) + "_" + to_string(i)));
+        }
+        streams.push_back(stream);
+        streamEngine.addStream(source, fields.size() == 3 ? atof(fields[2].c_str()) : 0);
     }
 
-    delete capdev;
+    sink::FrameSink *output = sink::create(options.sinkSpec, "Streams");
+    if (output == NULL) {
+        printf("Unknown sink %s\n", options.sinkSpec);
+        return (-1);
+    }
+
+    int cols = (int)ceil(sqrt((double)streams.size()));
+    int rows = ((int)streams.size() + cols - 1) / cols;
+    std::vector<cv::Mat> tiles(streams.size());
+    for (int i = 0; i < tiles.size(); i++) {
+        tiles[i] = Mat::zeros(tileSize, CV_8UC3);
+    }
+    // the mosaic handed to the output comes from a pool, an async output may still hold the previous one
+    std::vector<cv::Mat> mosaics;
+    long numShown = 0;
+    int64 lastReport = cv::getTickCount();
+
+    streamEngine.start();
+    while (streamEngine.waitForResults(10)) {
+        pipeline::Frame frame;
+        for (int i = 0; i < streams.size(); i++) {
+            if (streamEngine.takeResult(i, frame)) {
+                cv::resize(frame.image, tiles[i], tileSize, 0, 0, INTER_AREA);
+                pipeline::drawStats(tiles[i], streamEngine.statsText(i));
+            }
+        }
+
+        cv::Mat &mosaic = ar::reusableBuffer(mosaics);
+        mosaic.create(rows * tileSize.height, cols * tileSize.width, CV_8UC3);
+        mosaic.setTo(Scalar::all(0));
+        for (int i = 0; i < tiles.size(); i++) {
+            cv::Mat tile = mosaic(Rect((i % cols) * tileSize.width, (i / cols) * tileSize.height, tileSize.width, tileSize.height));
+            tiles[i].copyTo(tile);
+        }
+        cv::putText(mosaic, streamEngine.aggregateText(), Point(10, 20), FONT_HERSHEY_PLAIN, 1.2, YELLOW, 1);
+        output->write(mosaic);
+
+        // per-stream and aggregate frame rates on the console, once a second
+        if ((cv::getTickCount() - lastReport) / cv::getTickFrequency() >= 1.0) {
+            lastReport = cv::getTickCount();
+            for (int i = 0; i < streams.size(); i++) {
+                printf("%s\n", streamEngine.statsText(i).c_str());
+            }
+            printf("%s\n", streamEngine.aggregateText().c_str());
+        }
+
+        char key = output->pollKey(1);
+        if (key == 'q' || (options.maxFrames > 0 && ++numShown >= options.maxFrames)) {
+            break;
+        }
+    }
+    streamEngine.stop();
+
+    output->close();
+    delete output;
+    for (int i = 0; i < streams.size(); i++) {
+        delete streams[i];
+    }
     return (0);
 }
 
@@ -134,40 +476,127 @@ int loadVideo(cv::Mat &cameraMatrix, cv::Mat &distCoeffs) {
   Entry function to the AR
   Reference: solvePNP With OpenCV
   https://docs.opencv.org/3.4/d9/d0c/group__calib3d.html#ga549c2075fac14829ff4a58bc931c033d
+
+  Usage: AR <calibration file> [options]
+         AR --stream <calibration>,<source>[,<max fps>] [--stream ...] [options]
+    -t    tracking mode, search the chessboard in the region predicted from the previous frame
+    -u    undistort each frame with cached remap tables (../data/cache), then use a zero-distortion model
+    -p    pose tracking mode, warm-start solvePnP from the predicted pose and filter the poses over time
+    -f    flow tracking mode, detect the chessboard every N frames and follow its corners with Lucas-Kanade in between;
+          N adapts to the motion, and a lost corner triggers a detection
+    -o <model.obj>    also draw a Wavefront OBJ model on the board, in board square units
+    --solid <flat|gouraud>
+                      draw the box and the model as filled, depth-tested faces with the software rasterizer,
+                      lit from the camera per face or per vertex
+    --source <spec>   camera index (default 0), video:<file>, images:<dir>, gif:<file>, synthetic[:WxH[@fps]], or any of
+                      them after prefetch:, see framesource.hpp
+    --sink <spec>     window (default), null, video:<file>, images:<pattern> or shm:<name>, see sink.hpp
+    --frames <n>      stop after n frames, for headless runs
+    --stream <calibration>,<source>[,<max fps>]
+                      multi-stream mode, one per source; the source is a spec as for --source, a video file or a
+                      URL, and the optional max fps caps how much of the shared pool the stream can use
+    --workers <n>     threads of the shared pool in multi-stream mode (default: every hardware thread)
+    --log <file>      record the pose, reprojection error and stage timings of every frame to a binary log,
+                      telemetryToCsv converts it
+    --console <s>     seconds between two pose lines on the console (default 1, 0 for none)
+    --publish <name>  publish the board pose and corners of every frame to POSIX shared memory, e.g. /ar_poses,
+                      in multi-stream mode to <name>_<stream index>; see posepub.hpp and poseReader
+    --publish-image   also publish the annotated frames
  */
 int main(int argc, char *argv[]) {
-    char cameraCalibrationFile[256];
+    char cameraCalibrationFile[256] = "";
     // image of type CV_64FC1 is simple grayscale image and has only 1 channel:
     // image of type CV_64FC3 is colored image with 3 channels
     // CV_64F is the same as CV_64FC1
     // https://stackoverflow.com/questions/19248926/difference-of-opencv-mat-types
     cv::Mat cameraMatrix(3, 3, CV_64FC1);
 
-    if (argc < 2) {
-        cout << "Please give a file path to camera calibration file\n";
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-t") == 0) {
+            options.tracking = true;
+        } else if (strcmp(argv[i], "-u") == 0) {
+            options.undistort = true;
+        } else if (strcmp(argv[i], "-p") == 0) {
+            options.poseTracking = true;
+        } else if (strcmp(argv[i], "-f") == 0) {
+            options.flowTracking = true;
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            options.model = argv[++i];
+        } else if (strcmp(argv[i], "--solid") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "flat") == 0) {
+                options.shading = scene::SHADING_FLAT;
+            } else if (strcmp(argv[i], "gouraud") == 0) {
+                options.shading = scene::SHADING_GOURAUD;
+            } else {
+                printf("Unknown shading %s\n", argv[i]);
+                exit(-1);
+            }
+        } else if (strcmp(argv[i], "--source") == 0 && i + 1 < argc) {
+            options.sourceSpec = argv[++i];
+        } else if (strcmp(argv[i], "--sink") == 0 && i + 1 < argc) {
+            options.sinkSpec = argv[++i];
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            options.maxFrames = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--stream") == 0 && i + 1 < argc) {
+            options.streams.push_back(argv[++i]);
+        } else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            options.workers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--log") == 0 && i + 1 < argc) {
+            options.logPath = argv[++i];
+        } else if (strcmp(argv[i], "--console") == 0 && i + 1 < argc) {
+            options.consoleInterval = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--publish") == 0 && i + 1 < argc) {
+            options.publishName = argv[++i];
+        } else if (strcmp(argv[i], "--publish-image") == 0) {
+            options.publishImage = true;
+        } else if (argv[i][0] != '-' && cameraCalibrationFile[0] == 0) {
+            strncpy(cameraCalibrationFile, argv[i], sizeof(cameraCalibrationFile) - 1);
+            cameraCalibrationFile[sizeof(cameraCalibrationFile) - 1] = 0;
+        } else {
+            printf("Unknown option %s\n", argv[i]);
+            exit(-1);
+        }
+    }
+
+    allocdebug::install();
+
+    // drained by its own thread, so no frame waits on the terminal or the disk
+    telemetry::Recorder recorder(options.logPath, options.consoleInterval);
+    if (options.logPath != NULL && !recorder.isOpen()) {
         exit(-1);
     }
 
-    std::strcpy(cameraCalibrationFile, argv[1]);
+    if (!options.streams.empty()) {
+        int status = multiStream(options, recorder);
+        recorder.close();
+        return status;
+    }
 
-    std::vector<double> coeffs;
-    ar::readCameraCalibrationInfo(cameraCalibrationFile, cameraMatrix, coeffs);
+    if (cameraCalibrationFile[0] == 0) {
+        cout << "Please give a file path to camera calibration file\n";
+        exit(-1);
+    }
 
-    // check at least 5 images' info are loaded
-    if (coeffs.size() < 5) {
+    // binary or text calibration file, see calibfile.hpp
+    calibfile::Calibration calib;
+    if (!calibfile::load(cameraCalibrationFile, calib)) {
         printf("\nCamera calibration info cannot be loaded. Please give a correct file path.\n");
         exit(-1);
     } else {
         printf("\nCamera calibration info has been loaded.\n");
     }
 
-    // load coeffs to distCoeffs, no pre-defined distCoeffs' size
-    cv::Mat distCoeffs = cv::Mat::zeros(coeffs.size(), 1, CV_64F);
-    for (int i = 0; i < coeffs.size(); i++) {
-        distCoeffs.at<double>(i, 0) = coeffs[i];
-    }
+    cameraMatrix = calib.cameraMatrix;
+    cv::Mat distCoeffs = calib.distCoeffs;
 
     checkLoadedInfo(cameraMatrix, distCoeffs);
 
-    loadVideo(cameraMatrix, distCoeffs);
-}
\ No newline at end of file
+    loadVideo(cameraMatrix, distCoeffs, options, recorder);
+
+    recorder.close();
+    if (recorder.dropped() > 0) {
+        printf("%ld telemetry records dropped\n", recorder.dropped());
+    }
+}
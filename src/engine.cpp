@@ -0,0 +1,293 @@
+#include "engine.hpp"
+
+#include <cstdio>
+#include <opencv2/opencv.hpp>
+#include <string>
+
+using namespace cv;
+using namespace std;
+using namespace engine;
+
+engine::ThreadPool::ThreadPool(int numWorkers) : nextQueue(0), pending(0), numSteals(0), stopping(false) {
+    if (numWorkers <= 0) {
+        numWorkers = std::max(1, (int)std::thread::hardware_concurrency());
+    }
+    for (int i = 0; i < numWorkers; i++) {
+        queues.push_back(std::unique_ptr<Queue>(new Queue()));
+    }
+    for (int i = 0; i < numWorkers; i++) {
+        workers.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+    }
+}
+
+engine::ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(idleMutex);
+        stopping = true;
+    }
+    idle.notify_all();
+    for (int i = 0; i < workers.size(); i++) {
+        workers[i].join();
+    }
+}
+
+void engine::ThreadPool::submit(Task task) {
+    Queue &queue = *queues[nextQueue++ % queues.size()];
+    {
+        std::lock_guard<std::mutex> lock(queue.m);
+        queue.tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(idleMutex);
+        pending++;
+    }
+    idle.notify_one();
+}
+
+// The worker's own queue first, then the others in turn
+bool engine::ThreadPool::take(int id, Task &task) {
+    for (int k = 0; k < queues.size(); k++) {
+        Queue &queue = *queues[(id + k) % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.m);
+        if (!queue.tasks.empty()) {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            pending--;
+            if (k > 0) {
+                numSteals++;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void engine::ThreadPool::workerLoop(int id) {
+    Task task;
+    while (true) {
+        if (take(id, task)) {
+            task();
+            task = Task();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(idleMutex);
+        idle.wait(lock, [this] { return pending > 0 || stopping; });
+        // the queued tasks still run when stopping
+        if (stopping && pending == 0) {
+            return;
+        }
+    }
+}
+
+engine::StreamEngine::StreamEngine(ThreadPool &pool, ProcessFn process) : pool(pool), process(process), running(false), activeTasks(0), newResults(false) {}
+
+engine::StreamEngine::~StreamEngine() {
+    stop();
+    for (int i = 0; i < streams.size(); i++) {
+        delete streams[i]->source;
+    }
+}
+
+int engine::StreamEngine::addStream(framesource::FrameSource *source, double maxFps) {
+    Stream *stream = new Stream();
+    stream->source = source;
+    stream->maxFps = maxFps;
+    stream->inFlight = false;
+    stream->hasPending = false;
+    stream->ended = false;
+    stream->hasResult = false;
+    stream->dropped = 0;
+    stream->skipped = 0;
+    streams.push_back(std::unique_ptr<Stream>(stream));
+    return (int)streams.size() - 1;
+}
+
+void engine::StreamEngine::start() {
+    running = true;
+    for (int i = 0; i < streams.size(); i++) {
+        streams[i]->captureThread = std::thread(&StreamEngine::captureLoop, this, i);
+    }
+}
+
+void engine::StreamEngine::stop() {
+    if (!running) {
+        return;
+    }
+    running = false;
+    for (int i = 0; i < streams.size(); i++) {
+        {
+            std::lock_guard<std::mutex> lock(streams[i]->m);
+            streams[i]->pendingTaken.notify_all();
+        }
+        streams[i]->captureThread.join();
+        std::lock_guard<std::mutex> lock(streams[i]->m);
+        streams[i]->hasPending = false;
+    }
+
+    // the process function refers to the caller's state, and runFrame to the engine's: wait until no worker is
+    // inside runFrame, not only until no frame is in flight
+    while (activeTasks > 0) {
+        std::unique_lock<std::mutex> lock(resultMutex);
+        resultReady.wait_for(lock, std::chrono::milliseconds(10));
+    }
+}
+
+void engine::StreamEngine::captureLoop(int id) {
+    Stream &stream = *streams[id];
+    long index = 0;
+    int64 lastAdmitted = 0;
+
+    while (running) {
+        pipeline::Frame frame;
+        if (!stream.source->read(frame.image, frame.timestampNs) || frame.image.empty()) {
+            printf("stream %d: frame is empty\n", id);
+            break;
+        }
+        frame.index = index++;
+        stream.captureStats.tick();
+
+        // the rate cap, checked before the frame takes a place in the pool
+        if (stream.maxFps > 0) {
+            int64 now = cv::getTickCount();
+            if (lastAdmitted != 0 && (now - lastAdmitted) < cv::getTickFrequency() / stream.maxFps) {
+                std::lock_guard<std::mutex> lock(stream.m);
+                stream.skipped++;
+                continue;
+            }
+            lastAdmitted = now;
+        }
+
+        schedule(id, frame);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(stream.m);
+        stream.ended = true;
+    }
+    {
+        std::lock_guard<std::mutex> lock(resultMutex);
+        newResults = true;
+    }
+    resultReady.notify_all();
+}
+
+// Submit the frame, or keep it as the pending frame while the stream's previous frame is in flight.
+// A live source's frame replaces a pending one; any other source waits until the pending frame is taken.
+void engine::StreamEngine::schedule(int id, pipeline::Frame &frame) {
+    Stream &stream = *streams[id];
+    {
+        std::unique_lock<std::mutex> lock(stream.m);
+        if (!stream.source->isLive()) {
+            stream.pendingTaken.wait(lock, [this, &stream] { return !stream.hasPending || !running; });
+            if (!running) {
+                return;
+            }
+        }
+        if (stream.inFlight) {
+            if (stream.hasPending) {
+                stream.dropped++;
+            }
+            stream.pending = frame;
+            stream.hasPending = true;
+            return;
+        }
+        stream.inFlight = true;
+    }
+    activeTasks++;
+    pool.submit([this, id, frame] { runFrame(id, frame); });
+}
+
+void engine::StreamEngine::runFrame(int id, pipeline::Frame frame) {
+    Stream &stream = *streams[id];
+    process(id, frame);
+    stream.processStats.tick();
+    aggregateStats.tick();
+
+    // publish the result, and hand the pending frame to the pool, behind the other streams' frames
+    pipeline::Frame next;
+    bool hasNext = false;
+    {
+        std::lock_guard<std::mutex> lock(stream.m);
+        stream.result = frame;
+        stream.hasResult = true;
+        if (stream.hasPending) {
+            next = stream.pending;
+            stream.pending = pipeline::Frame();
+            stream.hasPending = false;
+            stream.pendingTaken.notify_all();
+            hasNext = true;
+        } else {
+            stream.inFlight = false;
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(resultMutex);
+        newResults = true;
+    }
+    resultReady.notify_all();
+
+    if (hasNext) {
+        activeTasks++;
+        pool.submit([this, id, next] { runFrame(id, next); });
+    }
+    // the very last step, stop() may destroy the engine as soon as the count drops to zero
+    activeTasks--;
+}
+
+bool engine::StreamEngine::waitForResults(int timeoutMs) {
+    {
+        std::unique_lock<std::mutex> lock(resultMutex);
+        resultReady.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this] { return newResults; });
+        newResults = false;
+    }
+
+    for (int i = 0; i < streams.size(); i++) {
+        std::lock_guard<std::mutex> lock(streams[i]->m);
+        if (!streams[i]->ended || streams[i]->inFlight || streams[i]->hasResult) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool engine::StreamEngine::takeResult(int id, pipeline::Frame &frame) {
+    Stream &stream = *streams[id];
+    std::lock_guard<std::mutex> lock(stream.m);
+    if (!stream.hasResult) {
+        return false;
+    }
+    frame = stream.result;
+    stream.result = pipeline::Frame();
+    stream.hasResult = false;
+    return true;
+}
+
+double engine::StreamEngine::streamFps(int id) const {
+    return streams[id]->processStats.fps();
+}
+
+double engine::StreamEngine::aggregateFps() const {
+    return aggregateStats.fps();
+}
+
+std::string engine::StreamEngine::statsText(int id) const {
+    Stream &stream = *streams[id];
+    long dropped, skipped;
+    {
+        std::lock_guard<std::mutex> lock(stream.m);
+        dropped = stream.dropped;
+        skipped = stream.skipped;
+    }
+    char text[160];
+    snprintf(text, sizeof(text), "stream %d: process %.1f fps | capture %.1f fps | dropped %ld | capped %ld",
+             id, stream.processStats.fps(), stream.captureStats.fps(), dropped, skipped);
+    return std::string(text);
+}
+
+std::string engine::StreamEngine::aggregateText() const {
+    char text[160];
+    snprintf(text, sizeof(text), "%d streams: %.1f fps on %d workers | steals %ld",
+             numStreams(), aggregateStats.fps(), pool.size(), pool.steals());
+    return std::string(text);
+}
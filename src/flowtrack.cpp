@@ -0,0 +1,97 @@
+#include "flowtrack.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <opencv2/opencv.hpp>
+#include <opencv2/video.hpp>
+
+using namespace cv;
+using namespace std;
+using namespace flowtrack;
+
+static const Size WIN_SIZE(21, 21);
+static const int MAX_LEVEL = 3;
+// a point that does not come back within this distance when tracked backward is lost
+static const float MAX_BACKWARD_ERROR_PX = 1.0f;
+
+flowtrack::AdaptiveTracker::AdaptiveTracker(int minInterval, int maxInterval, float lowMotionPx, float highMotionPx)
+    : minInterval(std::max(minInterval, 1)), maxInterval(std::max(maxInterval, minInterval)), lowMotionPx(lowMotionPx), highMotionPx(highMotionPx),
+      interval(std::max(minInterval, 1)), sinceDetection(0), hasPoints(false), cycleMaxMotion(0), numDetections(0), numTracked(0) {}
+
+void flowtrack::AdaptiveTracker::shrinkInterval() {
+    interval = std::max(interval / 2, minInterval);
+}
+
+void flowtrack::AdaptiveTracker::detected(const cv::Mat &gray, const std::vector<cv::Point2f> &points) {
+    numDetections++;
+
+    // a whole cycle of slow motion, detections can be further apart
+    if (hasPoints && sinceDetection > 0 && cycleMaxMotion < lowMotionPx) {
+        interval = std::min(interval + 1, maxInterval);
+    }
+    hasPoints = !points.empty();
+    sinceDetection = 0;
+    cycleMaxMotion = 0;
+    if (hasPoints) {
+        cv::buildOpticalFlowPyramid(gray, prevPyramid, WIN_SIZE, MAX_LEVEL);
+        prevPoints.assign(points.begin(), points.end());
+    }
+
+    stats.detected = true;
+    stats.interval = interval;
+    stats.motionPx = 0;
+    stats.lost = 0;
+}
+
+bool flowtrack::AdaptiveTracker::track(const cv::Mat &gray, std::vector<cv::Point2f> &points) {
+    stats.detected = false;
+    if (!hasPoints) {
+        return false;
+    }
+
+    cv::buildOpticalFlowPyramid(gray, pyramid, WIN_SIZE, MAX_LEVEL);
+    cv::calcOpticalFlowPyrLK(prevPyramid, pyramid, prevPoints, nextPoints, status, errors, WIN_SIZE, MAX_LEVEL);
+    cv::calcOpticalFlowPyrLK(pyramid, prevPyramid, nextPoints, backPoints, backStatus, errors, WIN_SIZE, MAX_LEVEL);
+
+    int lost = 0;
+    motions.clear();
+    for (int i = 0; i < prevPoints.size(); i++) {
+        Point2f back = backPoints[i] - prevPoints[i];
+        if (!status[i] || !backStatus[i] || back.dot(back) > MAX_BACKWARD_ERROR_PX * MAX_BACKWARD_ERROR_PX) {
+            lost++;
+            continue;
+        }
+        Point2f d = nextPoints[i] - prevPoints[i];
+        motions.push_back(sqrt(d.dot(d)));
+    }
+    stats.lost = lost;
+
+    // every point is needed downstream, one lost point means the whole set is redetected
+    if (lost > 0) {
+        shrinkInterval();
+        stats.interval = interval;
+        hasPoints = false;
+        return false;
+    }
+
+    std::nth_element(motions.begin(), motions.begin() + motions.size() / 2, motions.end());
+    stats.motionPx = motions[motions.size() / 2];
+    cycleMaxMotion = std::max(cycleMaxMotion, stats.motionPx);
+    if (stats.motionPx > highMotionPx) {
+        shrinkInterval();
+    }
+    stats.interval = interval;
+
+    std::swap(prevPyramid, pyramid);
+    prevPoints.swap(nextPoints);
+    points.assign(prevPoints.begin(), prevPoints.end());
+    sinceDetection++;
+    numTracked++;
+    return true;
+}
+
+void flowtrack::AdaptiveTracker::reset() {
+    hasPoints = false;
+    sinceDetection = 0;
+    cycleMaxMotion = 0;
+}
@@ -0,0 +1,254 @@
+#include "framesource.hpp"
+
+#include <sys/stat.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <opencv2/opencv.hpp>
+
+#include "imagefiles.hpp"
+
+using namespace cv;
+using namespace std;
+using namespace framesource;
+
+int64_t framesource::nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+framesource::CaptureSource::CaptureSource(int device) : capture(device), live(true) {}
+
+framesource::CaptureSource::CaptureSource(const std::string &path) : capture(path), live(path.find("://") != std::string::npos) {}
+
+bool framesource::CaptureSource::read(cv::Mat &image, int64_t &timestampNs) {
+    if (!capture.grab()) {
+        return false;
+    }
+    timestampNs = nowNs();
+    return capture.retrieve(image) && !image.empty();
+}
+
+cv::Size framesource::CaptureSource::frameSize() const {
+    return Size((int)capture.get(cv::CAP_PROP_FRAME_WIDTH), (int)capture.get(cv::CAP_PROP_FRAME_HEIGHT));
+}
+
+framesource::ImageSequenceSource::ImageSequenceSource(const std::vector<std::string> &files, bool loop) : files(files), loop(loop), next(0) {}
+
+bool framesource::ImageSequenceSource::read(cv::Mat &image, int64_t &timestampNs) {
+    // a full pass without one readable file ends the source even when it loops
+    for (size_t tried = 0; tried < files.size(); tried++) {
+        if (next == files.size()) {
+            if (!loop) {
+                return false;
+            }
+            next = 0;
+        }
+        const string &file = files[next++];
+        timestampNs = nowNs();
+        image = cv::imread(file);
+        if (!image.empty()) {
+            return true;
+        }
+        printf("%s cannot be loaded, skipped\n", file.c_str());
+    }
+    return false;
+}
+
+framesource::GifSource::GifSource(const std::string &path, bool loop) : loop(loop), next(0) {
+    cv::VideoCapture gif(path);
+    cv::Mat frame;
+    while (gif.read(frame)) {
+        // the capture reuses its buffer, each frame is kept as a deep copy
+        frames.push_back(frame.clone());
+    }
+}
+
+bool framesource::GifSource::read(cv::Mat &image, int64_t &timestampNs) {
+    if (next == frames.size()) {
+        if (!loop || frames.empty()) {
+            return false;
+        }
+        next = 0;
+    }
+    timestampNs = nowNs();
+    frames[next++].copyTo(image);
+    return true;
+}
+
+framesource::SyntheticSource::SyntheticSource(cv::Size size, double fps, long maxFrames) : size(size), fps(fps), maxFrames(maxFrames), index(0), nextNs(0) {}
+
+bool framesource::SyntheticSource::read(cv::Mat &image, int64_t &timestampNs) {
+    if (maxFrames > 0 && index >= maxFrames) {
+        return false;
+    }
+
+    // paced like a camera: the frame is ready at its slot, not before
+    if (fps > 0) {
+        int64_t now = nowNs();
+        if (nextNs == 0 || now - nextNs > 1000000000) {
+            nextNs = now;
+        }
+        if (nextNs > now) {
+            std::this_thread::sleep_for(std::chrono::nanoseconds(nextNs - now));
+        }
+        nextNs += (int64_t)(1e9 / fps);
+    }
+    timestampNs = nowNs();
+
+    // 9x7 squares, 8x6 inner corners like the boards of the calibration and AR programs, on a white margin
+    int square = std::max(std::min(size.width, size.height) / 14, 4);
+    Size board(9 * square, 7 * square);
+    double t = index / 30.0;
+    int freeX = std::max(size.width - board.width - 2 * square, 0), freeY = std::max(size.height - board.height - 2 * square, 0);
+    int x0 = square + (int)(freeX * (0.5 + 0.5 * sin(t * 0.7)));
+    int y0 = square + (int)(freeY * (0.5 + 0.5 * sin(t * 1.1)));
+
+    image.create(size, CV_8UC3);
+    image.setTo(Scalar::all(96));
+    cv::rectangle(image, Rect(x0 - square / 2, y0 - square / 2, board.width + square, board.height + square), Scalar::all(255), FILLED);
+    for (int row = 0; row < 7; row++) {
+        for (int col = 0; col < 9; col++) {
+            if ((row + col) % 2 == 0) {
+                cv::rectangle(image, Rect(x0 + col * square, y0 + row * square, square, square), Scalar::all(0), FILLED);
+            }
+        }
+    }
+    index++;
+    return true;
+}
+
+framesource::PrefetchSource::PrefetchSource(FrameSource *source, size_t depth) : source(source), depth(std::max(depth, (size_t)1)), ended(false), stopping(false) {
+    decodeThread = std::thread(&PrefetchSource::decodeLoop, this);
+}
+
+framesource::PrefetchSource::~PrefetchSource() {
+    {
+        std::lock_guard<std::mutex> lock(m);
+        stopping = true;
+    }
+    changed.notify_all();
+    decodeThread.join();
+}
+
+void framesource::PrefetchSource::decodeLoop() {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m);
+            changed.wait(lock, [this] { return queue.size() < depth || stopping; });
+            if (stopping) {
+                break;
+            }
+        }
+
+        // decoded outside the lock, so the reader can take the frames already queued meanwhile
+        std::pair<cv::Mat, int64_t> frame;
+        bool ok = source->read(frame.first, frame.second);
+
+        std::lock_guard<std::mutex> lock(m);
+        if (!ok) {
+            ended = true;
+            changed.notify_all();
+            break;
+        }
+        queue.push_back(std::move(frame));
+        changed.notify_all();
+    }
+}
+
+bool framesource::PrefetchSource::read(cv::Mat &image, int64_t &timestampNs) {
+    std::unique_lock<std::mutex> lock(m);
+    changed.wait(lock, [this] { return !queue.empty() || ended; });
+    if (queue.empty()) {
+        return false;
+    }
+    image = queue.front().first;
+    timestampNs = queue.front().second;
+    queue.pop_front();
+    changed.notify_all();
+    return true;
+}
+
+/* Helper method to tell whether a path names a directory. */
+static bool isDirectory(const std::string &path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+}
+
+/* Helper method to parse the optional WxH@fps of a synthetic source spec. */
+static SyntheticSource *createSynthetic(const std::string &options) {
+    int width = 1280, height = 720;
+    double fps = 30;
+    if (!options.empty()) {
+        int fields = sscanf(options.c_str(), "%dx%d@%lf", &width, &height, &fps);
+        if (fields < 2 || width <= 0 || height <= 0) {
+            printf("The synthetic source should look like synthetic:<width>x<height>[@<fps>]\n");
+            return NULL;
+        }
+    }
+    return new SyntheticSource(Size(width, height), fps);
+}
+
+framesource::FrameSource *framesource::create(const std::string &spec) {
+    if (spec.compare(0, 9, "prefetch:") == 0) {
+        FrameSource *source = create(spec.substr(9));
+        return source == NULL ? NULL : new PrefetchSource(source);
+    }
+    if (spec == "synthetic") {
+        return createSynthetic("");
+    }
+    if (spec.compare(0, 10, "synthetic:") == 0) {
+        return createSynthetic(spec.substr(10));
+    }
+
+    string kind, path = spec;
+    size_t colon = spec.find(':');
+    if (colon != string::npos) {
+        string prefix = spec.substr(0, colon);
+        if (prefix == "camera" || prefix == "video" || prefix == "images" || prefix == "gif") {
+            kind = prefix;
+            path = spec.substr(colon + 1);
+        }
+    }
+    // a number is a camera index
+    char *end;
+    long device = strtol(path.c_str(), &end, 10);
+    if (kind.empty() || kind == "camera") {
+        if (*end == 0 && !path.empty()) {
+            kind = "camera";
+        } else if (kind.empty()) {
+            bool gif = path.size() >= 4 && path.compare(path.size() - 4, 4, ".gif") == 0;
+            kind = isDirectory(path) ? "images" : (gif ? "gif" : "video");
+        } else {
+            printf("The camera source should look like camera:<n>\n");
+            return NULL;
+        }
+    }
+
+    if (kind == "images") {
+        std::vector<string> files = imagefiles::collect(path.c_str());
+        if (files.empty()) {
+            printf("No image found in %s\n", path.c_str());
+            return NULL;
+        }
+        return new ImageSequenceSource(files);
+    }
+    if (kind == "gif") {
+        GifSource *gif = new GifSource(path);
+        if (!gif->isOpened()) {
+            printf("The GIF %s cannot be loaded\n", path.c_str());
+            delete gif;
+            return NULL;
+        }
+        return gif;
+    }
+
+    CaptureSource *capture = kind == "camera" ? new CaptureSource((int)device) : new CaptureSource(path);
+    if (!capture->isOpened()) {
+        printf("Unable to open %s\n", spec.c_str());
+        delete capture;
+        return NULL;
+    }
+    return capture;
+}
@@ -0,0 +1,444 @@
+#include "harris.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdio>
+#include <cstring>
+#include <opencv2/core/hal/intrin.hpp>
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+using namespace cv;
+using namespace std;
+using namespace harris;
+
+const cv::Scalar ORANGE = cv::Scalar(0, 140, 255);
+
+// rows of one parallel band and columns of one tile of the fused kernel, a tile's rows of derivatives, products and
+// sums take a few KB and stay in L1 while the tile is swept from top to bottom
+static const int BAND_ROWS = 32;
+static const int TILE_COLS = 256;
+
+/* Helper method to mirror an index into 0..n-1 like BORDER_REFLECT_101, the border of cornerHarris. */
+static inline int reflect101(int i, int n) {
+    return i < 0 ? -i : (i >= n ? 2 * n - 2 - i : i);
+}
+
+/*
+Helper method for the horizontal passes of both Sobel filters over columns c0..c1 of a gray row.
+dx gets [-1 0 1], dy gets [1 2 1] times the scale, each product added in kernel order like OpenCV's row filter.
+*/
+static void sobelRow(const uchar *src, int cols, int c0, int c1, float s, float *rx, float *ry) {
+    float s2 = 2 * s;
+    int c = c0;
+    for (; c <= c1 && c < 1; c++) {
+        int left = reflect101(c - 1, cols), right = reflect101(c + 1, cols);
+        rx[c - c0] = (float)src[right] - (float)src[left];
+        ry[c - c0] = s * src[left] + s2 * src[c] + s * src[right];
+    }
+
+#if CV_SIMD
+    int end = std::min(c1, cols - 2);
+    v_float32 vs = vx_setall_f32(s), vs2 = vx_setall_f32(s2);
+    for (; c + v_float32::nlanes - 1 <= end; c += v_float32::nlanes) {
+        v_float32 left = v_cvt_f32(v_reinterpret_as_s32(vx_load_expand_q(src + c - 1)));
+        v_float32 mid = v_cvt_f32(v_reinterpret_as_s32(vx_load_expand_q(src + c)));
+        v_float32 right = v_cvt_f32(v_reinterpret_as_s32(vx_load_expand_q(src + c + 1)));
+        v_store(rx + c - c0, right - left);
+        v_store(ry + c - c0, v_muladd(right, vs, v_muladd(mid, vs2, left * vs)));
+    }
+#endif
+    for (; c <= c1; c++) {
+        int left = reflect101(c - 1, cols), right = reflect101(c + 1, cols);
+        rx[c - c0] = (float)src[right] - (float)src[left];
+        ry[c - c0] = s * src[left] + s2 * src[c] + s * src[right];
+    }
+}
+
+/*
+Helper method for the vertical passes from three horizontally filtered rows, and the products of the derivatives.
+dx gets [1 2 1] times the scale, dy gets [-1 0 1], as in OpenCV's 3-tap column filter.
+*/
+static void structureRow(const float *x0, const float *x1, const float *x2, const float *y0, const float *y2, int n, float s,
+                         float *a, float *b, float *c) {
+    float s2 = 2 * s;
+    int i = 0;
+#if CV_SIMD
+    v_float32 vs = vx_setall_f32(s), vs2 = vx_setall_f32(s2);
+    for (; i + v_float32::nlanes <= n; i += v_float32::nlanes) {
+        v_float32 dx = v_muladd(vx_load(x0 + i) + vx_load(x2 + i), vs, vx_load(x1 + i) * vs2);
+        v_float32 dy = vx_load(y2 + i) - vx_load(y0 + i);
+        v_store(a + i, dx * dx);
+        v_store(b + i, dx * dy);
+        v_store(c + i, dy * dy);
+    }
+#endif
+    for (; i < n; i++) {
+        float dx = (x0[i] + x2[i]) * s + x1[i] * s2;
+        float dy = y2[i] - y0[i];
+        a[i] = dx * dx;
+        b[i] = dx * dy;
+        c[i] = dy * dy;
+    }
+}
+
+/*
+Helper method to compute the response of the tile of rows y0..y1-1 and columns x0..x1-1, sweeping it from the top.
+A ring of three filtered gray rows feeds the derivatives, and two rows of box sums feed the response.
+*/
+static void harrisTile(const cv::Mat &gray, cv::Mat &response, float s, float k, int x0, int x1, int y0, int y1) {
+    // derivatives are needed on the tile and the column to its left, which the 2x2 box reaches
+    int c0 = std::max(x0 - 1, 0), c1 = x1 - 1;
+    int n = c1 - c0 + 1, w = x1 - x0;
+
+    static thread_local std::vector<float> filtered, products;
+    static thread_local std::vector<double> sums;
+    filtered.resize(6 * n);
+    products.resize(3 * n);
+    sums.resize(6 * w);
+    int ringRows[3] = {-1, -1, -1};
+    float *a = &products[0], *b = a + n, *c = b + n;
+
+    // the box of row y covers the products of rows y - 1 and y, row -1 is mirrored to row 1
+    for (int r = y0 - 1; r < y1; r++) {
+        int row = reflect101(r, gray.rows);
+        const float *rx[3], *ry[3];
+        for (int i = 0; i < 3; i++) {
+            int q = reflect101(row + i - 1, gray.rows);
+            float *slot = &filtered[(q % 3) * 2 * n];
+            if (ringRows[q % 3] != q) {
+                sobelRow(gray.ptr<uchar>(q), gray.cols, c0, c1, s, slot, slot + n);
+                ringRows[q % 3] = q;
+            }
+            rx[i] = slot;
+            ry[i] = slot + n;
+        }
+        structureRow(rx[0], rx[1], rx[2], ry[0], ry[2], n, s, a, b, c);
+
+        // horizontal pairs, summed in double like boxFilter's CV_64F accumulator so the result rounds once
+        int parity = (r - y0 + 1) & 1;
+        double *cur = &sums[parity * 3 * w], *prev = &sums[(1 - parity) * 3 * w];
+        for (int i = 0; i < w; i++) {
+            int x = x0 + i;
+            int left = (x == 0 ? 1 : x - 1) - c0, mid = x - c0;
+            cur[i] = (double)a[left] + a[mid];
+            cur[w + i] = (double)b[left] + b[mid];
+            cur[2 * w + i] = (double)c[left] + c[mid];
+        }
+        if (r < y0) {
+            continue;
+        }
+
+        float *out = response.ptr<float>(r) + x0;
+        for (int i = 0; i < w; i++) {
+            float sa = (float)(prev[i] + cur[i]);
+            float sb = (float)(prev[w + i] + cur[w + i]);
+            float sc = (float)(prev[2 * w + i] + cur[2 * w + i]);
+            out[i] = sa * sc - sb * sb - k * (sa + sc) * (sa + sc);
+        }
+    }
+}
+
+void harris::cornerHarrisFused(const cv::Mat &gray, cv::Mat &response, double k) {
+    if (gray.type() != CV_8UC1 || gray.rows < 2 || gray.cols < 2) {
+        cv::cornerHarris(gray, response, 2, 3, k);
+        return;
+    }
+    response.create(gray.size(), CV_32F);
+
+    // the derivative scale of cornerHarris for 8-bit input: 1 / (2^(ksize - 1) * blockSize * 255)
+    float s = (float)(1.0 / (4 * 2 * 255.0));
+    int bands = (gray.rows + BAND_ROWS - 1) / BAND_ROWS;
+    cv::parallel_for_(Range(0, bands), [&](const Range &range) {
+        for (int band = range.start; band < range.end; band++) {
+            int y0 = band * BAND_ROWS, y1 = std::min(y0 + BAND_ROWS, gray.rows);
+            for (int x0 = 0; x0 < gray.cols; x0 += TILE_COLS) {
+                harrisTile(gray, response, s, (float)k, x0, std::min(x0 + TILE_COLS, gray.cols), y0, y1);
+            }
+        }
+    });
+}
+
+// Reference - https://docs.opencv.org/3.4/d4/d7d/tutorial_harris_detector.html
+void harris::detectHarrisCorners(const cv::Mat &frame, std::vector<cv::KeyPoint> &keypoints, HarrisBuffers &buffers, int threshold) {
+    // change to gray
+    const cv::Mat *gray = &frame;
+    if (frame.channels() == 3) {
+        cv::cvtColor(frame, buffers.gray, COLOR_BGR2GRAY);
+        gray = &buffers.gray;
+    }
+
+    // cornerHarris with blockSize 2 (the neighborhood), ksize 3 (the Sobel aperture) and k 0.04 (the free parameter)
+    cornerHarrisFused(*gray, buffers.response, 0.04);
+    extractKeypoints(buffers.response, threshold, keypoints);
+}
+
+/* Helper method to turn a threshold on the 0..255 scale of the response's min-max range into a response level. */
+static float responseLevel(double minVal, double maxVal, int threshold) {
+    return (float)(minVal + (maxVal - minVal) * (threshold + 1) / 255.0);
+}
+
+/*
+Helper method to append the keypoints of the pixels of area at or above level that are the maximum of their 3x3
+neighborhood. The 1-pixel border of the response is never searched.
+*/
+static void extractArea(const cv::Mat &response, float level, const cv::Rect &area, std::vector<cv::KeyPoint> &keypoints) {
+    int xStart = std::max(area.x, 1), xEnd = std::min(area.x + area.width, response.cols - 1);
+    int yStart = std::max(area.y, 1), yEnd = std::min(area.y + area.height, response.rows - 1);
+
+    for (int y = yStart; y < yEnd; y++) {
+        const float *up = response.ptr<float>(y - 1);
+        const float *row = response.ptr<float>(y);
+        const float *down = response.ptr<float>(y + 1);
+        int x = xStart;
+
+#if CV_SIMD128
+        v_float32x4 vlevel = v_setall_f32(level);
+        for (; x + 4 <= xEnd; x += 4) {
+            v_float32x4 c = v_load(row + x);
+            // most pixels are below the level, they cost one compare
+            v_float32x4 keep = c >= vlevel;
+            if (!v_check_any(keep)) {
+                continue;
+            }
+            // strictly above the neighbors before it, at least equal to the ones after it, so a plateau keeps one pixel
+            keep = keep & (c > v_load(up + x - 1)) & (c > v_load(up + x)) & (c > v_load(up + x + 1)) & (c > v_load(row + x - 1));
+            keep = keep & (c >= v_load(row + x + 1)) & (c >= v_load(down + x - 1)) & (c >= v_load(down + x)) & (c >= v_load(down + x + 1));
+            int mask = v_signmask(keep);
+            for (int k = 0; mask != 0; k++, mask >>= 1) {
+                if (mask & 1) {
+                    keypoints.push_back(KeyPoint((float)(x + k), (float)y, 8.0f, -1, row[x + k]));
+                }
+            }
+        }
+#endif
+        for (; x < xEnd; x++) {
+            float c = row[x];
+            if (c < level) {
+                continue;
+            }
+            if (c > up[x - 1] && c > up[x] && c > up[x + 1] && c > row[x - 1] &&
+                c >= row[x + 1] && c >= down[x - 1] && c >= down[x] && c >= down[x + 1]) {
+                keypoints.push_back(KeyPoint((float)x, (float)y, 8.0f, -1, c));
+            }
+        }
+    }
+}
+
+// The old scan kept every pixel with (int)normalize(response, 0, 255) > threshold. The same test is made on the raw
+// response against the equivalent level, so the response is never normalized.
+// Reference - https://docs.opencv.org/3.4/dc/d0d/tutorial_py_features_harris.html
+void harris::extractKeypoints(const cv::Mat &response, int threshold, std::vector<cv::KeyPoint> &keypoints) {
+    keypoints.clear();
+    if (response.rows < 3 || response.cols < 3) {
+        return;
+    }
+
+    double minVal, maxVal;
+    cv::minMaxLoc(response, &minVal, &maxVal);
+    if (maxVal <= minVal) {
+        return;
+    }
+    extractArea(response, responseLevel(minVal, maxVal, threshold), Rect(0, 0, response.cols, response.rows), keypoints);
+}
+
+void harris::drawKeypoints(cv::Mat &frame, const std::vector<cv::KeyPoint> &keypoints) {
+    for (int i = 0; i < keypoints.size(); i++) {
+        cv::circle(frame, Point((int)keypoints[i].pt.x, (int)keypoints[i].pt.y), 4, ORANGE, 2, 8, 0);
+    }
+}
+
+/* Helper method to detect and draw Harris corners in one call */
+void harris::detectAndDrawHarrisCorners(cv::Mat &frame) {
+    HarrisBuffers buffers;
+    std::vector<cv::KeyPoint> keypoints;
+    detectHarrisCorners(frame, keypoints, buffers);
+    drawKeypoints(frame, keypoints);
+}
+
+// how far a change of the gray image reaches into the response: the Sobel taps and the 2x2 box, rows y - 2..y + 1
+static const int RESPONSE_REACH = 2;
+
+harris::IncrementalHarris::IncrementalHarris(int tileSize, int diffThreshold)
+    : tileSize(std::max(tileSize, 8)), diffThreshold(diffThreshold), tilesX(0), tilesY(0), level(0), lastThreshold(-1) {}
+
+void harris::IncrementalHarris::reset() {
+    reference.release();
+    tilesX = tilesY = 0;
+}
+
+cv::Rect harris::IncrementalHarris::tileRect(int tile) const {
+    int x = (tile % tilesX) * tileSize, y = (tile / tilesX) * tileSize;
+    return Rect(x, y, std::min(tileSize, reference.cols - x), std::min(tileSize, reference.rows - y));
+}
+
+void harris::IncrementalHarris::extractTile(int tile, float level) {
+    tileKeypoints[tile].clear();
+    extractArea(buffers.response, level, tileRect(tile), tileKeypoints[tile]);
+}
+
+void harris::IncrementalHarris::update(const cv::Mat &frame, std::vector<cv::KeyPoint> &keypoints, int threshold) {
+    const cv::Mat *gray = &frame;
+    if (frame.channels() == 3) {
+        cv::cvtColor(frame, buffers.gray, COLOR_BGR2GRAY);
+        gray = &buffers.gray;
+    }
+    Rect image(0, 0, gray->cols, gray->rows);
+
+    dirtyTiles.clear();
+    if (reference.size() != gray->size() || tilesX == 0) {
+        // first frame or a new size: everything is computed once in full
+        gray->copyTo(reference);
+        tilesX = (gray->cols + tileSize - 1) / tileSize;
+        tilesY = (gray->rows + tileSize - 1) / tileSize;
+        tileMin.assign(tileCount(), 0);
+        tileMax.assign(tileCount(), 0);
+        tileKeypoints.assign(tileCount(), std::vector<cv::KeyPoint>());
+        cornerHarrisFused(reference, buffers.response);
+        for (int tile = 0; tile < tileCount(); tile++) {
+            dirtyTiles.push_back(tile);
+        }
+    } else {
+        cv::absdiff(*gray, reference, diff);
+        for (int tile = 0; tile < tileCount(); tile++) {
+            Rect reach = tileRect(tile);
+            reach = Rect(reach.x - RESPONSE_REACH, reach.y - RESPONSE_REACH, reach.width + 2 * RESPONSE_REACH, reach.height + 2 * RESPONSE_REACH) & image;
+            double maxDiff;
+            cv::minMaxLoc(diff(reach), NULL, &maxDiff);
+            if (maxDiff > diffThreshold) {
+                dirtyTiles.push_back(tile);
+            }
+        }
+
+        // each dirty tile is recomputed from a margin wide enough that its own pixels come out as in a full pass,
+        // and writes only its own pixels, so the tiles run in parallel
+        cv::parallel_for_(Range(0, (int)dirtyTiles.size()), [&](const Range &range) {
+            static thread_local cv::Mat patch;
+            for (int i = range.start; i < range.end; i++) {
+                Rect area = tileRect(dirtyTiles[i]);
+                int margin = 2 * RESPONSE_REACH;
+                Rect source = Rect(area.x - margin, area.y - margin, area.width + 2 * margin, area.height + 2 * margin) & image;
+                cornerHarrisFused((*gray)(source), patch);
+                cv::Mat response = buffers.response(area), referenceArea = reference(area);
+                patch(Rect(area.x - source.x, area.y - source.y, area.width, area.height)).copyTo(response);
+                (*gray)(area).copyTo(referenceArea);
+            }
+        });
+    }
+
+    for (int i = 0; i < dirtyTiles.size(); i++) {
+        double minVal, maxVal;
+        cv::minMaxLoc(buffers.response(tileRect(dirtyTiles[i])), &minVal, &maxVal);
+        tileMin[dirtyTiles[i]] = (float)minVal;
+        tileMax[dirtyTiles[i]] = (float)maxVal;
+    }
+    float minVal = *std::min_element(tileMin.begin(), tileMin.end());
+    float maxVal = *std::max_element(tileMax.begin(), tileMax.end());
+    float newLevel = maxVal > minVal ? responseLevel(minVal, maxVal, threshold) : FLT_MAX;
+
+    // a new level changes every tile, otherwise the dirty tiles and their neighbors, whose edge pixels compare
+    // against the recomputed ones
+    extractTiles.clear();
+    if (newLevel != level || threshold != lastThreshold) {
+        for (int tile = 0; tile < tileCount(); tile++) {
+            extractTiles.push_back(tile);
+        }
+    } else {
+        markedTiles.assign(tileCount(), 0);
+        for (int i = 0; i < dirtyTiles.size(); i++) {
+            int tx = dirtyTiles[i] % tilesX, ty = dirtyTiles[i] / tilesX;
+            for (int y = std::max(ty - 1, 0); y <= std::min(ty + 1, tilesY - 1); y++) {
+                for (int x = std::max(tx - 1, 0); x <= std::min(tx + 1, tilesX - 1); x++) {
+                    markedTiles[y * tilesX + x] = 1;
+                }
+            }
+        }
+        for (int tile = 0; tile < tileCount(); tile++) {
+            if (markedTiles[tile]) {
+                extractTiles.push_back(tile);
+            }
+        }
+    }
+    level = newLevel;
+    lastThreshold = threshold;
+
+    cv::parallel_for_(Range(0, (int)extractTiles.size()), [&](const Range &range) {
+        for (int i = range.start; i < range.end; i++) {
+            extractTile(extractTiles[i], newLevel);
+        }
+    });
+
+    keypoints.clear();
+    for (int tile = 0; tile < tileCount(); tile++) {
+        keypoints.insert(keypoints.end(), tileKeypoints[tile].begin(), tileKeypoints[tile].end());
+    }
+}
+
+bool harris::KeypointWriter::open(const char *path) {
+    close();
+    size_t length = strlen(path);
+    csv = strcmp(path, "-") == 0 || (length > 4 && strcmp(path + length - 4, ".csv") == 0);
+    file = strcmp(path, "-") == 0 ? stdout : fopen(path, csv ? "w" : "wb");
+    if (file == NULL) {
+        printf("%s cannot be opened for the keypoints\n", path);
+        return false;
+    }
+    if (file != stdout) {
+        setvbuf(file, NULL, _IOFBF, 1 << 20);
+    }
+
+    if (csv) {
+        fprintf(file, "file,x,y,response\n");
+    } else {
+        KeypointFileHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, KEYPOINT_MAGIC, sizeof(header.magic));
+        header.version = KEYPOINT_VERSION;
+        header.entrySize = sizeof(KeypointEntry);
+        fwrite(&header, sizeof(header), 1, file);
+    }
+    return true;
+}
+
+void harris::KeypointWriter::write(const std::string &image, cv::Size size, const std::vector<cv::KeyPoint> &keypoints) {
+    if (file == NULL) {
+        return;
+    }
+
+    if (csv) {
+        // the path is quoted, with its quotes doubled, in case it holds a comma
+        string quoted = "\"";
+        for (int i = 0; i < image.size(); i++) {
+            quoted += image[i] == '"' ? "\"\"" : string(1, image[i]);
+        }
+        quoted += "\"";
+        for (int i = 0; i < keypoints.size(); i++) {
+            fprintf(file, "%s,%.0f,%.0f,%g\n", quoted.c_str(), keypoints[i].pt.x, keypoints[i].pt.y, keypoints[i].response);
+        }
+        return;
+    }
+
+    ImageHeader header;
+    header.pathLength = (uint32_t)image.size();
+    header.width = size.width;
+    header.height = size.height;
+    header.keypointCount = (uint32_t)keypoints.size();
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(image.data(), 1, image.size(), file);
+    for (int i = 0; i < keypoints.size(); i++) {
+        KeypointEntry entry = {keypoints[i].pt.x, keypoints[i].pt.y, keypoints[i].response};
+        fwrite(&entry, sizeof(entry), 1, file);
+    }
+}
+
+void harris::KeypointWriter::close() {
+    if (file == NULL) {
+        return;
+    }
+    if (file == stdout) {
+        fflush(file);
+    } else {
+        fclose(file);
+    }
+    file = NULL;
+}
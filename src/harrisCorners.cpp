@@ -1,5 +1,7 @@
 #include <dirent.h>
 
+#include <algorithm>
+#include <cctype>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -7,102 +9,82 @@
 #include <opencv2/opencv.hpp>
 #include <vector>
 
+#include "framesource.hpp"
+#include "harris.hpp"
+#include "imagefiles.hpp"
+#include "pipeline.hpp"
+#include "sink.hpp"
+
 using namespace cv;
 using namespace std;
+using namespace harris;
 
-const cv::Scalar ORANGE = cv::Scalar(0, 140, 255);
-
-/* Helper method to call harrisCorners method in openCV to detect and draw key points */
-// Reference - https://docs.opencv.org/3.4/d4/d7d/tutorial_harris_detector.html
-void detectAndDrawHarrisCorners(cv::Mat &frame) {
-    // change to gray
-    cv::Mat gray;
-    cv::cvtColor(frame, gray, COLOR_BGR2GRAY);
-
-    // output
-    cv::Mat dst = Mat::zeros(frame.size(), CV_32FC1);  // 32-bit float
-
-    // blockSize	Neighborhood size (see the details on cornerEigenValsAndVecs ).
-    int blockSize = 2;
-    // ksize	    Aperture parameter for the Sobel operator.
-    int ksize = 3;
-    // k	        Harris detector free parameter.
-    double k = 0.04;
-
-    cv::cornerHarris(gray, dst, blockSize, ksize, k);
-
-    // threshold
-    // https://docs.opencv.org/3.4/dc/d0d/tutorial_py_features_harris.html
-    int threshold = 180;
-    int max_threshold = 255;
-
-    cv::Mat normed;
-    cv::normalize(dst, normed, 0, 255, NORM_MINMAX, CV_32FC1, Mat());
-
-    // draw the key points as circles
-    for (int i = 0; i < frame.rows; i++) {
-        for (int j = 0; j < frame.cols; j++) {
-            if ((int)normed.at<float>(i, j) > threshold) {
-                cv::circle(frame, Point(j, i), 4, ORANGE, 2, 8, 0);
-            }
-        }
+/* Helper method to draw the keypoints if asked to, and their count. */
+void showKeypoints(cv::Mat &image, const std::vector<cv::KeyPoint> &keypoints, bool draw) {
+    if (draw) {
+        harris::drawKeypoints(image, keypoints);
     }
+    cv::putText(image, "corners: " + to_string(keypoints.size()), Point(10, 50), FONT_HERSHEY_PLAIN, 1.2, Scalar(0, 255, 255), 1);
 }
 
-/* Entry function to detect and draw harris corners for video frames */
-int videoMode() {
-    cv::VideoCapture *capdev;
-
-    // open the video device
-    capdev = new cv::VideoCapture(0);
-    if (!capdev->isOpened()) {
-        printf("Unable to open video device\n");
+/*
+Entry function to detect and draw harris corners for video frames, maxFrames 0 runs until 'q'.
+diffThreshold >= 0 keeps a running response and recomputes only the tiles that changed by more than it.
+*/
+int videoMode(const char *sourceSpec, sink::FrameSink &output, long maxFrames, bool draw, int diffThreshold) {
+    // open the video device, or the source given
+    framesource::FrameSource *source = framesource::create(sourceSpec);
+    if (source == NULL) {
         return (-1);
     }
 
     // get some properties of the image
-    cv::Size refS((int)capdev->get(cv::CAP_PROP_FRAME_WIDTH),
-                  (int)capdev->get(cv::CAP_PROP_FRAME_HEIGHT));
+    cv::Size refS = source->frameSize();
     printf("Expected size: %d %d\n", refS.width, refS.height);
 
-    cv::namedWindow("Video", 1);  // identifies a window
-
-    cv::Mat frame;
-    // must pass capdev to frame, to get updated frame size for initiating other Mat as below
-    *capdev >> frame;
-
-    for (;;) {
-        *capdev >> frame;  // get a new frame from the camera, treat as a stream
-        if (frame.empty()) {
-            printf("frame is empty\n");
-            break;
-        }
-
-        char key = waitKey(10);
-        if (key == 'q') {
-            break;
-        }
+    // the Harris response is computed on a worker thread, the window and keys stay on this thread
+    long numShown = 0;
+    harris::HarrisBuffers buffers;
+    harris::IncrementalHarris incremental(64, std::max(diffThreshold, 0));
+    std::vector<cv::KeyPoint> keypoints;
+    pipeline::Pipeline<cv::Mat> stages(
+        *source,
+        [&](pipeline::Frame &frame, cv::Mat &concatFrames) {
+            if (diffThreshold >= 0) {
+                incremental.update(frame.image, keypoints);
+            } else {
+                harris::detectHarrisCorners(frame.image, keypoints, buffers);
+            }
 
-        cv::Mat frameCopy;
-        frameCopy = frame.clone();
-        detectAndDrawHarrisCorners(frameCopy);
+            cv::Mat frameCopy;
+            frameCopy = frame.image.clone();
+            showKeypoints(frameCopy, keypoints, draw);
+            if (diffThreshold >= 0) {
+                string tiles = "tiles: " + to_string(incremental.lastRecomputed()) + "/" + to_string(incremental.tileCount());
+                cv::putText(frameCopy, tiles, Point(10, 70), FONT_HERSHEY_PLAIN, 1.2, Scalar(0, 255, 255), 1);
+            }
 
-        cv::Mat concatFrames;
-        hconcat(frame, frameCopy, concatFrames);
+            hconcat(frame.image, frameCopy, concatFrames);
+        },
+        [&](pipeline::Frame &frame, cv::Mat &concatFrames) {
+            char key = output.pollKey(10);
+            if (key == 'q') {
+                return false;
+            }
 
-        imshow("Video", concatFrames);
-    }
+            pipeline::drawStats(concatFrames, stages.statsText());
+            output.write(concatFrames);
+            return maxFrames == 0 || ++numShown < maxFrames;
+        });
+    stages.run();
 
-    delete capdev;
+    delete source;
     return (0);
 }
 
 /* Entry function to detect and draw harris corners for an image */
-int imageMode(char *imageFile) {
-    if (strstr(imageFile, ".jpg") ||
-        strstr(imageFile, ".png") ||
-        strstr(imageFile, ".ppm") ||
-        strstr(imageFile, ".tif")) {
+int imageMode(char *imageFile, sink::FrameSink &output, bool draw) {
+    if (imagefiles::isImageFile(imageFile)) {
         cv::Mat image;
         image = imread(string(imageFile));
 
@@ -112,14 +94,19 @@ int imageMode(char *imageFile) {
             exit(-1);
         }
 
+        harris::HarrisBuffers buffers;
+        std::vector<cv::KeyPoint> keypoints;
+        harris::detectHarrisCorners(image, keypoints, buffers);
+        printf("%zu corners\n", keypoints.size());
+
         cv::Mat imageCopy;
         imageCopy = image.clone();
-        detectAndDrawHarrisCorners(imageCopy);
+        showKeypoints(imageCopy, keypoints, draw);
 
         cv::Mat concatImages;
         hconcat(image, imageCopy, concatImages);
 
-        imshow("Image", concatImages);
+        output.write(concatImages);
     } else {
         cout << "This new image" << imageFile << "cannot be loaded.\n";
     }
@@ -127,26 +114,139 @@ int imageMode(char *imageFile) {
     return 0;
 }
 
+/*
+Entry function to extract the keypoints of a directory, a list file or a single image into a keypoint file.
+Images are decoded and processed on OpenCV's thread pool in chunks of a few per thread, each worker reading its own
+file, and each chunk is written in order before the next starts, so memory stays bounded for any number of files.
+*/
+int batchMode(const char *source, const char *outPath) {
+    std::vector<string> files = imagefiles::collect(source);
+    if (files.empty()) {
+        fprintf(stderr, "No image found in %s\n", source);
+        return -1;
+    }
+
+    harris::KeypointWriter writer;
+    if (!writer.open(outPath)) {
+        return -1;
+    }
+
+    int chunk = 4 * cv::getNumThreads();
+    std::vector<std::vector<cv::KeyPoint> > results(chunk);
+    std::vector<cv::Size> sizes(chunk);
+    long failed = 0, numKeypoints = 0;
+    int64 start = cv::getTickCount();
+
+    for (int first = 0; first < files.size(); first += chunk) {
+        int count = std::min(chunk, (int)files.size() - first);
+        cv::parallel_for_(Range(0, count), [&](const Range &range) {
+            static thread_local harris::HarrisBuffers buffers;
+            for (int i = range.start; i < range.end; i++) {
+                // decoded as gray, the only form the detector needs
+                cv::Mat image = cv::imread(files[first + i], IMREAD_GRAYSCALE);
+                sizes[i] = image.size();
+                results[i].clear();
+                if (!image.empty()) {
+                    harris::detectHarrisCorners(image, results[i], buffers);
+                }
+            }
+        });
+
+        for (int i = 0; i < count; i++) {
+            if (sizes[i].empty()) {
+                fprintf(stderr, "%s cannot be loaded\n", files[first + i].c_str());
+                failed++;
+            }
+            numKeypoints += results[i].size();
+            writer.write(files[first + i], sizes[i], results[i]);
+        }
+    }
+    writer.close();
+
+    double seconds = (cv::getTickCount() - start) / cv::getTickFrequency();
+    fprintf(stderr, "%zu images, %ld failed, %ld corners in %.2f s (%.1f images/s, %d threads)\n",
+            files.size(), failed, numKeypoints, seconds, files.size() / seconds, cv::getNumThreads());
+    return 0;
+}
+
 /*
   Entry function to detect and draw harris corners
   Reference: harrisCorners With OpenCV
   https://docs.opencv.org/4.x/dd/d1a/group__imgproc__feature.html#gac1fc3598018010880e370e2f709b4345
+
+  Usage: harrisCorners [image] [--source <spec>] [--sink <spec>] [--frames <n>] [--no-draw] [--incremental [diff]]
+         harrisCorners --batch <directory, list file or image> [--out <file>]
+    --source <spec>       video mode input: camera index (default 0), video:<file>, images:<dir>,
+                          synthetic[:WxH[@fps]], ..., see framesource.hpp
+    --sink <spec>         window (default), null, video:<file>, images:<pattern> or shm:<name>, see sink.hpp
+    --frames <n>          stop the video mode after n frames
+    --no-draw             only count the corners, without drawing them
+    --incremental [diff]  video mode for a fixed camera: recompute only the tiles that changed by more than diff
+                          gray levels (default 8, 0 for any change)
+    --batch <path>        keypoints of every image of a directory, or of a file listing one path per line
+    --out <file>          where the batch keypoints go: a .csv file, - for CSV on stdout (default), or any other
+                          name for the binary format of harris.hpp
  */
 int main(int argc, char *argv[]) {
     char imageFile[256];
+    const char *sourceSpec = "0";
+    const char *sinkSpec = "window";
+    long maxFrames = 0;
+    bool draw = true;
+    int diffThreshold = -1;
+    const char *batchSource = NULL;
+    const char *outPath = "-";
+    std::vector<char *> args;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--source") == 0 && i + 1 < argc) {
+            sourceSpec = argv[++i];
+        } else if (strcmp(argv[i], "--sink") == 0 && i + 1 < argc) {
+            sinkSpec = argv[++i];
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            maxFrames = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--no-draw") == 0) {
+            draw = false;
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            batchSource = argv[++i];
+        } else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            outPath = argv[++i];
+        } else if (strcmp(argv[i], "--incremental") == 0) {
+            diffThreshold = 8;
+            if (i + 1 < argc && isdigit(argv[i + 1][0])) {
+                diffThreshold = atoi(argv[++i]);
+            }
+        } else {
+            args.push_back(argv[i]);
+        }
+    }
+
+    // no window and nothing else on stdout, which may be the CSV
+    if (batchSource != NULL) {
+        return batchMode(batchSource, outPath) == 0 ? 0 : -1;
+    }
+
+    sink::FrameSink *output = sink::create(sinkSpec, args.empty() ? "Video" : "Image");
+    if (output == NULL) {
+        printf("Unknown sink %s\n", sinkSpec);
+        exit(-1);
+    }
 
-    if (argc == 1) {
-        videoMode();
-    } else if (argc == 2) {
-        strcpy(imageFile, argv[1]);
-        imageMode(imageFile);
+    if (args.size() == 0) {
+        videoMode(sourceSpec, *output, maxFrames, draw, diffThreshold);
+    } else if (args.size() == 1) {
+        strncpy(imageFile, args[0], sizeof(imageFile) - 1);
+        imageFile[sizeof(imageFile) - 1] = 0;
+        imageMode(imageFile, *output, draw);
     } else {
         printf("Input arguments are not correct.\n");
         exit(-1);
     }
 
     // NOTE: must add waitKey, or the program will terminate, without showing the result images
-    waitKey(0);
+    // headless sinks have no keys and return at once
+    output->pollKey(0);
+    output->close();
+    delete output;
     printf("Terminating\n");
 
     return 0;
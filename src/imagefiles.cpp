@@ -0,0 +1,85 @@
+#include "imagefiles.hpp"
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+using namespace std;
+
+static const char *EXTENSIONS[] = {".jpg", ".jpeg", ".png", ".ppm", ".pgm", ".bmp", ".tif", ".tiff", ".webp"};
+
+bool imagefiles::isImageFile(const std::string &name) {
+    size_t dot = name.rfind('.');
+    if (dot == string::npos || name.find('/', dot) != string::npos) {
+        return false;
+    }
+    string extension = name.substr(dot);
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    for (int i = 0; i < sizeof(EXTENSIONS) / sizeof(EXTENSIONS[0]); i++) {
+        if (extension == EXTENSIONS[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<std::string> imagefiles::listDirectory(const char *dirPath) {
+    std::vector<std::string> files;
+
+    DIR *dirp = opendir(dirPath);
+    if (dirp == NULL) {
+        return files;
+    }
+
+    struct dirent *dp;
+    while ((dp = readdir(dirp)) != NULL) {
+        if (isImageFile(dp->d_name)) {
+            files.push_back(string(dirPath) + "/" + string(dp->d_name));
+        }
+    }
+    closedir(dirp);
+
+    // readdir gives no order guarantee, keep the order stable between runs
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+std::vector<std::string> imagefiles::readListFile(const char *listPath) {
+    std::vector<std::string> files;
+    std::ifstream list(listPath);
+    string base = listPath;
+    size_t slash = base.rfind('/');
+    base = slash == string::npos ? "" : base.substr(0, slash + 1);
+
+    string line;
+    while (std::getline(list, line)) {
+        // trailing spaces and the \r of lists written on Windows
+        while (!line.empty() && isspace((unsigned char)line[line.size() - 1])) {
+            line.erase(line.size() - 1);
+        }
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        files.push_back(line[0] == '/' ? line : base + line);
+    }
+    return files;
+}
+
+std::vector<std::string> imagefiles::collect(const char *path) {
+    struct stat info;
+    if (stat(path, &info) != 0) {
+        return std::vector<std::string>();
+    }
+    if (S_ISDIR(info.st_mode)) {
+        return listDirectory(path);
+    }
+    if (isImageFile(path)) {
+        return std::vector<std::string>(1, string(path));
+    }
+    return readListFile(path);
+}
@@ -0,0 +1,169 @@
+#include "overlay.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+using namespace cv;
+using namespace std;
+using namespace overlay;
+
+overlay::CompositeBuffers::CompositeBuffers() {
+    pts_src.reserve(4);
+    element = getStructuringElement(MORPH_RECT, Size(5, 5));
+}
+
+void overlay::compositeImage(const cv::Mat &imgSrc, const std::vector<cv::Point> &pts_dst, cv::Mat &frame, CompositeBuffers &buffers) {
+    // corner points of the new source image
+    vector<Point> &pts_src = buffers.pts_src;
+    pts_src.clear();
+    // top left
+    pts_src.push_back(Point(0, 0));
+    // top right
+    pts_src.push_back(Point(imgSrc.cols, 0));
+    // bottom right
+    pts_src.push_back(Point(imgSrc.cols, imgSrc.rows));
+    // bottom left
+    pts_src.push_back(Point(0, imgSrc.rows));
+
+    // calculate homography
+    // A Homography is a transformation ( a 3×3 matrix ) that maps the points in one image to the corresponding points in the other image.
+    // Reference - https://learnopencv.com/homography-examples-using-opencv-python-c/
+    cv::Mat homo = cv::findHomography(pts_src, pts_dst);
+
+    // Map the source image to the mapped image using the homography
+    cv::Mat &mappedImage = buffers.mappedImage;
+    warpPerspective(imgSrc, mappedImage, homo, frame.size(), INTER_CUBIC);
+
+    // Mask as the region to copy from the mapped image into the original frame
+    cv::Mat &mask = buffers.mask;
+    mask.create(frame.rows, frame.cols, CV_8UC1);
+    mask.setTo(0);
+    fillConvexPoly(mask, pts_dst, Scalar(255, 255, 255), LINE_AA);
+
+    // Erode the mask to not copy the boundary effects from the mapping process
+    erode(mask, mask, buffers.element);
+
+    // Map the new source image into the mask area
+    mappedImage.copyTo(frame, mask);
+}
+
+static const int BAND_ROWS = 32;
+// the inset of compositeImage's anti-aliased, 5x5-eroded mask along an axis-aligned edge, in pixels.
+// Fitted on random quads, the two masks differ in under 0.4% of their pixels, all on the border.
+static const double EDGE_INSET = 0.75;
+
+// One side of the quad: a * x + b * y + c is the distance to the edge line, positive inside
+struct Edge {
+    double a, b, c;
+    double inset;  // the distance a pixel center needs to survive the erosion
+};
+
+/* Helper method to find the pixels [x0, x1) of row y inside all four edges, within [xMin, xMax). */
+static bool rowSpan(const Edge *edges, int y, int xMin, int xMax, int &x0, int &x1) {
+    double lo = xMin, hi = xMax - 1;
+    for (int i = 0; i < 4; i++) {
+        const Edge &e = edges[i];
+        double rhs = e.inset - e.b * y - e.c;
+        if (e.a > 1e-9) {
+            lo = std::max(lo, std::ceil(rhs / e.a));
+        } else if (e.a < -1e-9) {
+            hi = std::min(hi, std::floor(rhs / e.a));
+        } else if (rhs > 0) {
+            return false;
+        }
+    }
+    if (lo > hi) {
+        return false;
+    }
+    x0 = (int)lo;
+    x1 = (int)hi + 1;
+    return true;
+}
+
+void overlay::compositeImageRoi(const cv::Mat &imgSrc, const std::vector<cv::Point> &pts_dst, cv::Mat &frame, CompositeBuffers &buffers, int interpolation) {
+    if (pts_dst.size() != 4 || imgSrc.empty() || imgSrc.type() != frame.type()) {
+        compositeImage(imgSrc, pts_dst, frame, buffers);
+        return;
+    }
+
+    // the winding of the quad decides which side of an edge is inside
+    double area = 0;
+    for (int i = 0; i < 4; i++) {
+        const Point &p = pts_dst[i], &q = pts_dst[(i + 1) % 4];
+        area += (double)p.x * q.y - (double)q.x * p.y;
+    }
+    if (std::abs(area) < 1) {
+        return;
+    }
+    double winding = area > 0 ? 1 : -1;
+
+    Edge edges[4];
+    for (int i = 0; i < 4; i++) {
+        const Point &p = pts_dst[i], &q = pts_dst[(i + 1) % 4];
+        double dx = q.x - p.x, dy = q.y - p.y;
+        double length = std::sqrt(dx * dx + dy * dy);
+        if (length == 0) {
+            compositeImage(imgSrc, pts_dst, frame, buffers);
+            return;
+        }
+        Edge &e = edges[i];
+        e.a = -dy * winding / length;
+        e.b = dx * winding / length;
+        e.c = (dy * p.x - dx * p.y) * winding / length;
+        // like the erosion square, the inset reaches furthest across a diagonal edge
+        e.inset = EDGE_INSET * (std::abs(e.a) + std::abs(e.b));
+    }
+
+    Rect roi = boundingRect(pts_dst) & Rect(0, 0, frame.cols, frame.rows);
+    if (roi.empty()) {
+        return;
+    }
+
+    // the same corners as compositeImage, four points give the homography exactly
+    Point2f src[4] = {Point2f(0, 0), Point2f((float)imgSrc.cols, 0), Point2f((float)imgSrc.cols, (float)imgSrc.rows), Point2f(0, (float)imgSrc.rows)};
+    Point2f dst[4];
+    for (int i = 0; i < 4; i++) {
+        dst[i] = Point2f((float)pts_dst[i].x, (float)pts_dst[i].y);
+    }
+    cv::Matx33d homo = cv::getPerspectiveTransform(src, dst);
+
+    size_t elemSize = frame.elemSize();
+    int bands = (roi.height + BAND_ROWS - 1) / BAND_ROWS;
+    cv::parallel_for_(Range(0, bands), [&](const Range &range) {
+        static thread_local cv::Mat warped;
+        int spanStart[BAND_ROWS], spanEnd[BAND_ROWS];
+        for (int band = range.start; band < range.end; band++) {
+            int y0 = roi.y + band * BAND_ROWS, y1 = std::min(y0 + BAND_ROWS, roi.y + roi.height);
+
+            // the columns any row of the band needs
+            int bx0 = roi.x + roi.width, bx1 = roi.x;
+            for (int y = y0; y < y1; y++) {
+                int &x0 = spanStart[y - y0], &x1 = spanEnd[y - y0];
+                if (!rowSpan(edges, y, roi.x, roi.x + roi.width, x0, x1)) {
+                    x0 = x1 = 0;
+                    continue;
+                }
+                bx0 = std::min(bx0, x0);
+                bx1 = std::max(bx1, x1);
+            }
+            if (bx0 >= bx1) {
+                continue;
+            }
+
+            // warp just those columns, with the homography moved to the band's origin
+            cv::Matx33d shift(1, 0, -bx0, 0, 1, -y0, 0, 0, 1);
+            cv::Matx33d bandHomo = shift * homo;
+            warpPerspective(imgSrc, warped, cv::Mat(bandHomo), Size(bx1 - bx0, y1 - y0), interpolation);
+
+            for (int y = y0; y < y1; y++) {
+                int x0 = spanStart[y - y0], x1 = spanEnd[y - y0];
+                if (x0 < x1) {
+                    memcpy(frame.ptr(y) + x0 * elemSize, warped.ptr(y - y0) + (x0 - bx0) * elemSize, (x1 - x0) * elemSize);
+                }
+            }
+        }
+    });
+}
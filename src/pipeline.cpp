@@ -0,0 +1,34 @@
+#include "pipeline.hpp"
+
+#include <opencv2/opencv.hpp>
+#include <string>
+
+using namespace cv;
+using namespace std;
+using namespace pipeline;
+
+pipeline::StageStats::StageStats() : windowStart(cv::getTickCount()), count(0), rate(0) {}
+
+// Count one item through the stage, and refresh the rate once a second has passed
+void pipeline::StageStats::tick() {
+    std::lock_guard<std::mutex> lock(m);
+    count++;
+
+    int64_t now = cv::getTickCount();
+    double elapsed = (now - windowStart) / cv::getTickFrequency();
+    if (elapsed >= 1.0) {
+        rate = count / elapsed;
+        count = 0;
+        windowStart = now;
+    }
+}
+
+double pipeline::StageStats::fps() const {
+    std::lock_guard<std::mutex> lock(m);
+    return rate;
+}
+
+// Draw a stats line at the bottom left of a frame
+void pipeline::drawStats(cv::Mat &frame, const std::string &text) {
+    cv::putText(frame, text, Point(10, frame.rows - 10), FONT_HERSHEY_PLAIN, 1.0, Scalar(0, 255, 255), 1, LINE_AA);
+}
@@ -0,0 +1,134 @@
+#include "pose.hpp"
+
+#include <math.h>
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+using namespace cv;
+using namespace std;
+using namespace pose;
+
+// a warm start is only tried when the last pose is at most this many frames old
+static const long MAX_WARM_GAP = 5;
+// a warm start that converges above this error is treated as a wrong prediction and solved again cold
+static const double MAX_WARM_ERROR_PX = 2.0;
+// a rotation residual above this many radians means the rotation vector flipped, the filter restarts from the measurement
+static const double MAX_ROTATION_JUMP = 0.5;
+// the refinement stops once a step changes the pose by less than this, a tighter bound only adds iterations
+static const double REFINE_EPS = 1e-6;
+
+double pose::reprojectionError(const std::vector<cv::Point3f> &point_set, const std::vector<cv::Point2f> &corner_set,
+                               const cv::Mat &cameraMatrix, const cv::Mat &distCoeffs, const cv::Mat &rvec, const cv::Mat &tvec,
+                               std::vector<cv::Point2f> &projected) {
+    cv::projectPoints(point_set, rvec, tvec, cameraMatrix, distCoeffs, projected);
+    double sum = 0;
+    for (int i = 0; i < corner_set.size(); i++) {
+        Point2f d = projected[i] - corner_set[i];
+        sum += d.x * d.x + d.y * d.y;
+    }
+    return sqrt(sum / corner_set.size());
+}
+
+pose::PoseTracker::PoseTracker(double alpha, double beta, int maxIterations) : alpha(alpha), beta(beta), maxIterations(maxIterations), hasState(false), lastIndex(0) {
+    rvecMeasured = Mat::zeros(3, 1, CV_64F);
+    tvecMeasured = Mat::zeros(3, 1, CV_64F);
+    for (int i = 0; i < 6; i++) {
+        state[i] = 0;
+        velocity[i] = 0;
+    }
+}
+
+void pose::PoseTracker::reset() {
+    hasState = false;
+}
+
+// One Levenberg-Marquardt refinement of the measured pose, of at most maxIterations iterations.
+// The pose is put back to the seed when the refinement does not lower the reprojection error.
+void pose::PoseTracker::refine(const std::vector<cv::Point3f> &point_set, const std::vector<cv::Point2f> &corner_set,
+                               const cv::Mat &cameraMatrix, const cv::Mat &distCoeffs, double &error) {
+    rvecMeasured.copyTo(rvecSeed);
+    tvecMeasured.copyTo(tvecSeed);
+    double seedError = reprojectionError(point_set, corner_set, cameraMatrix, distCoeffs, rvecMeasured, tvecMeasured, projected);
+
+    cv::solvePnPRefineLM(point_set, corner_set, cameraMatrix, distCoeffs, rvecMeasured, tvecMeasured,
+                         TermCriteria(TermCriteria::COUNT + TermCriteria::EPS, maxIterations, REFINE_EPS));
+    error = reprojectionError(point_set, corner_set, cameraMatrix, distCoeffs, rvecMeasured, tvecMeasured, projected);
+    if (!(error < seedError)) {
+        rvecSeed.copyTo(rvecMeasured);
+        tvecSeed.copyTo(tvecMeasured);
+        error = seedError;
+    }
+}
+
+// Alpha-beta filter with a constant-velocity model, the time step is the number of frames since the last solve
+void pose::PoseTracker::filter(long frameIndex) {
+    double measured[6];
+    for (int i = 0; i < 3; i++) {
+        measured[i] = rvecMeasured.at<double>(i);
+        measured[3 + i] = tvecMeasured.at<double>(i);
+    }
+
+    double residual[6];
+    double rotationJump = 0;
+    double dt = std::max(frameIndex - lastIndex, 1L);
+    for (int i = 0; i < 6; i++) {
+        residual[i] = measured[i] - (state[i] + velocity[i] * dt);
+        if (i < 3) {
+            rotationJump += residual[i] * residual[i];
+        }
+    }
+
+    if (!hasState || sqrt(rotationJump) > MAX_ROTATION_JUMP) {
+        for (int i = 0; i < 6; i++) {
+            state[i] = measured[i];
+            velocity[i] = 0;
+        }
+    } else {
+        for (int i = 0; i < 6; i++) {
+            state[i] += velocity[i] * dt + alpha * residual[i];
+            velocity[i] += beta * residual[i] / dt;
+        }
+    }
+    hasState = true;
+    lastIndex = frameIndex;
+}
+
+bool pose::PoseTracker::estimate(const std::vector<cv::Point3f> &point_set, const std::vector<cv::Point2f> &corner_set,
+                                 const cv::Mat &cameraMatrix, const cv::Mat &distCoeffs, long frameIndex, cv::Mat &rvec, cv::Mat &tvec) {
+    int64 start = cv::getTickCount();
+    stats.warmStart = hasState && frameIndex - lastIndex <= MAX_WARM_GAP;
+    stats.refinements = 0;
+
+    if (stats.warmStart) {
+        // seed with the pose predicted for this frame
+        double dt = std::max(frameIndex - lastIndex, 1L);
+        for (int i = 0; i < 3; i++) {
+            rvecMeasured.at<double>(i) = state[i] + velocity[i] * dt;
+            tvecMeasured.at<double>(i) = state[3 + i] + velocity[3 + i] * dt;
+        }
+        refine(point_set, corner_set, cameraMatrix, distCoeffs, stats.errorPx);
+        stats.refinements = 1;
+    }
+
+    if (!stats.warmStart || stats.errorPx > MAX_WARM_ERROR_PX) {
+        // the board is planar, IPPE gives a closed-form starting pose
+        stats.warmStart = false;
+        if (!cv::solvePnP(point_set, corner_set, cameraMatrix, distCoeffs, rvecMeasured, tvecMeasured, false, SOLVEPNP_IPPE)) {
+            stats.solveMs = (cv::getTickCount() - start) * 1000.0 / cv::getTickFrequency();
+            reset();
+            return false;
+        }
+        refine(point_set, corner_set, cameraMatrix, distCoeffs, stats.errorPx);
+        stats.refinements++;
+    }
+
+    filter(frameIndex);
+    for (int i = 0; i < 3; i++) {
+        rvec.at<double>(i) = state[i];
+        tvec.at<double>(i) = state[3 + i];
+    }
+
+    stats.solveMs = (cv::getTickCount() - start) * 1000.0 / cv::getTickFrequency();
+    return true;
+}
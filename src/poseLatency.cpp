@@ -0,0 +1,177 @@
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+#include "posepub.hpp"
+#include "telemetry.hpp"
+
+using namespace cv;
+using namespace std;
+
+// poses per message, like a board of markers
+static const int NUM_POSES = 16;
+static const char *NAME = "/ar_pose_latency";
+// what the reader computes from the poses, kept so the reads are not optimized away
+static volatile double consumed;
+
+/* Helper method to get a percentile of sorted timings. */
+double percentile(std::vector<double> &sorted, double p) {
+    int index = (int)ceil(p * sorted.size()) - 1;
+    return sorted[std::min(std::max(index, 0), (int)sorted.size() - 1)];
+}
+
+/* Helper method to wait until a steady clock time, spinning since sleeps are coarser than the intervals measured. */
+void waitUntil(int64_t ns) {
+    while (telemetry::nowNs() < ns) {
+    }
+}
+
+/*
+Reader process: busy-polls the ring and measures the time from the publisher's commit to the reader seeing the message.
+Stops at the message with frame index -1.
+*/
+int readMessages(const char *imageText, long numMessages) {
+    posepub::Subscriber subscriber;
+    if (!subscriber.open(NAME)) {
+        fprintf(stderr, "shared memory %s cannot be opened\n", NAME);
+        return -1;
+    }
+
+    std::vector<double> latencies;
+    latencies.reserve(numMessages);
+    uint64_t lastCount = subscriber.writeCount();
+    int64_t lastFrame = 0;
+    long missed = 0, torn = 0;
+    while (true) {
+        uint64_t count = subscriber.writeCount();
+        if (count == lastCount) {
+            continue;
+        }
+        int64_t seen = telemetry::nowNs();
+
+        const posepub::MessageHeader *message = subscriber.latest();
+        if (message == NULL) {
+            continue;
+        }
+        int64_t frameIndex = message->frameIndex;
+        int64_t timestamp = message->timestampNs;
+        // touch what a consumer would use, in place
+        double sum = 0;
+        const posepub::PoseEntry *poses = posepub::poses(message);
+        for (int i = 0; i < message->poseCount; i++) {
+            sum += poses[i].tvec[2];
+        }
+        if (!subscriber.stillValid()) {
+            // read again, even if the writer does not commit another message
+            torn++;
+            continue;
+        }
+        consumed = sum;
+        lastCount = count;
+
+        if (frameIndex < 0) {
+            break;
+        }
+        missed += frameIndex - lastFrame - 1;
+        lastFrame = frameIndex;
+        latencies.push_back((seen - timestamp) / 1e3);
+    }
+
+    if (latencies.empty()) {
+        fprintf(stderr, "no message received\n");
+        return -1;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    printf("{\"kernel\":\"posepub.read\",\"image\":\"%s\",\"messages\":%ld,\"received\":%zu,\"missed\":%ld,\"torn\":%ld,\"p50_us\":%.2f,\"p99_us\":%.2f,\"max_us\":%.2f}\n",
+           imageText, numMessages, latencies.size(), missed, torn,
+           percentile(latencies, 0.5), percentile(latencies, 0.99), latencies.back());
+    return 0;
+}
+
+/*
+  Latency of the shared memory pose publisher between two processes.
+  The writer publishes messages of 16 marker poses, and an annotated frame of the given size, at a fixed rate;
+  a forked reader busy-polls for them. Prints one JSON line for each side, like bench.
+
+  Usage: poseLatency [messages] [image size, e.g. 640x480, 0 for none] [rate in Hz]
+ */
+int main(int argc, char *argv[]) {
+    long numMessages = argc >= 2 ? atol(argv[1]) : 10000;
+    const char *imageText = argc >= 3 ? argv[2] : "640x480";
+    double rate = argc >= 4 ? atof(argv[3]) : 1000;
+
+    int width = 0, height = 0;
+    // a zero message count leaves no timings to report, a zero rate no interval between them
+    if (numMessages <= 0 || !(rate > 0) ||
+        (strcmp(imageText, "0") != 0 && sscanf(imageText, "%dx%d", &width, &height) != 2)) {
+        printf("Usage: poseLatency [messages] [image size, e.g. 640x480, 0 for none] [rate in Hz]\n");
+        exit(-1);
+    }
+    cv::Mat image;
+    if (width > 0 && height > 0) {
+        image.create(height, width, CV_8UC3);
+        cv::randu(image, Scalar::all(0), Scalar::all(255));
+    }
+
+    std::vector<cv::Point2f> corners(4);
+    for (int i = 0; i < 4; i++) {
+        corners[i] = Point2f(10.0f * i, 20.0f * i);
+    }
+    cv::Vec3d rvec(0.1, 0.2, 0.3), tvec(0.0, 0.0, 0.5);
+
+    // the ring exists before the reader starts
+    posepub::Publisher publisher(NAME, NUM_POSES, NUM_POSES * 4);
+    if (!publisher.begin(0, posepub::SOURCE_ARUCO, image)) {
+        exit(-1);
+    }
+    publisher.end();
+
+    fflush(stdout);
+    pid_t reader = fork();
+    if (reader < 0) {
+        printf("fork failed\n");
+        exit(-1);
+    }
+    if (reader == 0) {
+        exit(readMessages(imageText, numMessages));
+    }
+
+    // let the reader attach before the first timed message
+    usleep(200000);
+
+    std::vector<double> publishUs;
+    publishUs.reserve(numMessages);
+    int64_t interval = (int64_t)(1e9 / rate);
+    int64_t next = telemetry::nowNs();
+    for (long i = 1; i <= numMessages + 1; i++) {
+        next += interval;
+        waitUntil(next);
+
+        bool last = i > numMessages;
+        int64_t start = telemetry::nowNs();
+        publisher.begin(last ? -1 : i, posepub::SOURCE_ARUCO, image);
+        for (int p = 0; p < NUM_POSES; p++) {
+            publisher.addPose(p, rvec, tvec, corners);
+        }
+        publisher.end();
+        if (!last) {
+            publishUs.push_back((telemetry::nowNs() - start) / 1e3);
+        }
+    }
+
+    int status = 0;
+    waitpid(reader, &status, 0);
+    publisher.close();
+
+    std::sort(publishUs.begin(), publishUs.end());
+    printf("{\"kernel\":\"posepub.publish\",\"image\":\"%s\",\"messages\":%ld,\"p50_us\":%.2f,\"p99_us\":%.2f,\"max_us\":%.2f}\n",
+           imageText, numMessages, percentile(publishUs, 0.5), percentile(publishUs, 0.99), publishUs.back());
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
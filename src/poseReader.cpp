@@ -0,0 +1,96 @@
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <opencv2/highgui.hpp>
+#include <opencv2/opencv.hpp>
+
+#include "posepub.hpp"
+#include "telemetry.hpp"
+
+using namespace cv;
+using namespace std;
+
+// a writer that committed nothing for this long may have recreated its ring under a new size
+static const int64_t REOPEN_AFTER_NS = 2000000000LL;
+
+/*
+  Example consumer of the poses published by AR --publish or arucoProjector --publish.
+  Prints every new message with its latency from the publisher, and with --show displays the published frame.
+
+  Usage: poseReader <shared memory name, e.g. /ar_poses> [--show]
+ */
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        printf("Usage: poseReader <shared memory name> [--show]\n");
+        exit(-1);
+    }
+    const char *name = argv[1];
+    bool show = argc >= 3 && strcmp(argv[2], "--show") == 0;
+
+    posepub::Subscriber subscriber;
+    uint64_t lastCount = 0;
+    int64_t lastChangeNs = telemetry::nowNs();
+    long torn = 0;
+    cv::Mat shown;
+    while (true) {
+        if (!subscriber.isOpen() || telemetry::nowNs() - lastChangeNs > REOPEN_AFTER_NS) {
+            if (!subscriber.open(name)) {
+                usleep(100000);
+                continue;
+            }
+            lastCount = 0;
+            lastChangeNs = telemetry::nowNs();
+        }
+
+        uint64_t count = subscriber.writeCount();
+        if (count == lastCount) {
+            usleep(500);
+            continue;
+        }
+        lastCount = count;
+        lastChangeNs = telemetry::nowNs();
+
+        const posepub::MessageHeader *message = subscriber.latest();
+        if (message == NULL) {
+            continue;
+        }
+
+        // everything is read in place, the copies below are only what this example prints and shows
+        int64_t frameIndex = message->frameIndex;
+        double latencyUs = (lastChangeNs - message->timestampNs) / 1e3;
+        int poseCount = message->poseCount;
+        posepub::PoseEntry first;
+        if (poseCount > 0) {
+            first = posepub::poses(message)[0];
+        }
+        if (show) {
+            posepub::image(message).copyTo(shown);
+        }
+        if (!subscriber.stillValid()) {
+            torn++;
+            continue;
+        }
+
+        printf("frame %lld: %d poses, latency %.1f us", (long long)frameIndex, poseCount, latencyUs);
+        if (poseCount > 0) {
+            printf(" | id %d rvec [%lf %lf %lf] tvec [%lf %lf %lf]", first.id,
+                   first.rvec[0], first.rvec[1], first.rvec[2], first.tvec[0], first.tvec[1], first.tvec[2]);
+        }
+        printf("\n");
+
+        if (show && !shown.empty()) {
+            cv::imshow(name, shown);
+            char key = (char)cv::waitKey(1);
+            if (key == 'q' || key == 27) {
+                break;
+            }
+        }
+    }
+
+    if (torn > 0) {
+        printf("%ld messages overwritten while being read\n", torn);
+    }
+    return 0;
+}
@@ -0,0 +1,132 @@
+#include "posepub.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <opencv2/core.hpp>
+
+#include "telemetry.hpp"
+
+using namespace cv;
+using namespace std;
+using namespace posepub;
+
+posepub::Publisher::Publisher(const std::string &name, int maxPoses, int maxCorners, uint32_t slotCount)
+    : name(name), maxPoses(maxPoses), maxCorners(maxCorners), slotCount(slotCount), message(NULL) {}
+
+bool posepub::Publisher::begin(int64_t frameIndex, int32_t source, const cv::Mat &image) {
+    size_t rowBytes = image.cols * image.elemSize();
+    size_t cornersOffset = sizeof(MessageHeader) + maxPoses * sizeof(PoseEntry);
+    size_t imageOffset = cornersOffset + maxCorners * sizeof(Point2f);
+    size_t size = imageOffset + image.rows * rowBytes;
+    if (!ring.isOpen() || ring.slotSize() != size) {
+        if (!ring.create(name.c_str(), slotCount, size)) {
+            printf("shared memory %s cannot be created\n", name.c_str());
+            message = NULL;
+            return false;
+        }
+    }
+
+    uint8_t *payload = ring.beginWrite();
+    message = (MessageHeader *)payload;
+    memset(message, 0, sizeof(MessageHeader));
+    message->frameIndex = frameIndex;
+    message->source = source;
+    message->posesOffset = sizeof(MessageHeader);
+    message->cornersOffset = cornersOffset;
+    message->imageOffset = imageOffset;
+    if (!image.empty()) {
+        message->imageWidth = image.cols;
+        message->imageHeight = image.rows;
+        message->imageType = image.type();
+        // row by row, the frame may be a padded ROI
+        for (int r = 0; r < image.rows; r++) {
+            memcpy(payload + imageOffset + r * rowBytes, image.ptr(r), rowBytes);
+        }
+    }
+    return true;
+}
+
+bool posepub::Publisher::addPose(int id, const cv::Vec3d &rvec, const cv::Vec3d &tvec, const std::vector<cv::Point2f> &corners) {
+    if (message == NULL || message->poseCount == maxPoses || message->cornerCount + (int)corners.size() > maxCorners) {
+        return false;
+    }
+
+    uint8_t *payload = (uint8_t *)message;
+    PoseEntry &entry = ((PoseEntry *)(payload + message->posesOffset))[message->poseCount++];
+    entry.id = id;
+    entry.firstCorner = message->cornerCount;
+    entry.cornerCount = corners.size();
+    entry.reserved = 0;
+    for (int i = 0; i < 3; i++) {
+        entry.rvec[i] = rvec[i];
+        entry.tvec[i] = tvec[i];
+    }
+    if (!corners.empty()) {
+        memcpy(payload + message->cornersOffset + message->cornerCount * sizeof(Point2f), corners.data(), corners.size() * sizeof(Point2f));
+    }
+    message->cornerCount += corners.size();
+    return true;
+}
+
+void posepub::Publisher::end() {
+    if (message == NULL) {
+        return;
+    }
+    message->timestampNs = telemetry::nowNs();
+    ring.endWrite(ring.slotSize());
+    message = NULL;
+}
+
+void posepub::Publisher::close() {
+    ring.close();
+    message = NULL;
+}
+
+bool posepub::Subscriber::open(const char *name) {
+    current = 0;
+    return ring.open(name);
+}
+
+void posepub::Subscriber::close() {
+    ring.close();
+}
+
+const MessageHeader *posepub::Subscriber::latest() {
+    size_t size;
+    uint64_t index;
+    const uint8_t *payload = ring.peekLatest(size, index);
+    if (payload == NULL || size < sizeof(MessageHeader)) {
+        return NULL;
+    }
+
+    // the layout is fixed for the life of the ring, but check it against the slot before anything points into it
+    const MessageHeader *message = (const MessageHeader *)payload;
+    size_t imageBytes = (size_t)message->imageWidth * message->imageHeight * CV_ELEM_SIZE(message->imageType);
+    if (message->poseCount < 0 || message->cornerCount < 0 ||
+        message->posesOffset + message->poseCount * sizeof(PoseEntry) > message->cornersOffset ||
+        message->cornersOffset + message->cornerCount * sizeof(Point2f) > message->imageOffset ||
+        message->imageOffset + imageBytes > size) {
+        return NULL;
+    }
+    current = index;
+    return message;
+}
+
+bool posepub::Subscriber::stillValid() const {
+    return ring.validate(current);
+}
+
+const PoseEntry *posepub::poses(const MessageHeader *message) {
+    return (const PoseEntry *)((const uint8_t *)message + message->posesOffset);
+}
+
+const cv::Point2f *posepub::corners(const MessageHeader *message) {
+    return (const Point2f *)((const uint8_t *)message + message->cornersOffset);
+}
+
+cv::Mat posepub::image(const MessageHeader *message) {
+    if (message->imageWidth == 0) {
+        return cv::Mat();
+    }
+    return cv::Mat(message->imageHeight, message->imageWidth, message->imageType, (void *)((const uint8_t *)message + message->imageOffset));
+}
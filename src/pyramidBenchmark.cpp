@@ -0,0 +1,104 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+
+#include "calibration.hpp"
+
+using namespace cv;
+using namespace std;
+
+/* Helper method to time one corner detection call in milliseconds. */
+double timeDetection(cv::Mat &image, cv::Size &boardSize, double downscale, std::vector<cv::Point2f> &corner_set) {
+    int64 start = cv::getTickCount();
+    corner_set = calibration::detectCornersPyramid(image, boardSize, downscale, false);
+    return (cv::getTickCount() - start) * 1000.0 / cv::getTickFrequency();
+}
+
+/* Helper method to get the median of a list of timings. */
+double median(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+/*
+  Compare the coarse-to-fine pyramid detection against the full resolution path of calibration::detectCorners.
+  Every input image is resized to 720p, 1080p and 4K. The full resolution corners are the reference for the accuracy columns.
+  The output is CSV on stdout.
+
+  Usage: pyramidBenchmark [iterations] [image ...]
+ */
+int main(int argc, char *argv[]) {
+    int iterations = argc >= 2 ? atoi(argv[1]) : 10;
+    if (iterations < 1) {
+        fprintf(stderr, "Usage: pyramidBenchmark [iterations] [image ...]\niterations must be a positive number\n");
+        return 1;
+    }
+
+    std::vector<string> files;
+    for (int i = 2; i < argc; i++) {
+        files.push_back(argv[i]);
+    }
+    if (files.empty()) {
+        // saved AR frames, all with the chessboard in view
+        files.push_back("../data/ar/image_1.jpg");
+        files.push_back("../data/ar/image_2.jpg");
+        files.push_back("../data/ar/image_3.jpg");
+    }
+
+    Size boardSize(8, 6);
+    Size resolutions[] = {Size(1280, 720), Size(1920, 1080), Size(3840, 2160)};
+    double factors[] = {1.0, 2.0, 3.0, 4.0};
+
+    printf("image,resolution,downscale,found,median_ms,mean_error_px,max_error_px\n");
+
+    for (int f = 0; f < files.size(); f++) {
+        cv::Mat original = cv::imread(files[f]);
+        if (original.empty()) {
+            fprintf(stderr, "%s cannot be loaded, skipped\n", files[f].c_str());
+            continue;
+        }
+
+        for (int r = 0; r < 3; r++) {
+            cv::Mat image;
+            cv::resize(original, image, resolutions[r], 0, 0, INTER_CUBIC);
+
+            std::vector<cv::Point2f> reference;
+            for (int k = 0; k < 4; k++) {
+                double downscale = factors[k];
+
+                std::vector<double> timings;
+                std::vector<cv::Point2f> corner_set;
+                for (int it = 0; it < iterations; it++) {
+                    timings.push_back(timeDetection(image, boardSize, downscale, corner_set));
+                }
+
+                bool found = corner_set.size() == (size_t)boardSize.area();
+                if (k == 0) {
+                    reference = found ? corner_set : std::vector<cv::Point2f>();
+                }
+
+                // deviation from the full resolution corners, -1 when either path missed the board
+                double meanError = -1;
+                double maxError = -1;
+                if (found && reference.size() == corner_set.size()) {
+                    meanError = 0;
+                    maxError = 0;
+                    for (int i = 0; i < corner_set.size(); i++) {
+                        double d = cv::norm(corner_set[i] - reference[i]);
+                        meanError += d;
+                        maxError = std::max(maxError, d);
+                    }
+                    meanError /= corner_set.size();
+                }
+
+                printf("%s,%dx%d,%.1f,%d,%.2f,%.4f,%.4f\n", files[f].c_str(), image.cols, image.rows, downscale, found ? 1 : 0, median(timings), meanError, maxError);
+            }
+        }
+    }
+
+    return 0;
+}
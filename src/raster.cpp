@@ -0,0 +1,276 @@
+#include "raster.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <opencv2/core/hal/intrin.hpp>
+#include <opencv2/opencv.hpp>
+
+using namespace cv;
+using namespace std;
+using namespace raster;
+
+// triangles with less than this doubled area in square pixels cover no pixel center worth drawing
+static const float MIN_AREA = 1e-4f;
+
+raster::Rasterizer::Rasterizer(int tileSize) : tileSize(std::max(tileSize, 8)), tilesX(0), tilesY(0) {}
+
+/* Helper method to set up one triangle without intrinsics, for the triangles left over from the groups of four. */
+static float setupScalar(const Vertex *v, float edge[3][3], float plane[4][3]) {
+    for (int i = 0; i < 3; i++) {
+        const Vertex &a = v[(i + 1) % 3];
+        const Vertex &b = v[(i + 2) % 3];
+        edge[i][0] = a.y - b.y;
+        edge[i][1] = b.x - a.x;
+        edge[i][2] = a.x * b.y - b.x * a.y;
+    }
+    float area = edge[0][2] + edge[1][2] + edge[2][2];
+    if (area < 0) {
+        for (int i = 0; i < 3; i++) {
+            for (int k = 0; k < 3; k++) {
+                edge[i][k] = -edge[i][k];
+            }
+        }
+        area = -area;
+    }
+
+    float inv = 1.0f / area;
+    for (int j = 0; j < 4; j++) {
+        float value[3];
+        for (int i = 0; i < 3; i++) {
+            value[i] = j == 0 ? 1.0f / v[i].z : j == 1 ? v[i].b : j == 2 ? v[i].g : v[i].r;
+        }
+        for (int k = 0; k < 3; k++) {
+            plane[j][k] = (edge[0][k] * value[0] + edge[1][k] * value[1] + edge[2][k] * value[2]) * inv;
+        }
+    }
+    return area;
+}
+
+/* Helper method to clip the bounding box of a set-up triangle to the frame, returns false if nothing is left to draw. */
+static bool boundTriangle(const Vertex *v, float area, float nearZ, Size frameSize, int &minX, int &minY, int &maxX, int &maxY) {
+    if (!(area > MIN_AREA) || v[0].z < nearZ || v[1].z < nearZ || v[2].z < nearZ) {
+        return false;
+    }
+    // clamped as floats first, a vertex close to the camera can project far outside the int range
+    float left = floor(std::min(v[0].x, std::min(v[1].x, v[2].x)));
+    float top = floor(std::min(v[0].y, std::min(v[1].y, v[2].y)));
+    float right = ceil(std::max(v[0].x, std::max(v[1].x, v[2].x)));
+    float bottom = ceil(std::max(v[0].y, std::max(v[1].y, v[2].y)));
+    if (right < 0 || bottom < 0 || left >= frameSize.width || top >= frameSize.height) {
+        return false;
+    }
+    minX = (int)std::max(left, 0.0f);
+    minY = (int)std::max(top, 0.0f);
+    maxX = (int)std::min(right, (float)(frameSize.width - 1));
+    maxY = (int)std::min(bottom, (float)(frameSize.height - 1));
+    return minX <= maxX && minY <= maxY;
+}
+
+void raster::Rasterizer::setupTriangles(const std::vector<Vertex> &vertices, cv::Size frameSize, float nearZ) {
+    setups.clear();
+    int numTriangles = (int)vertices.size() / 3;
+    Setup s;
+    int t = 0;
+
+#if CV_SIMD128
+    // four triangles per step, one per lane
+    for (; t + 4 <= numTriangles; t += 4) {
+        float x[3][4], y[3][4], value[3][4][4];
+        for (int k = 0; k < 4; k++) {
+            for (int i = 0; i < 3; i++) {
+                const Vertex &v = vertices[3 * (t + k) + i];
+                x[i][k] = v.x;
+                y[i][k] = v.y;
+                value[i][0][k] = v.z > 0 ? 1.0f / v.z : 0;
+                value[i][1][k] = v.b;
+                value[i][2][k] = v.g;
+                value[i][3][k] = v.r;
+            }
+        }
+
+        v_float32x4 X[3], Y[3], A[3], B[3], C[3];
+        for (int i = 0; i < 3; i++) {
+            X[i] = v_load(x[i]);
+            Y[i] = v_load(y[i]);
+        }
+        for (int i = 0; i < 3; i++) {
+            int a = (i + 1) % 3, b = (i + 2) % 3;
+            A[i] = Y[a] - Y[b];
+            B[i] = X[b] - X[a];
+            C[i] = X[a] * Y[b] - X[b] * Y[a];
+        }
+
+        // clockwise triangles are flipped, so inside is where all three edge functions are >= 0
+        v_float32x4 area = C[0] + C[1] + C[2];
+        v_float32x4 sign = v_select(area < v_setzero_f32(), v_setall_f32(-1.0f), v_setall_f32(1.0f));
+        area = area * sign;
+        v_float32x4 inv = v_setall_f32(1.0f) / area;
+        float edges[3][3][4], planes[4][3][4], areas[4];
+        for (int i = 0; i < 3; i++) {
+            A[i] = A[i] * sign;
+            B[i] = B[i] * sign;
+            C[i] = C[i] * sign;
+            v_store(edges[i][0], A[i]);
+            v_store(edges[i][1], B[i]);
+            v_store(edges[i][2], C[i]);
+        }
+        v_store(areas, area);
+        for (int j = 0; j < 4; j++) {
+            v_float32x4 V0 = v_load(value[0][j]), V1 = v_load(value[1][j]), V2 = v_load(value[2][j]);
+            v_store(planes[j][0], (A[0] * V0 + A[1] * V1 + A[2] * V2) * inv);
+            v_store(planes[j][1], (B[0] * V0 + B[1] * V1 + B[2] * V2) * inv);
+            v_store(planes[j][2], (C[0] * V0 + C[1] * V1 + C[2] * V2) * inv);
+        }
+
+        for (int k = 0; k < 4; k++) {
+            if (!boundTriangle(&vertices[3 * (t + k)], areas[k], nearZ, frameSize, s.minX, s.minY, s.maxX, s.maxY)) {
+                continue;
+            }
+            for (int i = 0; i < 3; i++) {
+                for (int c = 0; c < 3; c++) {
+                    s.edge[i][c] = edges[i][c][k];
+                }
+            }
+            for (int j = 0; j < 4; j++) {
+                for (int c = 0; c < 3; c++) {
+                    s.plane[j][c] = planes[j][c][k];
+                }
+            }
+            setups.push_back(s);
+        }
+    }
+#endif
+
+    for (; t < numTriangles; t++) {
+        const Vertex *v = &vertices[3 * t];
+        if (v[0].z < nearZ || v[1].z < nearZ || v[2].z < nearZ) {
+            continue;
+        }
+        float area = setupScalar(v, s.edge, s.plane);
+        if (boundTriangle(v, area, nearZ, frameSize, s.minX, s.minY, s.maxX, s.maxY)) {
+            setups.push_back(s);
+        }
+    }
+}
+
+// Every triangle of the tile's bin in draw order, so the tile needs no lock and the result does not depend on the threads
+void raster::Rasterizer::rasterizeTile(cv::Mat &frame, int tile) {
+    int tileX0 = (tile % tilesX) * tileSize, tileY0 = (tile / tilesX) * tileSize;
+    int tileX1 = std::min(tileX0 + tileSize, frame.cols), tileY1 = std::min(tileY0 + tileSize, frame.rows);
+    for (int y = tileY0; y < tileY1; y++) {
+        memset(depth.ptr<float>(y) + tileX0, 0, (tileX1 - tileX0) * sizeof(float));
+    }
+
+    const std::vector<int> &bin = bins[tile];
+    for (int n = 0; n < bin.size(); n++) {
+        const Setup &s = setups[bin[n]];
+        int x0 = std::max(s.minX, tileX0), x1 = std::min(s.maxX + 1, tileX1);
+        int y0 = std::max(s.minY, tileY0), y1 = std::min(s.maxY + 1, tileY1);
+
+#if CV_SIMD128
+        v_float32x4 zero = v_setzero_f32(), step = v_setall_f32(4.0f);
+        v_float32x4 EA0 = v_setall_f32(s.edge[0][0]), EA1 = v_setall_f32(s.edge[1][0]), EA2 = v_setall_f32(s.edge[2][0]);
+        v_float32x4 PZ = v_setall_f32(s.plane[0][0]), PB = v_setall_f32(s.plane[1][0]);
+        v_float32x4 PG = v_setall_f32(s.plane[2][0]), PR = v_setall_f32(s.plane[3][0]);
+#endif
+        for (int y = y0; y < y1; y++) {
+            float py = y + 0.5f;
+            float *d = depth.ptr<float>(y);
+            uchar *p = frame.ptr<uchar>(y);
+            // the part of each plane that is constant along the row
+            float e0 = s.edge[0][1] * py + s.edge[0][2];
+            float e1 = s.edge[1][1] * py + s.edge[1][2];
+            float e2 = s.edge[2][1] * py + s.edge[2][2];
+            float rz = s.plane[0][1] * py + s.plane[0][2];
+            float rb = s.plane[1][1] * py + s.plane[1][2];
+            float rg = s.plane[2][1] * py + s.plane[2][2];
+            float rr = s.plane[3][1] * py + s.plane[3][2];
+
+            int x = x0;
+#if CV_SIMD128
+            v_float32x4 E0 = v_setall_f32(e0), E1 = v_setall_f32(e1), E2 = v_setall_f32(e2), RZ = v_setall_f32(rz);
+            v_float32x4 px(x0 + 0.5f, x0 + 1.5f, x0 + 2.5f, x0 + 3.5f);
+            for (; x + 4 <= x1; x += 4, px += step) {
+                v_float32x4 inside = (v_muladd(EA0, px, E0) >= zero) & (v_muladd(EA1, px, E1) >= zero) & (v_muladd(EA2, px, E2) >= zero);
+                if (!v_check_any(inside)) {
+                    continue;
+                }
+                v_float32x4 z = v_muladd(PZ, px, RZ);
+                v_float32x4 old = v_load(d + x);
+                v_float32x4 closer = inside & (z > old);
+                int mask = v_signmask(closer);
+                if (mask == 0) {
+                    continue;
+                }
+                v_store(d + x, v_select(closer, z, old));
+
+                float b[4], g[4], r[4];
+                v_store(b, v_muladd(PB, px, v_setall_f32(rb)));
+                v_store(g, v_muladd(PG, px, v_setall_f32(rg)));
+                v_store(r, v_muladd(PR, px, v_setall_f32(rr)));
+                for (int k = 0; k < 4; k++) {
+                    if (mask & (1 << k)) {
+                        uchar *q = p + 3 * (x + k);
+                        q[0] = saturate_cast<uchar>(b[k]);
+                        q[1] = saturate_cast<uchar>(g[k]);
+                        q[2] = saturate_cast<uchar>(r[k]);
+                    }
+                }
+            }
+#endif
+            for (; x < x1; x++) {
+                float px = x + 0.5f;
+                if (s.edge[0][0] * px + e0 < 0 || s.edge[1][0] * px + e1 < 0 || s.edge[2][0] * px + e2 < 0) {
+                    continue;
+                }
+                float z = s.plane[0][0] * px + rz;
+                if (z <= d[x]) {
+                    continue;
+                }
+                d[x] = z;
+                uchar *q = p + 3 * x;
+                q[0] = saturate_cast<uchar>(s.plane[1][0] * px + rb);
+                q[1] = saturate_cast<uchar>(s.plane[2][0] * px + rg);
+                q[2] = saturate_cast<uchar>(s.plane[3][0] * px + rr);
+            }
+        }
+    }
+}
+
+void raster::Rasterizer::draw(cv::Mat &frame, const std::vector<Vertex> &vertices, float nearZ) {
+    if (frame.type() != CV_8UC3 || vertices.size() < 3) {
+        return;
+    }
+    if (depth.size() != frame.size()) {
+        depth.create(frame.size(), CV_32F);
+        tilesX = (frame.cols + tileSize - 1) / tileSize;
+        tilesY = (frame.rows + tileSize - 1) / tileSize;
+        bins.assign(tilesX * tilesY, std::vector<int>());
+    }
+    for (int i = 0; i < bins.size(); i++) {
+        bins[i].clear();
+    }
+
+    setupTriangles(vertices, frame.size(), nearZ);
+    for (int t = 0; t < setups.size(); t++) {
+        const Setup &s = setups[t];
+        for (int ty = s.minY / tileSize; ty <= s.maxY / tileSize; ty++) {
+            for (int tx = s.minX / tileSize; tx <= s.maxX / tileSize; tx++) {
+                bins[ty * tilesX + tx].push_back(t);
+            }
+        }
+    }
+
+    activeTiles.clear();
+    for (int i = 0; i < bins.size(); i++) {
+        if (!bins[i].empty()) {
+            activeTiles.push_back(i);
+        }
+    }
+    cv::parallel_for_(Range(0, (int)activeTiles.size()), [&](const Range &range) {
+        for (int i = range.start; i < range.end; i++) {
+            rasterizeTile(frame, activeTiles[i]);
+        }
+    });
+}
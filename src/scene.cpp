@@ -0,0 +1,329 @@
+#include "scene.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <opencv2/opencv.hpp>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ar.hpp"
+
+using namespace cv;
+using namespace std;
+using namespace scene;
+
+// the part of the light that reaches faces seen edge-on
+static const float AMBIENT = 0.35f;
+
+void scene::Mesh::addEdge(int from, int to, const cv::Scalar &color) {
+    edges.push_back(from);
+    edges.push_back(to);
+    edgeColors.push_back(color);
+}
+
+void scene::Mesh::addTriangle(int a, int b, int c, const cv::Scalar &color) {
+    triangles.push_back(a);
+    triangles.push_back(b);
+    triangles.push_back(c);
+    faceColors.push_back(color);
+}
+
+scene::Mesh scene::makeAxes(float length) {
+    Mesh mesh;
+    mesh.vertices.push_back(Point3f(0, 0, 0));
+    mesh.vertices.push_back(Point3f(length, 0, 0));   // x
+    mesh.vertices.push_back(Point3f(0, -length, 0));  // y
+    mesh.vertices.push_back(Point3f(0, 0, length));   // z
+    mesh.addEdge(0, 1, R);
+    mesh.addEdge(0, 2, G);
+    mesh.addEdge(0, 3, B);
+    mesh.arrows = true;
+    return mesh;
+}
+
+scene::Mesh scene::makeBox(float width, float height, float depth) {
+    Mesh mesh;
+    for (int k = 0; k < 2; k++) {
+        float z = k * depth;
+        mesh.vertices.push_back(Point3f(0, 0, z));             // upper left
+        mesh.vertices.push_back(Point3f(width, 0, z));         // upper right
+        mesh.vertices.push_back(Point3f(width, -height, z));   // bottom right
+        mesh.vertices.push_back(Point3f(0, -height, z));       // bottom left
+    }
+
+    const cv::Scalar colors[] = {R, G, B, ORIANGE};
+    for (int i = 0; i < 4; i++) {
+        mesh.addEdge(i, (i + 1) % 4, colors[i]);          // bottom
+        mesh.addEdge(4 + i, 4 + (i + 1) % 4, colors[i]);  // top
+        mesh.addEdge(i, 4 + i, colors[i]);                // surround
+
+        int next = (i + 1) % 4;
+        mesh.addTriangle(i, next, 4 + next, colors[i]);
+        mesh.addTriangle(i, 4 + next, 4 + i, colors[i]);
+    }
+    mesh.addTriangle(0, 1, 2, GRAY);  // bottom
+    mesh.addTriangle(0, 2, 3, GRAY);
+    mesh.addTriangle(4, 5, 6, YELLOW);  // top
+    mesh.addTriangle(4, 6, 7, YELLOW);
+    return mesh;
+}
+
+// Only the "v" and "f" records are read, each face outline becomes edges shared between faces once,
+// and each face a fan of triangles
+bool scene::loadOBJ(const char *path, Mesh &mesh, const cv::Scalar &color) {
+    ifstream infile(path);
+    if (!infile.is_open()) {
+        return false;
+    }
+
+    mesh = Mesh();
+    mesh.thickness = 1;
+    std::vector<std::pair<int, int> > edges;
+    std::vector<int> face;
+    string line, type, token;
+
+    while (std::getline(infile, line)) {
+        istringstream record(line);
+        if (!(record >> type)) {
+            continue;
+        }
+
+        if (type == "v") {
+            Point3f v;
+            if (!(record >> v.x >> v.y >> v.z)) {
+                return false;
+            }
+            mesh.vertices.push_back(v);
+        } else if (type == "f") {
+            // v, v/vt, v//vn or v/vt/vn, 1-based or negative from the end
+            face.clear();
+            while (record >> token) {
+                int index = atoi(token.c_str());
+                index = index < 0 ? (int)mesh.vertices.size() + index : index - 1;
+                if (index < 0 || index >= mesh.vertices.size()) {
+                    return false;
+                }
+                face.push_back(index);
+            }
+            for (int i = 0; i < face.size(); i++) {
+                int a = face[i];
+                int b = face[(i + 1) % face.size()];
+                if (a != b) {
+                    edges.push_back(std::make_pair(std::min(a, b), std::max(a, b)));
+                }
+            }
+            for (int i = 1; i + 1 < face.size(); i++) {
+                mesh.addTriangle(face[0], face[i], face[i + 1], color);
+            }
+        }
+    }
+
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+    for (int i = 0; i < edges.size(); i++) {
+        mesh.addEdge(edges[i].first, edges[i].second, color);
+    }
+    return !mesh.vertices.empty();
+}
+
+cv::Matx44f scene::translation(float x, float y, float z) {
+    cv::Matx44f m = cv::Matx44f::eye();
+    m(0, 3) = x;
+    m(1, 3) = y;
+    m(2, 3) = z;
+    return m;
+}
+
+cv::Matx44f scene::scaling(float s) {
+    cv::Matx44f m = cv::Matx44f::eye();
+    m(0, 0) = s;
+    m(1, 1) = s;
+    m(2, 2) = s;
+    return m;
+}
+
+// (x, y, z) -> (x, -z, y)
+cv::Matx44f scene::yUpToBoard() {
+    cv::Matx44f m = cv::Matx44f::zeros();
+    m(0, 0) = 1;
+    m(1, 2) = -1;
+    m(2, 1) = 1;
+    m(3, 3) = 1;
+    return m;
+}
+
+scene::Scene::Scene() : dirty(false), shading(SHADING_WIREFRAME) {}
+
+int scene::Scene::add(const Mesh &mesh, const cv::Matx44f &transform) {
+    Object object;
+    object.mesh = mesh;
+    object.transform = transform;
+    object.visible = true;
+    objects.push_back(object);
+    dirty = true;
+    return (int)objects.size() - 1;
+}
+
+void scene::Scene::setTransform(int id, const cv::Matx44f &transform) {
+    objects[id].transform = transform;
+    dirty = true;
+}
+
+void scene::Scene::setVisible(int id, bool visible) {
+    if (objects[id].visible != visible) {
+        objects[id].visible = visible;
+        dirty = true;
+    }
+}
+
+// Bake every visible object into board units, with its edges and faces offset into the shared vertex buffer
+void scene::Scene::rebuild() {
+    boardVertices.clear();
+    indices.clear();
+    colors.clear();
+    thickness.clear();
+    arrows.clear();
+    solid.clear();
+    triangles.clear();
+    triangleColors.clear();
+
+    for (int o = 0; o < objects.size(); o++) {
+        const Object &object = objects[o];
+        if (!object.visible) {
+            continue;
+        }
+
+        int base = (int)boardVertices.size();
+        const cv::Matx44f &m = object.transform;
+        for (int i = 0; i < object.mesh.vertices.size(); i++) {
+            const Point3f &v = object.mesh.vertices[i];
+            boardVertices.push_back(Point3f(m(0, 0) * v.x + m(0, 1) * v.y + m(0, 2) * v.z + m(0, 3),
+                                            m(1, 0) * v.x + m(1, 1) * v.y + m(1, 2) * v.z + m(1, 3),
+                                            m(2, 0) * v.x + m(2, 1) * v.y + m(2, 2) * v.z + m(2, 3)));
+        }
+        for (int e = 0; e < object.mesh.edgeColors.size(); e++) {
+            indices.push_back(base + object.mesh.edges[2 * e]);
+            indices.push_back(base + object.mesh.edges[2 * e + 1]);
+            colors.push_back(object.mesh.edgeColors[e]);
+            thickness.push_back(object.mesh.thickness);
+            arrows.push_back(object.mesh.arrows);
+            solid.push_back(!object.mesh.triangles.empty());
+        }
+        for (int t = 0; t < object.mesh.faceColors.size(); t++) {
+            for (int k = 0; k < 3; k++) {
+                triangles.push_back(base + object.mesh.triangles[3 * t + k]);
+            }
+            triangleColors.push_back(object.mesh.faceColors[t]);
+        }
+    }
+
+    // vertex normals for Gouraud shading, the face normals weighted by the face areas
+    normals.assign(boardVertices.size(), Point3f(0, 0, 0));
+    for (int t = 0; t < triangleColors.size(); t++) {
+        const int *v = &triangles[3 * t];
+        Point3f n = (boardVertices[v[1]] - boardVertices[v[0]]).cross(boardVertices[v[2]] - boardVertices[v[0]]);
+        // faces may be wound either way, orient them alike before summing
+        for (int k = 0; k < 3; k++) {
+            normals[v[k]] += normals[v[k]].dot(n) < 0 ? -n : n;
+        }
+    }
+
+    projected.reserve(boardVertices.size());
+    inFront.resize(boardVertices.size());
+    cameraVertices.resize(boardVertices.size());
+    intensity.resize(boardVertices.size());
+    rasterVertices.resize(triangles.size());
+    dirty = false;
+}
+
+void scene::Scene::render(cv::Mat &frame, const cv::Mat &cameraMatrix, const cv::Mat &distCoeffs, const cv::Mat &rvec, const cv::Mat &tvec) {
+    if (dirty) {
+        rebuild();
+    }
+    if (boardVertices.empty()) {
+        return;
+    }
+
+    // every vertex in camera coordinates, edges touching a vertex behind the camera are not drawn
+    cv::Rodrigues(rvec, rotation);
+    const double *r0 = rotation.ptr<double>(0);
+    const double *r1 = rotation.ptr<double>(1);
+    const double *r2 = rotation.ptr<double>(2);
+    const double *t = tvec.ptr<double>();
+    for (int i = 0; i < boardVertices.size(); i++) {
+        const Point3f &v = boardVertices[i];
+        Point3f &c = cameraVertices[i];
+        c.x = (float)(r0[0] * v.x + r0[1] * v.y + r0[2] * v.z + t[0]);
+        c.y = (float)(r1[0] * v.x + r1[1] * v.y + r1[2] * v.z + t[1]);
+        c.z = (float)(r2[0] * v.x + r2[1] * v.y + r2[2] * v.z + t[2]);
+        inFront[i] = c.z > 1e-3;
+    }
+
+    // one call for every object in the scene
+    cv::projectPoints(boardVertices, rvec, tvec, cameraMatrix, distCoeffs, projected);
+
+    bool filled = shading != SHADING_WIREFRAME && !triangles.empty();
+    if (filled) {
+        fill(frame);
+    }
+
+    for (int e = 0; e < colors.size(); e++) {
+        int a = indices[2 * e];
+        int b = indices[2 * e + 1];
+        if (!inFront[a] || !inFront[b] || (filled && solid[e])) {
+            continue;
+        }
+        if (arrows[e]) {
+            cv::arrowedLine(frame, projected[a], projected[b], colors[e], thickness[e]);
+        } else {
+            cv::line(frame, projected[a], projected[b], colors[e], thickness[e]);
+        }
+    }
+}
+
+/* Helper method to get how much of a headlight at the camera reaches a surface, lit from both sides. */
+static float lightAt(const Point3f &normal, const Point3f &position) {
+    float norms = sqrt(normal.dot(normal) * position.dot(position));
+    return norms > 0 ? AMBIENT + (1 - AMBIENT) * fabs(normal.dot(position)) / norms : AMBIENT;
+}
+
+// Shade the faces and hand them to the rasterizer, with the projected (distorted) positions of their vertices
+void scene::Scene::fill(cv::Mat &frame) {
+    if (shading == SHADING_GOURAUD) {
+        const double *r0 = rotation.ptr<double>(0);
+        const double *r1 = rotation.ptr<double>(1);
+        const double *r2 = rotation.ptr<double>(2);
+        for (int i = 0; i < normals.size(); i++) {
+            const Point3f &n = normals[i];
+            Point3f rotated((float)(r0[0] * n.x + r0[1] * n.y + r0[2] * n.z),
+                            (float)(r1[0] * n.x + r1[1] * n.y + r1[2] * n.z),
+                            (float)(r2[0] * n.x + r2[1] * n.y + r2[2] * n.z));
+            intensity[i] = lightAt(rotated, cameraVertices[i]);
+        }
+    }
+
+    for (int t = 0; t < triangleColors.size(); t++) {
+        const int *v = &triangles[3 * t];
+        float faceLight = 0;
+        if (shading == SHADING_FLAT) {
+            const Point3f &a = cameraVertices[v[0]], &b = cameraVertices[v[1]], &c = cameraVertices[v[2]];
+            faceLight = lightAt((b - a).cross(c - a), (a + b + c) * (1.0f / 3));
+        }
+        const cv::Scalar &color = triangleColors[t];
+        for (int k = 0; k < 3; k++) {
+            float light = shading == SHADING_FLAT ? faceLight : intensity[v[k]];
+            raster::Vertex &out = rasterVertices[3 * t + k];
+            out.x = projected[v[k]].x;
+            out.y = projected[v[k]].y;
+            out.z = cameraVertices[v[k]].z;
+            out.b = (float)color[0] * light;
+            out.g = (float)color[1] * light;
+            out.r = (float)color[2] * light;
+        }
+    }
+    rasterizer.draw(frame, rasterVertices);
+}
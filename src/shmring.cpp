@@ -0,0 +1,194 @@
+#include "shmring.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+
+using namespace shmring;
+
+// a reader gives up after this many torn reads in a row
+static const int MAX_READ_RETRIES = 16;
+
+shmring::ShmRing::ShmRing() : header(NULL), mappedSize(0), owner(false), writing(0) {
+    name[0] = 0;
+}
+
+shmring::ShmRing::~ShmRing() {
+    close();
+}
+
+bool shmring::ShmRing::create(const char *name, uint32_t slotCount, size_t slotSize) {
+    close();
+    if (slotCount == 0) {
+        return false;
+    }
+
+    size_t stride = (sizeof(SlotHeader) + slotSize + 63) / 64 * 64;
+    size_t size = sizeof(RingHeader) + (size_t)slotCount * stride;
+
+    // a new object every time, so readers of a previous layout see the magic disappear instead of a resized mapping
+    shm_unlink(name);
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    if (ftruncate(fd, size) != 0) {
+        ::close(fd);
+        shm_unlink(name);
+        return false;
+    }
+    void *mapped = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        shm_unlink(name);
+        return false;
+    }
+
+    // ftruncate zero-fills, so every sequence starts at 0
+    header = (RingHeader *)mapped;
+    header->version = VERSION;
+    header->slotCount = slotCount;
+    header->slotStride = stride;
+    header->slotSize = slotSize;
+    header->writeCount.store(0, std::memory_order_relaxed);
+    // the magic goes last, a reader that sees it sees a complete header
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(header->magic, MAGIC, sizeof(header->magic));
+
+    mappedSize = size;
+    snprintf(this->name, sizeof(this->name), "%s", name);
+    owner = true;
+    writing = 0;
+    return true;
+}
+
+bool shmring::ShmRing::open(const char *name) {
+    close();
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(RingHeader)) {
+        ::close(fd);
+        return false;
+    }
+    void *mapped = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        return false;
+    }
+
+    RingHeader *h = (RingHeader *)mapped;
+    bool ok = memcmp(h->magic, MAGIC, sizeof(h->magic)) == 0 && h->version == VERSION &&
+              sizeof(RingHeader) + (size_t)h->slotCount * h->slotStride <= (size_t)st.st_size;
+    if (!ok) {
+        munmap(mapped, st.st_size);
+        return false;
+    }
+
+    header = h;
+    mappedSize = st.st_size;
+    snprintf(this->name, sizeof(this->name), "%s", name);
+    owner = false;
+    return true;
+}
+
+void shmring::ShmRing::close() {
+    if (header == NULL) {
+        return;
+    }
+    munmap(header, mappedSize);
+    if (owner) {
+        shm_unlink(name);
+    }
+    header = NULL;
+    mappedSize = 0;
+    owner = false;
+}
+
+SlotHeader *shmring::ShmRing::slot(uint64_t index) const {
+    uint8_t *base = (uint8_t *)header + sizeof(RingHeader);
+    return (SlotHeader *)(base + (index % header->slotCount) * header->slotStride);
+}
+
+uint8_t *shmring::ShmRing::beginWrite() {
+    writing = header->writeCount.load(std::memory_order_relaxed);
+    SlotHeader *s = slot(writing);
+    // odd: readers that started on this slot will see the change and retry
+    s->sequence.store(2 * writing + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    return (uint8_t *)s + sizeof(SlotHeader);
+}
+
+void shmring::ShmRing::endWrite(size_t size) {
+    SlotHeader *s = slot(writing);
+    s->size = size;
+    s->sequence.store(2 * writing + 2, std::memory_order_release);
+    header->writeCount.store(writing + 1, std::memory_order_release);
+}
+
+void shmring::ShmRing::write(const void *data, size_t size) {
+    uint8_t *payload = beginWrite();
+    memcpy(payload, data, size);
+    endWrite(size);
+}
+
+bool shmring::ShmRing::readLatest(void *buffer, size_t capacity, size_t &size, uint64_t &index) const {
+    for (int attempt = 0; attempt < MAX_READ_RETRIES; attempt++) {
+        uint64_t count = header->writeCount.load(std::memory_order_acquire);
+        if (count == 0) {
+            return false;
+        }
+
+        const SlotHeader *s = slot(count - 1);
+        uint64_t before = s->sequence.load(std::memory_order_acquire);
+        if (before & 1) {
+            continue;
+        }
+        size = s->size;
+        if (size > capacity || size > header->slotSize) {
+            continue;
+        }
+        memcpy(buffer, (const uint8_t *)s + sizeof(SlotHeader), size);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t after = s->sequence.load(std::memory_order_relaxed);
+        if (before == after && before > 0) {
+            index = before / 2 - 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+const uint8_t *shmring::ShmRing::peekLatest(size_t &size, uint64_t &index) const {
+    for (int attempt = 0; attempt < MAX_READ_RETRIES; attempt++) {
+        uint64_t count = header->writeCount.load(std::memory_order_acquire);
+        if (count == 0) {
+            return NULL;
+        }
+
+        const SlotHeader *s = slot(count - 1);
+        if (s->sequence.load(std::memory_order_acquire) != 2 * count) {
+            continue;
+        }
+        size = s->size;
+        if (size > header->slotSize) {
+            continue;
+        }
+        index = count - 1;
+        return (const uint8_t *)s + sizeof(SlotHeader);
+    }
+    return NULL;
+}
+
+bool shmring::ShmRing::validate(uint64_t index) const {
+    // the reads of the payload must complete before the sequence is checked again
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot(index)->sequence.load(std::memory_order_relaxed) == 2 * index + 2;
+}
@@ -0,0 +1,179 @@
+#include "sink.hpp"
+
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <opencv2/opencv.hpp>
+#include <string>
+
+using namespace cv;
+using namespace std;
+using namespace sink;
+
+sink::WindowSink::WindowSink(const std::string &windowName) : windowName(windowName) {
+    cv::namedWindow(windowName, 1);  // identifies a window
+}
+
+void sink::WindowSink::write(const cv::Mat &frame) {
+    cv::imshow(windowName, frame);
+}
+
+int sink::WindowSink::pollKey(int delayMs) {
+    return cv::waitKey(delayMs);
+}
+
+sink::AsyncSink::AsyncSink(size_t queueCapacity) : queue(queueCapacity), started(false) {}
+
+sink::AsyncSink::~AsyncSink() {
+    close();
+}
+
+// called by the derived constructor, so the output thread never sees a partly built sink
+void sink::AsyncSink::start() {
+    outputThread = std::thread(&AsyncSink::outputLoop, this);
+    started = true;
+}
+
+void sink::AsyncSink::write(const cv::Mat &frame) {
+    queue.push(frame);
+}
+
+// the queued frames are still written, then the output thread exits
+void sink::AsyncSink::close() {
+    queue.close();
+    if (started) {
+        outputThread.join();
+        started = false;
+    }
+}
+
+void sink::AsyncSink::outputLoop() {
+    cv::Mat frame;
+    while (queue.pop(frame)) {
+        encode(frame);
+    }
+}
+
+sink::VideoFileSink::VideoFileSink(const std::string &path, double fps, size_t queueCapacity) : AsyncSink(queueCapacity), path(path), fps(fps), failed(false) {
+    start();
+}
+
+// stop the output thread before the writer is destroyed
+sink::VideoFileSink::~VideoFileSink() {
+    close();
+}
+
+void sink::VideoFileSink::encode(const cv::Mat &frame) {
+    if (failed) {
+        return;
+    }
+    if (!writer.isOpened()) {
+        bool avi = path.size() >= 4 && path.compare(path.size() - 4, 4, ".avi") == 0;
+        int fourcc = avi ? cv::VideoWriter::fourcc('M', 'J', 'P', 'G') : cv::VideoWriter::fourcc('m', 'p', '4', 'v');
+        if (!writer.open(path, fourcc, fps, frame.size(), frame.channels() == 3)) {
+            printf("%s cannot be opened for writing\n", path.c_str());
+            failed = true;
+            return;
+        }
+    }
+    writer.write(frame);
+}
+
+sink::ImageSequenceSink::ImageSequenceSink(const std::string &pattern, size_t queueCapacity) : AsyncSink(queueCapacity), pattern(pattern), index(0) {
+    start();
+}
+
+sink::ImageSequenceSink::~ImageSequenceSink() {
+    close();
+}
+
+void sink::ImageSequenceSink::encode(const cv::Mat &frame) {
+    char fname[512];
+    snprintf(fname, sizeof(fname), pattern.c_str(), (int)index++);
+    if (!cv::imwrite(fname, frame)) {
+        printf("%s cannot be written\n", fname);
+    }
+}
+
+sink::ShmSink::ShmSink(const std::string &name, uint32_t slotCount) : name(name), slotCount(slotCount), index(0) {}
+
+void sink::ShmSink::write(const cv::Mat &frame) {
+    size_t rowBytes = frame.cols * frame.elemSize();
+    size_t size = sizeof(ShmFrameHeader) + frame.rows * rowBytes;
+    if (!ring.isOpen() || ring.slotSize() != size) {
+        if (!ring.create(name.c_str(), slotCount, size)) {
+            printf("shared memory %s cannot be created\n", name.c_str());
+            return;
+        }
+    }
+
+    // copied straight into the slot, row by row since the frame may be a padded ROI
+    uint8_t *payload = ring.beginWrite();
+    ShmFrameHeader header;
+    memset(&header, 0, sizeof(header));
+    header.width = frame.cols;
+    header.height = frame.rows;
+    header.type = frame.type();
+    header.index = index++;
+    memcpy(payload, &header, sizeof(header));
+    for (int r = 0; r < frame.rows; r++) {
+        memcpy(payload + sizeof(header) + r * rowBytes, frame.ptr(r), rowBytes);
+    }
+    ring.endWrite(size);
+}
+
+void sink::ShmSink::close() {
+    ring.close();
+}
+
+/* Helper method to check a file name pattern has exactly one integer conversion, e.g. %06d, and no other ones but %%. */
+static bool isFramePattern(const std::string &pattern) {
+    int conversions = 0;
+    for (size_t i = 0; i < pattern.size(); i++) {
+        if (pattern[i] != '%') {
+            continue;
+        }
+        i++;
+        if (i < pattern.size() && pattern[i] == '%') {
+            continue;
+        }
+        // flags, width and precision, but no length modifier: the frame number is passed as an int
+        while (i < pattern.size() && strchr("-+ #0", pattern[i]) != NULL) {
+            i++;
+        }
+        while (i < pattern.size() && isdigit((unsigned char)pattern[i])) {
+            i++;
+        }
+        if (i < pattern.size() && pattern[i] == '.') {
+            i++;
+            while (i < pattern.size() && isdigit((unsigned char)pattern[i])) {
+                i++;
+            }
+        }
+        if (i >= pattern.size() || strchr("diouxX", pattern[i]) == NULL) {
+            return false;
+        }
+        conversions++;
+    }
+    return conversions == 1;
+}
+
+sink::FrameSink *sink::create(const std::string &spec, const std::string &windowName) {
+    if (spec == "window") {
+        return new WindowSink(windowName);
+    } else if (spec == "null") {
+        return new NullSink();
+    } else if (spec.compare(0, 6, "video:") == 0 && spec.size() > 6) {
+        return new VideoFileSink(spec.substr(6));
+    } else if (spec.compare(0, 7, "images:") == 0 && spec.size() > 7) {
+        // the pattern becomes a printf format, anything but one integer conversion is undefined
+        if (!isFramePattern(spec.substr(7))) {
+            printf("The images pattern %s needs exactly one integer conversion, e.g. frame_%%06d.png\n", spec.substr(7).c_str());
+            return NULL;
+        }
+        return new ImageSequenceSink(spec.substr(7));
+    } else if (spec.compare(0, 4, "shm:") == 0 && spec.size() > 4) {
+        return new ShmSink(spec.substr(4));
+    }
+    return NULL;
+}
@@ -0,0 +1,159 @@
+#include "telemetry.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+using namespace telemetry;
+
+int64_t telemetry::nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static size_t roundUpToPowerOfTwo(size_t n) {
+    size_t p = 1;
+    while (p < n) {
+        p <<= 1;
+    }
+    return p;
+}
+
+telemetry::SpscRing::SpscRing(size_t capacity) : slots(roundUpToPowerOfTwo(std::max(capacity, (size_t)2))), head(0), tail(0), numDropped(0) {
+    mask = slots.size() - 1;
+}
+
+bool telemetry::SpscRing::push(const Record &record) {
+    size_t t = tail.load(std::memory_order_relaxed);
+    if (t - head.load(std::memory_order_acquire) == slots.size()) {
+        numDropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    slots[t & mask] = record;
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+}
+
+bool telemetry::SpscRing::pop(Record &record) {
+    size_t h = head.load(std::memory_order_relaxed);
+    if (h == tail.load(std::memory_order_acquire)) {
+        return false;
+    }
+    record = slots[h & mask];
+    head.store(h + 1, std::memory_order_release);
+    return true;
+}
+
+static std::atomic<long> nextRecorderId(1);
+
+telemetry::Recorder::Recorder(const char *path, double consoleInterval, size_t ringCapacity)
+    : id(nextRecorderId++), file(NULL), consoleInterval(consoleInterval), ringCapacity(ringCapacity), running(true), numWritten(0), lastPrintNs(0), hasLatest(false) {
+    if (path != NULL) {
+        file = fopen(path, "wb");
+        if (file == NULL) {
+            printf("%s cannot be opened for the telemetry log\n", path);
+        } else {
+            // the drain thread writes in large blocks
+            setvbuf(file, NULL, _IOFBF, 1 << 20);
+            FileHeader header;
+            memset(&header, 0, sizeof(header));
+            memcpy(header.magic, MAGIC, sizeof(header.magic));
+            header.version = VERSION;
+            header.recordSize = sizeof(Record);
+            fwrite(&header, sizeof(header), 1, file);
+        }
+    }
+    drainThread = std::thread(&Recorder::drainLoop, this);
+}
+
+telemetry::Recorder::~Recorder() {
+    close();
+}
+
+// Each producing thread registers its own ring once, then records without locking
+SpscRing &telemetry::Recorder::ringOfThisThread() {
+    static thread_local long cachedId = 0;
+    static thread_local SpscRing *cachedRing = NULL;
+    if (cachedId != id) {
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        rings.push_back(std::unique_ptr<SpscRing>(new SpscRing(ringCapacity)));
+        cachedRing = rings.back().get();
+        cachedId = id;
+    }
+    return *cachedRing;
+}
+
+void telemetry::Recorder::record(const Record &record) {
+    ringOfThisThread().push(record);
+}
+
+long telemetry::Recorder::dropped() const {
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    long total = 0;
+    for (int i = 0; i < rings.size(); i++) {
+        total += rings[i]->dropped();
+    }
+    return total;
+}
+
+// Move everything queued so far to the log, returns false if there was nothing
+bool telemetry::Recorder::drain() {
+    bool any = false;
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    Record record;
+    for (int i = 0; i < rings.size(); i++) {
+        while (rings[i]->pop(record)) {
+            if (file != NULL) {
+                fwrite(&record, sizeof(record), 1, file);
+                numWritten++;
+            }
+            latest = record;
+            hasLatest = true;
+            any = true;
+        }
+    }
+    return any;
+}
+
+void telemetry::Recorder::drainLoop() {
+    while (running) {
+        if (!drain()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+
+        // the console sees at most one record per interval, whatever the frame rate
+        if (consoleInterval > 0 && hasLatest && nowNs() - lastPrintNs >= consoleInterval * 1e9) {
+            printRecord(latest);
+            lastPrintNs = nowNs();
+            hasLatest = false;
+        }
+    }
+    while (drain()) {
+    }
+}
+
+void telemetry::Recorder::close() {
+    if (!drainThread.joinable()) {
+        return;
+    }
+    running = false;
+    drainThread.join();
+    if (file != NULL) {
+        fclose(file);
+        file = NULL;
+    }
+}
+
+/* Helper method to print out a record, the rotation and translation of the board with the frame's timings. */
+void telemetry::Recorder::printRecord(const Record &record) {
+    if (record.flags & FLAG_FOUND) {
+        printf("stream %d frame %lld: rvec [%lf %lf %lf] tvec [%lf %lf %lf] | error %.2f px | detect %.2f ms, solve %.2f ms (%d refinements), render %.2f ms\n",
+               record.stream, (long long)record.frameIndex,
+               record.rvec[0], record.rvec[1], record.rvec[2], record.tvec[0], record.tvec[1], record.tvec[2],
+               record.reprojectionError, record.detectMs, record.solveMs, record.iterations, record.renderMs);
+    } else {
+        printf("stream %d frame %lld: board not found | detect %.2f ms\n", record.stream, (long long)record.frameIndex, record.detectMs);
+    }
+    fflush(stdout);
+}
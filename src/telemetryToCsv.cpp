@@ -0,0 +1,69 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "telemetry.hpp"
+
+using namespace std;
+
+/*
+  Convert a binary telemetry log written by AR --log to CSV.
+  The time column is in seconds from the first record.
+
+  Usage: telemetryToCsv <log> [output.csv]    the CSV goes to stdout without an output file
+ */
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        printf("Usage: telemetryToCsv <log> [output.csv]\n");
+        exit(-1);
+    }
+
+    FILE *in = fopen(argv[1], "rb");
+    if (in == NULL) {
+        printf("%s cannot be opened.\n", argv[1]);
+        exit(-1);
+    }
+
+    telemetry::FileHeader header;
+    if (fread(&header, sizeof(header), 1, in) != 1 ||
+        memcmp(header.magic, telemetry::MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != telemetry::VERSION ||
+        header.recordSize != sizeof(telemetry::Record)) {
+        printf("%s is not a telemetry log of this version.\n", argv[1]);
+        exit(-1);
+    }
+
+    FILE *out = stdout;
+    if (argc >= 3) {
+        out = fopen(argv[2], "w");
+        if (out == NULL) {
+            printf("%s cannot be written.\n", argv[2]);
+            exit(-1);
+        }
+    }
+
+    fprintf(out, "time_s,stream,frame,found,warm_start,flow,rvec_x,rvec_y,rvec_z,tvec_x,tvec_y,tvec_z,reprojection_error_px,detect_ms,solve_ms,render_ms,refinements\n");
+
+    telemetry::Record record;
+    int64_t start = 0;
+    long count = 0;
+    while (fread(&record, sizeof(record), 1, in) == 1) {
+        if (count == 0) {
+            start = record.timestampNs;
+        }
+        fprintf(out, "%.6f,%d,%lld,%d,%d,%d,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.4f,%.3f,%.3f,%.3f,%d\n",
+                (record.timestampNs - start) / 1e9, record.stream, (long long)record.frameIndex,
+                (record.flags & telemetry::FLAG_FOUND) ? 1 : 0, (record.flags & telemetry::FLAG_WARM_START) ? 1 : 0,
+                (record.flags & telemetry::FLAG_FLOW) ? 1 : 0,
+                record.rvec[0], record.rvec[1], record.rvec[2], record.tvec[0], record.tvec[1], record.tvec[2],
+                record.reprojectionError, record.detectMs, record.solveMs, record.renderMs, record.iterations);
+        count++;
+    }
+
+    fclose(in);
+    if (out != stdout) {
+        fclose(out);
+        printf("%ld records converted.\n", count);
+    }
+    return 0;
+}
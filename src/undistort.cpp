@@ -0,0 +1,103 @@
+#include "undistort.hpp"
+
+#include <stdio.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstring>
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+
+#include "calibfile.hpp"
+
+using namespace cv;
+using namespace std;
+using namespace undistort;
+
+// numbers the temporary files of this process, so streams missing the same entry together do not share one
+static std::atomic<long> nextTmpId(0);
+
+uint32_t undistort::calibrationKey(const cv::Mat &cameraMatrix, const cv::Mat &distCoeffs, cv::Size frameSize) {
+    std::vector<double> values;
+    for (int i = 0; i < 9; i++) {
+        values.push_back(cameraMatrix.at<double>(i / 3, i % 3));
+    }
+    for (int i = 0; i < distCoeffs.total(); i++) {
+        values.push_back(distCoeffs.at<double>(i));
+    }
+    values.push_back(frameSize.width);
+    values.push_back(frameSize.height);
+    return calibfile::crc32(values.data(), values.size() * sizeof(double));
+}
+
+undistort::MapCache::MapCache(const std::string &cacheDir) : cacheDir(cacheDir) {}
+
+std::string undistort::MapCache::entryPath(uint32_t key, cv::Size frameSize) const {
+    char name[64];
+    snprintf(name, sizeof(name), "/undistort_%08x_%dx%d.bin", key, frameSize.width, frameSize.height);
+    return cacheDir + name;
+}
+
+/* Helper method to compare two double matrices element by element. */
+static bool sameValues(const cv::Mat &a, const cv::Mat &b) {
+    if (a.total() != b.total()) {
+        return false;
+    }
+    for (int i = 0; i < a.total(); i++) {
+        if (a.at<double>(i) != b.at<double>(i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool undistort::MapCache::get(const cv::Mat &cameraMatrix, const cv::Mat &distCoeffs, cv::Size frameSize, cv::Mat &map1, cv::Mat &map2) {
+    uint32_t key = calibrationKey(cameraMatrix, distCoeffs, frameSize);
+    std::string path = entryPath(key, frameSize);
+
+    // hit: the stored calibration must match exactly, the key is only a hash
+    calibfile::Calibration entry;
+    if (calibfile::readBinary(path.c_str(), entry) && !entry.map1.empty() &&
+        entry.imageSize == frameSize &&
+        sameValues(entry.cameraMatrix.reshape(1, 9), cameraMatrix.clone().reshape(1, 9)) &&
+        sameValues(entry.distCoeffs, distCoeffs)) {
+        map1 = entry.map1;
+        map2 = entry.map2;
+        return true;
+    }
+
+    // miss: build the maps for the same camera matrix, in fixed-point form for a fast remap
+    cv::initUndistortRectifyMap(cameraMatrix, distCoeffs, Mat(), cameraMatrix, frameSize, CV_16SC2, map1, map2);
+
+    entry.imageSize = frameSize;
+    entry.cameraMatrix = cameraMatrix;
+    entry.distCoeffs = distCoeffs.clone().reshape(1, (int)distCoeffs.total());
+    entry.map1 = map1;
+    entry.map2 = map2;
+
+    // write to a temporary file of this process and stream and rename it, so a reader never sees a partial entry
+    mkdir(cacheDir.c_str(), 0755);
+    std::string tmpPath = path + "." + to_string(getpid()) + "." + to_string(nextTmpId++) + ".tmp";
+    if (!calibfile::writeBinary(tmpPath.c_str(), entry) || rename(tmpPath.c_str(), path.c_str()) != 0) {
+        printf("undistortion maps cannot be cached in %s\n", cacheDir.c_str());
+        remove(tmpPath.c_str());
+    }
+    return true;
+}
+
+undistort::Undistorter::Undistorter(const cv::Mat &cameraMatrix, const cv::Mat &distCoeffs, MapCache &cache)
+    : originalCameraMatrix(cameraMatrix.clone()), originalDistCoeffs(distCoeffs.clone()), newCameraMatrix(cameraMatrix.clone()), cache(cache) {}
+
+void undistort::Undistorter::apply(cv::Mat &frame) {
+    if (frame.size() != mapSize) {
+        cache.get(originalCameraMatrix, originalDistCoeffs, frame.size(), map1, map2);
+        mapSize = frame.size();
+    }
+
+    // remapped is reused between frames, the two buffers are swapped instead of copied
+    cv::remap(frame, remapped, map1, map2, INTER_LINEAR);
+    cv::swap(frame, remapped);
+}